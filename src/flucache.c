@@ -17,15 +17,30 @@
  * Boston, MA 02111-1307, USA.
  */
 
-#ifdef HAVE_CONFIG
+#ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
 #include "flucache.h"
+#include "flucacheshm.h"
+#include "flucachemanager.h"
+#include "flucacheprobes.h"
+#include "flutsscheduler.h"
 
 #include <stdio.h>
 #include <glib/gstdio.h>
 #include <string.h>
+#include <errno.h>
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_SYS_STATVFS_H
+#include <sys/statvfs.h>
+#endif
+#include <fcntl.h>
+#if defined (HAVE_FALLOCATE) && defined (HAVE_LINUX_FALLOC_H)
+#include <linux/falloc.h>
+#endif
 
 #ifdef G_OS_WIN32
 #include <io.h>                 /* lseek, open, close, read */
@@ -37,6 +52,13 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#endif
+
 GST_DEBUG_CATEGORY_EXTERN (ts_flow);
 #define GST_CAT_DEFAULT (ts_flow)
 
@@ -46,6 +68,19 @@ GST_DEBUG_CATEGORY_EXTERN (ts_flow);
 
 #define INVALID_OFFSET ((guint64) -1)
 
+/* a disk read is accounted as done under write load when some data was
+ * written to the disk during this window */
+#define WRITE_LOAD_WINDOW (100 * GST_MSECOND)
+
+/* bytes written to the disk between checks of the free space */
+#define SPACE_CHECK_INTERVAL (4 * 1024 * 1024)
+
+/* interval between the reports to the memory manager */
+#define BALANCE_INTERVAL (500 * GST_MSECOND)
+
+/* smallest ring buffer we resize to */
+#define MIN_SLOTS 4
+
 typedef struct _Slot Slot;
 typedef struct _SlotMeta SlotMeta;
 
@@ -71,6 +106,7 @@ struct _Slot
   guint8 *data;
   guint8 *wptr;
   guint32 size;
+  guint index;                  /* descriptor in the shared memory */
 };
 
 static inline gboolean
@@ -88,6 +124,32 @@ slot_available (Slot * slot, gsize * size)
   return FALSE;
 }
 
+/* moves @slot from the state @from to @to if it is still in @from */
+static inline gboolean
+slot_transition (Slot * slot, CacheState from, CacheState to)
+{
+  if (!g_atomic_int_compare_and_exchange (&slot->state, from, to))
+    return FALSE;
+
+  FLUCACHE_PROBE5 (slot_state, slot->index, from, to, slot->offset,
+      slot->size);
+  return TRUE;
+}
+
+/* moves @slot to @to from the state it's in, for the transitions that can't
+ * race with another thread */
+static inline void
+slot_set_state (Slot * slot, CacheState to)
+{
+#ifdef HAVE_USDT
+  CacheState from = g_atomic_int_get (&slot->state);
+#endif
+
+  g_atomic_int_set (&slot->state, to);
+  FLUCACHE_PROBE5 (slot_state, slot->index, from, to, slot->offset,
+      slot->size);
+}
+
 static inline guint
 slot_fullness (Slot * slot)
 {
@@ -107,10 +169,10 @@ slot_write (Slot * slot, guint8 * data, guint size, guint64 offset)
   slot->wptr += size;
   slot->size += size;
   if (slot->size == CACHE_SLOT_SIZE) {
-    g_atomic_int_set (&slot->state, STATE_FULL);
+    slot_set_state (slot, STATE_FULL);
     return TRUE;
   } else {
-    g_atomic_int_set (&slot->state, STATE_PART);
+    slot_set_state (slot, STATE_PART);
     return FALSE;
   }
 }
@@ -144,7 +206,7 @@ static inline void
 _slot_meta_free (SlotMeta * meta)
 {
   if (meta->slot)
-    g_atomic_int_set (&meta->slot->state, STATE_RECYCLE);
+    slot_set_state (meta->slot, STATE_RECYCLE);
 
   if (meta->cache)
     gst_shifter_cache_unref (meta->cache);
@@ -235,30 +297,102 @@ struct _GstShifterCache
   /* ring buffer */
   guint nslots;
   volatile gint fslots;         /* number of full slots */
-  guint8 *memory;
-  Slot *slots;
+  guint8 *memory;               /* slot data in the shared memory */
+  Slot **slots;
+  gint exports;                 /* exports reading the slots unlocked */
+  guint resize_slots;           /* requested size not reached yet, 0 if none */
+  guint max_slots;              /* size asked by the user, the manager only
+                                 * shrinks the ring buffer below it */
+  GstClockTime balance_time;    /* last report to the memory manager */
+
+  /* shared memory */
+  FluCacheShmHeader *shm;       /* start of the mapping, NULL if private */
+  gsize shm_size;
+  gint shm_fd;
 
   guint head;
   guint tail;
+  guint64 skip_offset;          /* data before this was consumed elsewhere */
+
+  /* extra readers, their data is kept until they read it */
+  GSList *cursors;
+  guint64 c_offset;             /* offset of the slowest cursor */
 
   /* disk */
-  FILE *file;
+  gint fd;
   gchar *filename_template;
   gchar *filename;
   gboolean autoremove;
   gsize w_dk_pos;               /* disk position in bytes where data is written */
   gsize r_dk_pos;               /* disk position in bytes where data is read */
   gsize m_dk_pos;               /* disk position in bytes where data is migratted */
+  GstShifterCacheSyncPolicy sync_policy;
+  gsize sync_interval;          /* bytes written between syncs */
+  gsize s_dk_start;             /* disk position the last sync started at */
+  gsize s_dk_pos;               /* disk position synced at the last sync */
+  gsize sync_pos;               /* disk position the next sync goes up to */
+  GstFluTSSchedulerJob sync_job;
 
   gboolean is_recording;
   gboolean is_rb_migrated;
   gboolean stop_recording;
 
+  /* free space on the disk */
+  guint64 low_space;            /* start discarding old data below this */
+  guint64 critical_space;       /* stop using the disk below this */
+  guint64 disk_window;          /* recorded bytes kept, 0 = unlimited */
+  guint64 free_space;           /* free space at the last check */
+  gsize space_check_pos;        /* w_dk_pos at the last check */
+  GstShifterCacheDiskState disk_state;
+  gboolean disk_failed;         /* a write failed, stop using the disk */
+  gboolean disk_disabled;       /* only the ring buffer is used */
+
   GThread *thread;              /* thread for async migration */
+  gboolean shared_scheduler;    /* migrate on the shared workers instead */
+  GstFluTSSchedulerJob migration_job;
+  gboolean migrating;           /* the migration was started */
+  guint migrate_slot;           /* next slot to copy to the disk */
+  guint migrate_left;           /* slots not looked at yet */
 
   GstClockTime mtime;           /* timestamp when migration started */
+
+  /* background writes */
+  GstShifterCacheIOClass io_class;
+  gint io_level;
+  guint64 write_rate;           /* migration rate limit in bytes/s, 0 = none */
+  gint64 tokens;                /* bytes we are allowed to write right now */
+  GstClockTime refill_time;     /* last time the token bucket was refilled */
+  GstClockTime write_delay;     /* how long the live writer must wait */
+  GstClockTime last_write;      /* timestamp of the last disk write */
+
+  /* disk read latency */
+  guint64 reads;
+  guint64 loaded_reads;         /* reads done while writing to the disk */
+  GstClockTime read_time;
+  GstClockTime loaded_read_time;
+  GstClockTime max_read_time;
+
+  /* disk write latency */
+  guint64 writes;
+  GstClockTime write_time;
+  GstClockTime max_write_time;
+
+  /* runtime statistics */
+  guint64 reloads;              /* reloads that brought slots back */
+  guint64 read_bytes;
+  guint64 write_bytes;
+  GstClockTime migration_time;  /* duration of the last migration */
+
+  /* copies for gst_shifter_cache_get_levels(), written with the lock, the
+   * readers only retry while levels_seq is odd or changed meanwhile */
+  volatile gint levels_seq;
+  guint levels_nslots;
+  guint64 levels_disk_fill;
+  guint64 levels_reloads;
 };
 
+static void gst_shifter_cache_publish_levels (GstShifterCache * cache);
+
 #define GST_CACHE_LOCK(cache) G_STMT_START {                                \
   g_mutex_lock (cache->lock);                                                \
 } G_STMT_END
@@ -268,6 +402,58 @@ struct _GstShifterCache
 } G_STMT_END
 
 
+/* Tells the readers of the shared memory that @slot is about to be reused */
+static inline void
+gst_shifter_cache_shm_invalidate (GstShifterCache * cache, Slot * slot)
+{
+  FluCacheShmSlot *desc;
+
+  if (G_LIKELY (cache->shm == NULL))
+    return;
+
+  desc = &FLUCACHE_SHM_SLOTS (cache->shm)[slot->index];
+  g_atomic_int_inc (&desc->seq);
+  desc->size = 0;
+  desc->offset = INVALID_OFFSET;
+}
+
+/* Publishes the data written to @slot to the readers of the shared memory */
+static inline void
+gst_shifter_cache_shm_commit (GstShifterCache * cache, Slot * slot)
+{
+  FluCacheShmSlot *desc;
+
+  if (G_LIKELY (cache->shm == NULL))
+    return;
+
+  desc = &FLUCACHE_SHM_SLOTS (cache->shm)[slot->index];
+  desc->offset = slot->offset;
+  /* the size must be seen after the data and the offset */
+  g_atomic_int_set ((volatile gint *) &desc->size, slot->size);
+}
+
+/* Publishes the range of offsets held in the ring buffer. The header has a
+ * single seq so the pushing and the seeking threads take the cache lock to
+ * update it one at a time. */
+static inline void
+gst_shifter_cache_shm_publish (GstShifterCache * cache)
+{
+  Slot *tail;
+
+  if (G_LIKELY (cache->shm == NULL))
+    return;
+
+  GST_CACHE_LOCK (cache);
+  tail = cache->slots[cache->tail];
+  g_atomic_int_inc (&cache->shm->seq);
+  cache->shm->l_offset = cache->l_rb_offset;
+  cache->shm->h_offset = cache->h_rb_offset;
+  if (g_atomic_int_get (&tail->state) == STATE_PART)
+    cache->shm->h_offset += tail->size;
+  g_atomic_int_inc (&cache->shm->seq);
+  GST_CACHE_UNLOCK (cache);
+}
+
 void
 dump_cache_state (GstShifterCache * cache, const gchar * title)
 {
@@ -284,7 +470,7 @@ dump_cache_state (GstShifterCache * cache, const gchar * title)
       cache->h_offset, cache->h_dk_offset, cache->l_dk_offset);
 
   for (i = 0; i < cache->nslots; i++) {
-    Slot *slot = &cache->slots[i];
+    Slot *slot = cache->slots[i];
     CacheState state = g_atomic_int_get (&slot->state);
     GST_LOG ("     %d. %s data %p wptr %p size %" G_GUINT32_FORMAT " offset %"
         G_GUINT64_FORMAT, i, state_names[state], slot->data, slot->wptr,
@@ -298,7 +484,7 @@ gst_shifter_cache_disk_open (GstShifterCache * cache)
   gint fd = -1;
   gchar *name = NULL;
 
-  if (cache->file)
+  if (cache->fd != -1)
     return TRUE;
 
   if (cache->filename_template == NULL)
@@ -307,20 +493,14 @@ gst_shifter_cache_disk_open (GstShifterCache * cache)
   /* make copy of the template, we don't want to change this */
   name = g_strdup (cache->filename_template);
   fd = g_mkstemp (name);
-  if (fd == -1)
+  if (fd == -1) {
+    g_free (name);
     return FALSE;
+  }
 
   GST_CACHE_LOCK (cache);
-  /* open the file for update/writing */
-  cache->file = fdopen (fd, "wb+");
+  cache->fd = fd;
   GST_CACHE_UNLOCK (cache);
-  /* error creating file */
-  if (cache->file == NULL) {
-    g_free (name);
-    if (fd != -1)
-      close (fd);
-    return FALSE;
-  }
 
   g_free (cache->filename);
   cache->filename = name;
@@ -333,54 +513,351 @@ gst_shifter_cache_disk_close (GstShifterCache * cache)
 {
   /* nothing to do */
   GST_CACHE_LOCK (cache);
-  if (cache->file == NULL) {
+  if (cache->fd == -1) {
     goto beach;
   }
-  fflush (cache->file);
-  fclose (cache->file);
+  close (cache->fd);
   if (cache->autoremove) {
     remove (cache->filename);
     g_free (cache->filename);
     cache->filename = NULL;
   }
-  cache->file = NULL;
+  cache->fd = -1;
 beach:
   GST_CACHE_UNLOCK (cache);
 }
 
-#ifdef HAVE_FSEEKO
-#define FSEEK_FILE(file,offset)  (fseeko (file, (off_t) offset, SEEK_SET) != 0)
-#elif defined (G_OS_UNIX) || defined (G_OS_WIN32)
-#define FSEEK_FILE(file,offset)  (lseek (fileno (file), (off_t) offset, SEEK_SET) == (off_t) -1)
+/* Positioned I/O on the cache file, the file offset is never used so
+ * readers and writers don't need to serialize on it. Both return FALSE
+ * unless all the @size bytes were transferred. */
+static gboolean
+gst_shifter_cache_pwrite (gint fd, const guint8 * data, gsize size,
+    gsize pos)
+{
+  while (size) {
+#ifdef G_OS_WIN32
+    gssize ret = -1;
+
+    if (lseek (fd, pos, SEEK_SET) != (off_t) -1)
+      ret = write (fd, data, size);
+#else
+    gssize ret = pwrite (fd, data, size, pos);
+#endif
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    data += ret;
+    size -= ret;
+    pos += ret;
+  }
+  return TRUE;
+}
+
+static gboolean
+gst_shifter_cache_pread (gint fd, guint8 * data, gsize size, gsize pos)
+{
+  while (size) {
+#ifdef G_OS_WIN32
+    gssize ret = -1;
+
+    if (lseek (fd, pos, SEEK_SET) != (off_t) -1)
+      ret = read (fd, data, size);
+#else
+    gssize ret = pread (fd, data, size, pos);
+#endif
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return FALSE;
+    data += ret;
+    size -= ret;
+    pos += ret;
+  }
+  return TRUE;
+}
+
+/* Pushes the data written since the last sync towards the disk as mandated
+ * by @policy, @pos is the disk position written so far. It can block for a
+ * while, only the sync job calls it so s_dk_* need no lock */
+static void
+gst_shifter_cache_disk_sync (GstShifterCache * cache,
+    GstShifterCacheSyncPolicy policy, gsize pos)
+{
+  gsize synced = cache->s_dk_pos;
+
+  switch (policy) {
+    case GST_SHIFTER_CACHE_SYNC_RANGE:
+#ifdef HAVE_SYNC_FILE_RANGE
+      /* wait for the previous range and start the writeback of this one, this
+       * bounds the dirty data without stalling on every write */
+      if (synced > cache->s_dk_start) {
+        sync_file_range (cache->fd, cache->s_dk_start,
+            synced - cache->s_dk_start, SYNC_FILE_RANGE_WAIT_BEFORE |
+            SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+      }
+      sync_file_range (cache->fd, synced, pos - synced,
+          SYNC_FILE_RANGE_WRITE);
+#endif
+      break;
+    case GST_SHIFTER_CACHE_SYNC_DATA:
+#ifdef HAVE_FDATASYNC
+      if (fdatasync (cache->fd) < 0)
+#elif !defined (G_OS_WIN32)
+      if (fsync (cache->fd) < 0)
+#else
+      if (_commit (cache->fd) < 0)
+#endif
+        GST_WARNING ("could not sync the recording: %s", g_strerror (errno));
+      break;
+    default:
+      break;
+  }
+  cache->s_dk_start = synced;
+  cache->s_dk_pos = pos;
+}
+
+/* Syncs on a shared worker so neither the writer nor the streaming threads
+ * waiting on its locks are stalled by the disk */
+static void
+gst_shifter_cache_sync_job (GstShifterCache * cache)
+{
+  GstShifterCacheSyncPolicy policy;
+  gsize pos;
+
+  GST_CACHE_LOCK (cache);
+  policy = cache->sync_policy;
+  pos = cache->sync_pos;
+  GST_CACHE_UNLOCK (cache);
+
+  if (pos > cache->s_dk_pos)
+    gst_shifter_cache_disk_sync (cache, policy, pos);
+}
+
+/* see linux/ioprio.h */
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+
+/* Returns the I/O priority of the calling thread, -1 if unknown */
+static gint
+gst_shifter_cache_get_io_priority (void)
+{
+#if defined (__linux__) && defined (SYS_ioprio_get)
+  return syscall (SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
 #else
-#define FSEEK_FILE(file,offset)  (fseek (file, (long) offset, SEEK_SET) != 0)
+  return -1;
+#endif
+}
+
+/* Sets the I/O priority of the calling thread */
+static void
+gst_shifter_cache_set_thread_io_priority (gint prio)
+{
+#if defined (__linux__) && defined (SYS_ioprio_set)
+  if (prio < 0)
+    return;
+
+  if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, prio) < 0) {
+    GST_WARNING ("failed to set io priority %d: %s", prio,
+        g_strerror (errno));
+  }
+#endif
+}
+
+/* Applies the configured I/O scheduling class to the calling thread if it
+ * changed since the last call. @applied holds the priority set by the
+ * previous call, -1 if none, and @saved the one the thread had before the
+ * first call, restored when the class is set back to none. Must be called
+ * with the cache lock */
+static void
+gst_shifter_cache_update_io_priority (GstShifterCache * cache, gint * applied,
+    gint saved)
+{
+  gint prio = -1;
+
+  if (cache->io_class != GST_SHIFTER_CACHE_IO_CLASS_NONE)
+    prio = (cache->io_class << IOPRIO_CLASS_SHIFT) | cache->io_level;
+
+  if (prio == *applied)
+    return;
+
+  gst_shifter_cache_set_thread_io_priority (prio >= 0 ? prio : saved);
+  *applied = prio;
+}
+
+/* Takes @size bytes from the token bucket and returns the time the caller
+ * must wait before writing them to honour the rate limit. Must be called
+ * with the cache lock */
+static GstClockTime
+gst_shifter_cache_throttle (GstShifterCache * cache, gsize size)
+{
+  GstClockTime now;
+  gint64 burst;
+
+  if (cache->write_rate == 0)
+    return 0;
+
+  now = gst_util_get_timestamp ();
+  burst = MAX (cache->write_rate, CACHE_SLOT_SIZE);
+  if (GST_CLOCK_TIME_IS_VALID (cache->refill_time)) {
+    cache->tokens += gst_util_uint64_scale (now - cache->refill_time,
+        cache->write_rate, GST_SECOND);
+    cache->tokens = MIN (cache->tokens, burst);
+  } else {
+    cache->tokens = burst;
+  }
+  cache->refill_time = now;
+  /* don't let the live writes build up more than a bucket of debt */
+  cache->tokens = MAX (cache->tokens - (gint64) size, -burst);
+
+  if (cache->tokens >= 0)
+    return 0;
+
+  return gst_util_uint64_scale (-cache->tokens, GST_SECOND,
+      cache->write_rate);
+}
+
+/* Discards the recorded data before @offset. The data still being read can't
+ * be discarded. Must be called with the cache lock */
+static void
+gst_shifter_cache_disk_trim (GstShifterCache * cache, guint64 offset)
+{
+  guint64 base = cache->m_dk_offset;
+
+  offset = MIN (offset, base + cache->r_dk_pos);
+  if (offset <= cache->l_dk_offset)
+    return;
+
+  GST_INFO ("discarding disk data %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+      cache->l_dk_offset, offset);
+
+#if defined (HAVE_FALLOCATE) && defined (FALLOC_FL_PUNCH_HOLE)
+  /* give the space back to the filesystem */
+  if (fallocate (cache->fd,
+          FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+          cache->l_dk_offset - base, offset - cache->l_dk_offset) < 0) {
+    GST_WARNING ("could not release disk space: %s", g_strerror (errno));
+  }
+#endif
+  cache->l_dk_offset = offset;
+  gst_shifter_cache_publish_levels (cache);
+}
+
+/* Updates the disk state from the free space of the recording filesystem.
+ * Must be called with the cache lock */
+static void
+gst_shifter_cache_check_space (GstShifterCache * cache)
+{
+#if defined (HAVE_SYS_STATVFS_H) && defined (HAVE_FSTATVFS)
+  struct statvfs st;
+
+  if (fstatvfs (cache->fd, &st) < 0) {
+    GST_WARNING ("could not get the free space: %s", g_strerror (errno));
+    return;
+  }
+  cache->free_space = (guint64) st.f_bavail * st.f_frsize;
+
+  GST_LOG ("free space on disk %" G_GUINT64_FORMAT, cache->free_space);
+
+  if (cache->free_space < cache->critical_space) {
+    GST_WARNING ("free space below critical threshold, stop using the disk");
+    cache->disk_failed = TRUE;
+  } else if (cache->free_space < cache->low_space) {
+    cache->disk_state = GST_SHIFTER_CACHE_DISK_LOW;
+    /* the migration writes in front of the window, don't touch it yet */
+    if (cache->is_rb_migrated) {
+      guint64 needed = cache->low_space - cache->free_space;
+
+      needed = GST_ROUND_UP_N (needed, CACHE_SLOT_SIZE);
+      gst_shifter_cache_disk_trim (cache, cache->l_dk_offset + needed);
+    }
+  } else {
+    cache->disk_state = GST_SHIFTER_CACHE_DISK_OK;
+  }
 #endif
+}
+
+/* Accounts a disk write that took @elapsed, called with the lock */
+static inline void
+gst_shifter_cache_account_write (GstShifterCache * cache, GstClockTime elapsed)
+{
+  cache->writes++;
+  cache->write_time += elapsed;
+  cache->max_write_time = MAX (cache->max_write_time, elapsed);
+}
 
 static inline gboolean
 gst_shifter_cache_disk_write (GstShifterCache * cache, guint8 * data,
     guint size)
 {
   gboolean ret = FALSE;
+  gboolean sync = FALSE;
+  gint prio = -1, saved_prio = -1;
+  GstClockTime start, end;
 
-  g_return_val_if_fail (cache->file, FALSE);
+  g_return_val_if_fail (cache->fd != -1, FALSE);
 
   GST_CACHE_LOCK (cache);
-
+  /* live data can't be dropped, the writer is held back instead */
+  cache->write_delay = gst_shifter_cache_throttle (cache, size);
+  if (cache->io_class != GST_SHIFTER_CACHE_IO_CLASS_NONE)
+    prio = (cache->io_class << IOPRIO_CLASS_SHIFT) | cache->io_level;
 #if DEBUG_DISK
   GST_LOG ("pre  disk_write: dw %" G_GSIZE_FORMAT " dr: %" G_GSIZE_FORMAT,
       cache->w_dk_pos, cache->r_dk_pos);
 #endif
+  GST_CACHE_UNLOCK (cache);
 
-  if (FSEEK_FILE (cache->file, cache->w_dk_pos)) {
-    goto beach;
+  /* the streaming thread is not ours, only borrow it for the write */
+  if (prio >= 0) {
+    saved_prio = gst_shifter_cache_get_io_priority ();
+    gst_shifter_cache_set_thread_io_priority (prio);
   }
-  ret = fwrite (data, size, 1, cache->file);
-  if (ret) {
-    cache->w_dk_pos += size;
+
+  /* w_dk_pos only moves here and the readers stop before it, the data can be
+   * written without blocking them */
+  start = gst_util_get_timestamp ();
+  ret = gst_shifter_cache_pwrite (cache->fd, data, size, cache->w_dk_pos);
+  end = gst_util_get_timestamp ();
+
+  if (prio >= 0)
+    gst_shifter_cache_set_thread_io_priority (saved_prio);
+
+  GST_CACHE_LOCK (cache);
+  cache->last_write = end;
+  if (!ret) {
+    GST_ERROR ("failed writing to the disk: %s", g_strerror (errno));
+    cache->disk_failed = TRUE;
+    goto beach;
   }
-  fflush (cache->file);
+
+  gst_shifter_cache_account_write (cache, end - start);
+  FLUCACHE_PROBE3 (disk_write, cache->w_dk_pos, size, cache->h_offset);
+  cache->w_dk_pos += size;
   cache->h_offset += size;
   cache->h_dk_offset = cache->h_offset;
+  cache->write_bytes += size;
+  gst_shifter_cache_publish_levels (cache);
+
+  if (cache->disk_window && cache->is_rb_migrated &&
+      cache->h_dk_offset - cache->l_dk_offset >
+      cache->disk_window + CACHE_SLOT_SIZE) {
+    guint64 offset = cache->h_dk_offset - cache->disk_window;
+
+    gst_shifter_cache_disk_trim (cache, offset - offset % CACHE_SLOT_SIZE);
+  }
+
+  if (cache->w_dk_pos - cache->space_check_pos >= SPACE_CHECK_INTERVAL) {
+    cache->space_check_pos = cache->w_dk_pos;
+    gst_shifter_cache_check_space (cache);
+  }
+
+  if (cache->sync_policy != GST_SHIFTER_CACHE_SYNC_NONE &&
+      cache->w_dk_pos - cache->sync_pos >= cache->sync_interval) {
+    cache->sync_pos = cache->w_dk_pos;
+    sync = TRUE;
+  }
 
 #if DEBUG_DISK
   GST_LOG ("post disk_write: dw %" G_GSIZE_FORMAT " dr: %" G_GSIZE_FORMAT,
@@ -389,6 +866,10 @@ gst_shifter_cache_disk_write (GstShifterCache * cache, guint8 * data,
 
 beach:
   GST_CACHE_UNLOCK (cache);
+
+  if (sync)
+    gst_flutsscheduler_job_queue (&cache->sync_job);
+
   return ret;
 }
 
@@ -397,9 +878,10 @@ gst_shifter_cache_disk_read (GstShifterCache * cache, Slot * slot,
     guint64 offset, gboolean drain)
 {
   gboolean ret = FALSE;
+  GstClockTime start;
   gsize size;
 
-  g_return_val_if_fail (cache->file, FALSE);
+  g_return_val_if_fail (cache->fd != -1, FALSE);
 
   size = MIN (cache->w_dk_pos - cache->r_dk_pos, CACHE_SLOT_SIZE);
 
@@ -418,59 +900,206 @@ gst_shifter_cache_disk_read (GstShifterCache * cache, Slot * slot,
   if (!slot_available (slot, NULL))
     return FALSE;
 
-  GST_CACHE_LOCK (cache);
-  if (FSEEK_FILE (cache->file, cache->r_dk_pos)) {
-    goto beach;
-  }
+  /* r_dk_pos is only changed by the reader, no need to lock for the read */
+  start = gst_util_get_timestamp ();
+  ret = gst_shifter_cache_pread (cache->fd, slot->data, size,
+      cache->r_dk_pos);
 
-  ret = fread (slot->data, size, 1, cache->file);
+  GST_CACHE_LOCK (cache);
   if (ret) {
+    GstClockTime elapsed = gst_util_get_timestamp () - start;
+
+    FLUCACHE_PROBE4 (disk_read, cache->r_dk_pos, size, offset, elapsed);
     slot->offset = offset;
     slot->size = size;
-    g_atomic_int_set (&slot->state, STATE_FULL);
+    gst_shifter_cache_shm_commit (cache, slot);
+    slot_set_state (slot, STATE_FULL);
     cache->r_dk_pos += size;
+    cache->read_bytes += size;
+
+    cache->reads++;
+    cache->read_time += elapsed;
+    cache->max_read_time = MAX (cache->max_read_time, elapsed);
+    if ((cache->migrating && !cache->is_rb_migrated) ||
+        (GST_CLOCK_TIME_IS_VALID (cache->last_write) &&
+            start < cache->last_write + WRITE_LOAD_WINDOW)) {
+      cache->loaded_reads++;
+      cache->loaded_read_time += elapsed;
+    }
   }
 #if DEBUG_DISK
   GST_LOG ("post disk_read: dw %" G_GSIZE_FORMAT " dr: %" G_GSIZE_FORMAT,
       cache->w_dk_pos, cache->r_dk_pos);
 #endif
-
-beach:
   GST_CACHE_UNLOCK (cache);
+
   return ret;
 }
 
+static gboolean
+gst_shifter_cache_write_all (gint fd, guint8 * data, gsize size)
+{
+  while (size) {
+    gssize ret = write (fd, data, size);
+
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    data += ret;
+    size -= ret;
+  }
+  return TRUE;
+}
+
+/* Copy up to @size bytes found at @pos in the cache file to @fd.
+ * Returns the number of bytes copied or -1 on error. */
+static gssize
+gst_shifter_cache_disk_copy (GstShifterCache * cache, gsize pos, gsize size,
+    gint fd)
+{
+  guint8 buf[CACHE_SLOT_SIZE];
+  gssize ret = -1;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  {
+    off_t in_pos = pos;
+
+    ret = copy_file_range (cache->fd, &in_pos, fd, NULL, size, 0);
+    if (ret >= 0 || (errno != EXDEV && errno != ENOSYS && errno != EINVAL
+            && errno != EOPNOTSUPP))
+      return ret;
+  }
+#endif
+#ifdef HAVE_SENDFILE
+  {
+    off_t in_pos = pos;
+
+    ret = sendfile (fd, cache->fd, &in_pos, size);
+    if (ret >= 0 || (errno != EINVAL && errno != ENOSYS))
+      return ret;
+  }
+#endif
+
+  /* no kernel side copy, bounce it through the stack */
+  size = MIN (size, sizeof (buf));
+  if (!gst_shifter_cache_pread (cache->fd, buf, size, pos))
+    return -1;
+
+  if (!gst_shifter_cache_write_all (fd, buf, size))
+    return -1;
+
+  return size;
+}
+
+/* Allocates the memory of the ring buffer in a memfd so it can be mapped by
+ * other processes */
+static gboolean
+gst_shifter_cache_shm_alloc (GstShifterCache * cache)
+{
+#ifdef HAVE_MEMFD_CREATE
+  FluCacheShmHeader *hdr;
+  gsize page = sysconf (_SC_PAGESIZE), data_offset;
+  gint fd;
+
+  data_offset = sizeof (FluCacheShmHeader) +
+      cache->nslots * sizeof (FluCacheShmSlot);
+  data_offset = GST_ROUND_UP_N (data_offset, page);
+  cache->shm_size = data_offset + (gsize) cache->nslots * CACHE_SLOT_SIZE;
+
+  fd = memfd_create ("flucache", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    goto failed;
+  if (ftruncate (fd, cache->shm_size) < 0)
+    goto failed;
+  /* readers can rely on the size of the mapping */
+  if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0)
+    goto failed;
+
+  hdr = mmap (NULL, cache->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+      fd, 0);
+  if (hdr == MAP_FAILED)
+    goto failed;
+
+  hdr->magic = FLUCACHE_SHM_MAGIC;
+  hdr->version = FLUCACHE_SHM_VERSION;
+  hdr->slot_size = CACHE_SLOT_SIZE;
+  hdr->nslots = cache->nslots;
+  hdr->data_offset = data_offset;
+  hdr->seq = 0;
+  hdr->l_offset = hdr->h_offset = 0;
+  memset (FLUCACHE_SHM_SLOTS (hdr), 0,
+      cache->nslots * sizeof (FluCacheShmSlot));
+
+  cache->shm = hdr;
+  cache->shm_fd = fd;
+  cache->memory = (guint8 *) hdr + data_offset;
+
+  return TRUE;
+
+failed:
+  GST_ERROR ("could not create the shared memory: %s", g_strerror (errno));
+  if (fd >= 0)
+    close (fd);
+#endif
+  return FALSE;
+}
+
+/* Allocates a slot, its data is in the shared memory at @index or in a
+ * block of its own */
+static Slot *
+gst_shifter_cache_slot_new (GstShifterCache * cache, guint index)
+{
+  Slot *slot = g_new (Slot, 1);
+
+  slot->state = STATE_EMPTY;
+  slot->offset = INVALID_OFFSET;
+  slot->size = 0;
+  slot->index = index;
+  if (cache->shm)
+    slot->data = cache->memory + (gsize) index * CACHE_SLOT_SIZE;
+  else
+    slot->data = g_malloc (CACHE_SLOT_SIZE);
+  slot->wptr = slot->data;
+
+  return slot;
+}
+
+static void
+gst_shifter_cache_slot_free (GstShifterCache * cache, Slot * slot)
+{
+  if (!cache->shm)
+    g_free (slot->data);
+  g_free (slot);
+}
+
 static inline void
 gst_shifter_cache_flush (GstShifterCache * cache)
 {
   guint i;
   for (i = 0; i < cache->nslots; i++) {
-    Slot *slot = &cache->slots[i];
+    Slot *slot = cache->slots[i];
+    gst_shifter_cache_shm_invalidate (cache, slot);
     slot->state = STATE_EMPTY;
     slot->offset = INVALID_OFFSET;
-    slot->wptr = slot->data = cache->memory + (i * CACHE_SLOT_SIZE);
+    slot->wptr = slot->data;
     slot->size = 0;
   }
   cache->head = cache->tail = 0;
   cache->fslots = 0;
+  cache->skip_offset = 0;
   cache->need_discont = TRUE;
 }
 
-/**
- * gst_shifter_cache_new:
- * @size: cache size
- *
- * Create a new cache instance. @size will be rounded up to the
- * nearest CACHE_SLOT_SIZE multiple and used as the ringbuffer size.
- *
- * Returns: a new #GstShifterCache
- *
- */
-GstShifterCache *
-gst_shifter_cache_new (gsize size, gchar * filename_template)
+static void gst_shifter_cache_migration_job (GstShifterCache * cache);
+
+static GstShifterCache *
+gst_shifter_cache_new_full (gsize size, gchar * filename_template,
+    gboolean shared)
 {
   GstShifterCache *cache;
-  guint nslots;
+  guint i, nslots;
 
   cache = g_new (GstShifterCache, 1);
 
@@ -485,26 +1114,89 @@ gst_shifter_cache_new (gsize size, gchar * filename_template)
   cache->h_dk_offset = INVALID_OFFSET;
   cache->m_dk_offset = INVALID_OFFSET;
 
+  cache->cursors = NULL;
+  cache->c_offset = G_MAXUINT64;
+
   /* Disk */
-  cache->file = NULL;
+  cache->fd = -1;
   cache->filename_template = g_strdup (filename_template);
   cache->filename = NULL;
   cache->autoremove = TRUE;
   cache->w_dk_pos = 0;
   cache->r_dk_pos = 0;
   cache->m_dk_pos = 0;
+  cache->sync_policy = GST_SHIFTER_CACHE_SYNC_NONE;
+  cache->sync_interval = 4 * 1024 * 1024;
+  cache->s_dk_start = 0;
+  cache->s_dk_pos = 0;
+  cache->sync_pos = 0;
+  gst_flutsscheduler_job_init (&cache->sync_job,
+      (GstFluTSSchedulerFunc) gst_shifter_cache_sync_job, cache);
   cache->is_recording = FALSE;
   cache->is_rb_migrated = FALSE;
   cache->stop_recording = FALSE;
   cache->thread = NULL;
+  cache->shared_scheduler = FALSE;
+  gst_flutsscheduler_job_init (&cache->migration_job,
+      (GstFluTSSchedulerFunc) gst_shifter_cache_migration_job, cache);
+  cache->migrating = FALSE;
+  cache->low_space = 0;
+  cache->critical_space = 0;
+  cache->disk_window = 0;
+  cache->free_space = G_MAXUINT64;
+  cache->space_check_pos = 0;
+  cache->disk_state = GST_SHIFTER_CACHE_DISK_OK;
+  cache->disk_failed = FALSE;
+  cache->disk_disabled = FALSE;
   gst_shifter_cache_disk_open (cache);
 
-  /* Ring buffer */
+  /* Background writes */
+  cache->io_class = GST_SHIFTER_CACHE_IO_CLASS_NONE;
+  cache->io_level = 4;
+  cache->write_rate = 0;
+  cache->tokens = 0;
+  cache->refill_time = GST_CLOCK_TIME_NONE;
+  cache->write_delay = 0;
+  cache->last_write = GST_CLOCK_TIME_NONE;
+  cache->reads = 0;
+  cache->loaded_reads = 0;
+  cache->read_time = 0;
+  cache->loaded_read_time = 0;
+  cache->max_read_time = 0;
+  cache->writes = 0;
+  cache->write_time = 0;
+  cache->max_write_time = 0;
+  cache->reloads = 0;
+  cache->read_bytes = 0;
+  cache->write_bytes = 0;
+  cache->migration_time = GST_CLOCK_TIME_NONE;
+
+  /* Ring buffer, the memory manager can only make it smaller */
   nslots = size / CACHE_SLOT_SIZE;
+  cache->max_slots = nslots;
+  if (!shared)
+    nslots = MAX (gst_flucachemanager_add (cache,
+            (gsize) nslots * CACHE_SLOT_SIZE) / CACHE_SLOT_SIZE, MIN_SLOTS);
+  else
+    gst_flucachemanager_add (cache, (gsize) nslots * CACHE_SLOT_SIZE);
   cache->nslots = nslots;
-  cache->memory = g_malloc (nslots * CACHE_SLOT_SIZE);
+  cache->shm = NULL;
+  cache->shm_size = 0;
+  cache->shm_fd = -1;
+  cache->memory = NULL;
+  if (shared)
+    gst_shifter_cache_shm_alloc (cache);
 
-  cache->slots = (Slot *) g_new (Slot, nslots);
+  cache->slots = g_new (Slot *, nslots);
+  for (i = 0; i < nslots; i++)
+    cache->slots[i] = gst_shifter_cache_slot_new (cache, i);
+
+  cache->exports = 0;
+  cache->resize_slots = 0;
+  cache->balance_time = 0;
+
+  cache->levels_seq = 0;
+  gst_shifter_cache_publish_levels (cache);
 
   gst_shifter_cache_flush (cache);
 
@@ -512,32 +1204,81 @@ gst_shifter_cache_new (gsize size, gchar * filename_template)
 }
 
 /**
- * gst_shifter_cache_ref:
- * @cache: a #GstShifterCache
+ * gst_shifter_cache_new:
+ * @size: cache size
  *
- * Increase the refcount of @cache.
+ * Create a new cache instance. @size will be rounded up to the
+ * nearest CACHE_SLOT_SIZE multiple and used as the ringbuffer size.
+ *
+ * Returns: a new #GstShifterCache
  *
  */
 GstShifterCache *
-gst_shifter_cache_ref (GstShifterCache * cache)
+gst_shifter_cache_new (gsize size, gchar * filename_template)
 {
-  g_return_val_if_fail (cache != NULL, NULL);
-
-  g_atomic_int_inc (&cache->refcount);
-
-  return cache;
+  return gst_shifter_cache_new_full (size, filename_template, FALSE);
 }
 
-static void
-gst_shifter_cache_free (GstShifterCache * cache)
-{
-  gst_shifter_cache_disk_close (cache);
-  g_free (cache->filename_template);
-  g_free (cache->filename);
+/**
+ * gst_shifter_cache_new_shared:
+ * @size: cache size
+ *
+ * Like gst_shifter_cache_new() but the ringbuffer lives in a memfd that other
+ * processes can map read-only to access the cached data without copies, see
+ * flucacheshm.h for the layout. Falls back to private memory when memfd is
+ * not available.
+ *
+ * Returns: a new #GstShifterCache
+ *
+ */
+GstShifterCache *
+gst_shifter_cache_new_shared (gsize size, gchar * filename_template)
+{
+  return gst_shifter_cache_new_full (size, filename_template, TRUE);
+}
+
+/**
+ * gst_shifter_cache_ref:
+ * @cache: a #GstShifterCache
+ *
+ * Increase the refcount of @cache.
+ *
+ */
+GstShifterCache *
+gst_shifter_cache_ref (GstShifterCache * cache)
+{
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  g_atomic_int_inc (&cache->refcount);
+
+  return cache;
+}
+
+static void
+gst_shifter_cache_free (GstShifterCache * cache)
+{
+  guint i;
 
-  g_free (cache->memory);
+  gst_flucachemanager_remove (cache);
+  gst_flutsscheduler_job_stop (&cache->migration_job);
+  gst_flutsscheduler_job_stop (&cache->sync_job);
+  gst_shifter_cache_disk_close (cache);
+  g_free (cache->filename_template);
+  g_free (cache->filename);
+
+  if (cache->shm) {
+#ifdef HAVE_MEMFD_CREATE
+    munmap (cache->shm, cache->shm_size);
+    close (cache->shm_fd);
+#endif
+  }
+  for (i = 0; i < cache->nslots; i++)
+    gst_shifter_cache_slot_free (cache, cache->slots[i]);
   g_free (cache->slots);
 
+  g_slist_foreach (cache->cursors, (GFunc) g_free, NULL);
+  g_slist_free (cache->cursors);
+
   g_mutex_free (cache->lock);
 
   g_free (cache);
@@ -559,15 +1300,39 @@ gst_shifter_cache_unref (GstShifterCache * cache)
     gst_shifter_cache_free (cache);
 }
 
+/* Returns TRUE if the data of @slot is only in the ring buffer and a cursor
+ * didn't read it yet */
+static inline gboolean
+gst_shifter_cache_slot_pinned (GstShifterCache * cache, Slot * slot)
+{
+  gboolean pinned = FALSE;
+
+  if (G_LIKELY (cache->cursors == NULL) || slot->offset == INVALID_OFFSET)
+    return FALSE;
+
+  GST_CACHE_LOCK (cache);
+  if (!(cache->is_recording && cache->is_rb_migrated))
+    pinned = slot->offset + slot->size > cache->c_offset;
+  GST_CACHE_UNLOCK (cache);
+
+  return pinned;
+}
+
 static inline gboolean
 gst_shifter_cache_recycle (GstShifterCache * cache, Slot * slot)
 {
   gboolean recycle;
-  recycle = g_atomic_int_compare_and_exchange (&slot->state, STATE_RECYCLE,
-      STATE_EMPTY);
+
+  if (g_atomic_int_get (&slot->state) == STATE_RECYCLE &&
+      gst_shifter_cache_slot_pinned (cache, slot))
+    return FALSE;
+
+  recycle = slot_transition (slot, STATE_RECYCLE, STATE_EMPTY);
   if (recycle) {
+    gst_shifter_cache_shm_invalidate (cache, slot);
+    /* slots dropped when disabling the disk can be recycled late */
     if (slot->offset != INVALID_OFFSET)
-      cache->l_rb_offset = slot->offset + slot->size;
+      cache->l_rb_offset = MAX (cache->l_rb_offset, slot->offset + slot->size);
     slot->offset = INVALID_OFFSET;
     slot->size = 0;
     slot->wptr = slot->data;
@@ -579,8 +1344,7 @@ static inline gboolean
 gst_shifter_cache_rollback (GstShifterCache * cache, Slot * slot)
 {
   gboolean rollback;
-  rollback = g_atomic_int_compare_and_exchange (&slot->state, STATE_RECYCLE,
-      STATE_FULL);
+  rollback = slot_transition (slot, STATE_RECYCLE, STATE_FULL);
   if (rollback) {
     g_atomic_int_inc (&cache->fslots);
   } else if (g_atomic_int_get (&slot->state) == STATE_FULL) {
@@ -593,8 +1357,7 @@ static inline gboolean
 gst_shifter_cache_rollforward (GstShifterCache * cache, Slot * slot)
 {
   gboolean rollforward;
-  rollforward = g_atomic_int_compare_and_exchange (&slot->state, STATE_FULL,
-      STATE_RECYCLE);
+  rollforward = slot_transition (slot, STATE_FULL, STATE_RECYCLE);
   if (rollforward) {
     g_atomic_int_add (&cache->fslots, -1);
   } else if (g_atomic_int_get (&slot->state) == STATE_RECYCLE) {
@@ -603,46 +1366,129 @@ gst_shifter_cache_rollforward (GstShifterCache * cache, Slot * slot)
   return rollforward;
 }
 
-static void
-gst_shifter_cache_migration_thread (GstShifterCache * cache)
+/* Copies the next slot of the ring buffer to the disk. Returns how long to
+ * wait before the next one, GST_CLOCK_TIME_NONE once the migration is over */
+static GstClockTime
+gst_shifter_cache_migrate_slot (GstShifterCache * cache, gint * applied_prio,
+    gint saved_prio)
 {
-  guint i, j = cache->tail;
+  Slot *slot = NULL;
+  guint8 *data;
+  gsize size, pos;
+  gboolean ret;
+  GstClockTime start, end, wait = GST_CLOCK_TIME_NONE;
 
-  for (i = 0; i < cache->nslots; i++) {
-    Slot *slot = &cache->slots[j];
-    j = (j + 1) % cache->nslots;
-    if (g_atomic_int_get (&slot->state) == STATE_EMPTY) {
-      continue;
-    }
+  GST_CACHE_LOCK (cache);
+  gst_shifter_cache_update_io_priority (cache, applied_prio, saved_prio);
+  if (G_UNLIKELY ((cache->stop_recording && cache->autoremove) ||
+          cache->disk_failed || cache->disk_disabled)) {
+    GST_INFO ("ring buffer migration aborted");
+    goto beach;
+  }
 
-    GST_CACHE_LOCK (cache);
-    if (G_UNLIKELY (cache->stop_recording && cache->autoremove)) {
-      GST_INFO ("ring buffer migration aborted");
-      goto beach;
-    }
+  while (cache->migrate_left > 0 && slot == NULL) {
+    slot = cache->slots[cache->migrate_slot];
+    cache->migrate_slot = (cache->migrate_slot + 1) % cache->nslots;
+    cache->migrate_left--;
+    if (g_atomic_int_get (&slot->state) == STATE_EMPTY)
+      slot = NULL;
+  }
 
-    if (!FSEEK_FILE (cache->file, cache->m_dk_pos)) {
-      if (fwrite (slot->data, slot->size, 1, cache->file)) {
-        cache->m_dk_pos += slot->size;
-        fflush (cache->file);
-      }
+  if (slot == NULL) {
+    cache->l_dk_offset = cache->m_dk_offset;
+    cache->is_rb_migrated = TRUE;
+    gst_shifter_cache_publish_levels (cache);
+    cache->migration_time = gst_util_get_timestamp () - cache->mtime;
+    FLUCACHE_PROBE2 (migration_finish, cache->m_dk_pos,
+        cache->migration_time);
+
+    GST_INFO ("ring buffer migration finished in %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (cache->migration_time));
+    dump_cache_state (cache, "post-migration");
+    goto beach;
+  }
+
+  /* the ring is not written while recording and m_dk_pos only moves here,
+   * don't block the readers and the live writer on the disk */
+  data = slot->data;
+  size = slot->size;
+  pos = cache->m_dk_pos;
+  GST_CACHE_UNLOCK (cache);
+
+  start = gst_util_get_timestamp ();
+  ret = gst_shifter_cache_pwrite (cache->fd, data, size, pos);
+  end = gst_util_get_timestamp ();
+
+  GST_CACHE_LOCK (cache);
+  cache->last_write = end;
+  if (!ret) {
+    GST_ERROR ("ring buffer migration failed: %s", g_strerror (errno));
+    cache->disk_failed = TRUE;
+    goto beach;
+  }
+  cache->m_dk_pos += size;
+  cache->write_bytes += size;
+  gst_shifter_cache_account_write (cache, end - start);
+  wait = gst_shifter_cache_throttle (cache, size);
+
+beach:
+  GST_CACHE_UNLOCK (cache);
+  return wait;
+}
+
+/* Copies the ring buffer to the disk */
+static void
+gst_shifter_cache_migrate (GstShifterCache * cache)
+{
+  GstClockTime wait;
+  gint saved_prio, applied_prio = -1;
+  guint i = 0;
+
+  saved_prio = gst_shifter_cache_get_io_priority ();
+
+  while ((wait = gst_shifter_cache_migrate_slot (cache, &applied_prio,
+              saved_prio)) != GST_CLOCK_TIME_NONE) {
+    if (wait) {
+      g_usleep (wait / GST_USECOND);
     }
-    GST_CACHE_UNLOCK (cache);
-    if ((i % 8) == 0) {
+    if ((i++ % 8) == 0) {
       /* Ensure other threads are scheduled */
       g_thread_yield ();
     }
   }
-  GST_CACHE_LOCK (cache);
-  cache->l_dk_offset = cache->m_dk_offset;
-  cache->is_rb_migrated = TRUE;
 
-  GST_INFO ("ring buffer migration finished in %" GST_TIME_FORMAT,
-      GST_TIME_ARGS (GST_CLOCK_DIFF (cache->mtime, gst_util_get_timestamp ())));
-  dump_cache_state (cache, "post-migration");
+  if (applied_prio >= 0)
+    gst_shifter_cache_set_thread_io_priority (saved_prio);
+}
+
+/* Copies one slot per run so the instances sharing the workers take turns,
+ * a throttled migration is queued again later instead of sleeping */
+static void
+gst_shifter_cache_migration_job (GstShifterCache * cache)
+{
+  GstClockTime wait;
+  gint saved_prio, applied_prio = -1;
+
+  /* the worker is shared, give it its priority back */
+  saved_prio = gst_shifter_cache_get_io_priority ();
+  wait = gst_shifter_cache_migrate_slot (cache, &applied_prio, saved_prio);
+  if (applied_prio >= 0)
+    gst_shifter_cache_set_thread_io_priority (saved_prio);
+
+  if (wait == GST_CLOCK_TIME_NONE)
+    return;
+  if (wait) {
+    gst_flutsscheduler_job_queue_delayed (&cache->migration_job,
+        wait / GST_USECOND);
+  } else {
+    gst_flutsscheduler_job_queue (&cache->migration_job);
+  }
+}
 
-beach:
-  GST_CACHE_UNLOCK (cache);
+static void
+gst_shifter_cache_migration_thread (GstShifterCache * cache)
+{
+  gst_shifter_cache_migrate (cache);
   gst_shifter_cache_unref (cache);
 }
 
@@ -652,24 +1498,38 @@ gst_shifter_cache_start_recording (GstShifterCache * cache)
   GError *error = NULL;
   gboolean ret = TRUE;
 
-  g_return_val_if_fail (cache->file, FALSE);
+  g_return_val_if_fail (cache->fd != -1, FALSE);
 
   GST_CACHE_LOCK (cache);
-  if (G_LIKELY (cache->thread != NULL)) {
+  if (G_LIKELY (cache->migrating)) {
     goto beach;                 /* Thread already running. Nothing to do */
   }
-  if (G_UNLIKELY (cache->stop_recording)) {
+  if (G_UNLIKELY (cache->stop_recording || cache->disk_disabled)) {
     ret = FALSE;
     goto beach;
   }
   cache->m_dk_offset = cache->l_rb_offset;
   cache->l_dk_offset = cache->h_offset;
   cache->w_dk_pos = cache->h_offset - cache->l_rb_offset;
+  cache->migrate_slot = cache->tail;
+  cache->migrate_left = cache->nslots;
   cache->mtime = gst_util_get_timestamp ();
   cache->is_recording = TRUE;
+  gst_shifter_cache_publish_levels (cache);
+  FLUCACHE_PROBE2 (migration_start, cache->m_dk_offset, cache->w_dk_pos);
   GST_INFO ("ring buffer migration started");
   dump_cache_state (cache, "pre-migration");
 
+  /* the syncs always go to the shared workers, one per sync interval */
+  gst_flutsscheduler_job_start (&cache->sync_job);
+
+  cache->migrating = TRUE;
+  if (cache->shared_scheduler) {
+    /* freed after gst_shifter_cache_stop_recording(), no ref needed */
+    gst_flutsscheduler_job_start (&cache->migration_job);
+    goto beach;
+  }
+
   cache->thread =
       g_thread_create ((GThreadFunc) gst_shifter_cache_migration_thread,
       gst_shifter_cache_ref (cache), TRUE, &error);
@@ -684,6 +1544,7 @@ beach:
   /* ERRORS */
 no_thread:
   {
+    cache->migrating = FALSE;
     GST_CACHE_UNLOCK (cache);
     GST_ERROR ("could not create migration thread: %s", error->message);
     g_error_free (error);
@@ -701,10 +1562,15 @@ gst_shifter_cache_stop_recording (GstShifterCache * cache)
   /* Ensure that the ringbuffer is migrated to the file */
   if (cache->thread) {
     g_thread_join (cache->thread);
+  } else {
+    gst_flutsscheduler_job_join (&cache->migration_job);
   }
+  gst_flutsscheduler_job_join (&cache->sync_job);
   GST_CACHE_LOCK (cache);
   cache->thread = NULL;
+  cache->migrating = FALSE;
   cache->is_recording = FALSE;
+  gst_shifter_cache_publish_levels (cache);
   GST_CACHE_UNLOCK (cache);
 }
 
@@ -721,7 +1587,7 @@ gst_shifter_cache_reload (GstShifterCache * cache, gboolean drain)
   }
 
   for (i = 0; i < n; i++) {
-    Slot *tail = &cache->slots[cache->tail];
+    Slot *tail = cache->slots[cache->tail];
     gst_shifter_cache_recycle (cache, tail);
     if (gst_shifter_cache_disk_read (cache, tail, cache->h_rb_offset, drain)) {
       cache->tail = (cache->tail + 1) % cache->nslots;
@@ -731,6 +1597,40 @@ gst_shifter_cache_reload (GstShifterCache * cache, gboolean drain)
       break;
     }
   }
+
+  FLUCACHE_PROBE3 (reload, n, i, cache->h_rb_offset);
+
+  if (i) {
+    GST_CACHE_LOCK (cache);
+    cache->reloads++;
+    gst_shifter_cache_publish_levels (cache);
+    GST_CACHE_UNLOCK (cache);
+  }
+}
+
+/* Releases the full slots at the head holding only data before
+ * skip_offset, as if they were popped and recycled */
+static void
+gst_shifter_cache_release_skipped (GstShifterCache * cache)
+{
+  Slot *head = cache->slots[cache->head];
+  gboolean is_recording, is_rb_migrated;
+
+  while (g_atomic_int_get (&head->state) == STATE_FULL &&
+      head->offset + head->size <= cache->skip_offset) {
+    if (!gst_shifter_cache_rollforward (cache, head))
+      break;
+    cache->head = (cache->head + 1) % cache->nslots;
+
+    GST_CACHE_LOCK (cache);
+    is_recording = cache->is_recording;
+    is_rb_migrated = cache->is_rb_migrated;
+    GST_CACHE_UNLOCK (cache);
+
+    if (is_recording && is_rb_migrated)
+      gst_shifter_cache_reload (cache, FALSE);
+    head = cache->slots[cache->head];
+  }
 }
 
 /**
@@ -754,17 +1654,19 @@ gst_shifter_cache_pop (GstShifterCache * cache, gboolean drain)
   dump_cache_state (cache, "pre-pop");
 #endif
 
-  head = &cache->slots[cache->head];
+  if (G_UNLIKELY (cache->skip_offset))
+    gst_shifter_cache_release_skipped (cache);
+
+  head = cache->slots[cache->head];
 
   if (drain) {
-    if (g_atomic_int_compare_and_exchange (&head->state, STATE_PART,
-            STATE_FULL)) {
+    if (slot_transition (head, STATE_PART, STATE_FULL)) {
       cache->h_rb_offset = head->offset + head->size;
       g_atomic_int_inc (&cache->fslots);
     }
   }
 
-  pop = g_atomic_int_compare_and_exchange (&head->state, STATE_FULL, STATE_POP);
+  pop = slot_transition (head, STATE_FULL, STATE_POP);
 
   if (pop) {
     gboolean is_recording, is_rb_migrated;
@@ -776,11 +1678,19 @@ gst_shifter_cache_pop (GstShifterCache * cache, gboolean drain)
 
     g_atomic_int_add (&cache->fslots, -1);
     buffer = GST_BUFFER_CAST (gst_slot_buffer_new (cache, head));
+    if (G_UNLIKELY (cache->skip_offset > head->offset)) {
+      /* the start of the slot was already consumed */
+      gst_buffer_resize (buffer, cache->skip_offset - head->offset, -1);
+      GST_BUFFER_OFFSET (buffer) = cache->skip_offset;
+    }
+    cache->skip_offset = 0;
     if (cache->need_discont) {
       GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
       cache->need_discont = FALSE;
     }
 
+    FLUCACHE_PROBE2 (pop, head->offset, head->size);
+
     cache->head = (cache->head + 1) % cache->nslots;
     if (is_recording && is_rb_migrated) {
       gst_shifter_cache_reload (cache, drain);
@@ -793,6 +1703,251 @@ gst_shifter_cache_pop (GstShifterCache * cache, gboolean drain)
   return buffer;
 }
 
+/* Empties the ring buffer so it continues at @offset. Unlike
+ * gst_shifter_cache_flush() the slots still in use downstream are left
+ * alone, they get recycled when they come back. */
+static void
+gst_shifter_cache_clear_ring (GstShifterCache * cache, guint64 offset)
+{
+  guint i;
+
+  for (i = 0; i < cache->nslots; i++) {
+    Slot *slot = cache->slots[i];
+
+    if (slot_transition (slot, STATE_FULL, STATE_EMPTY) ||
+        slot_transition (slot, STATE_PART, STATE_EMPTY) ||
+        slot_transition (slot, STATE_RECYCLE, STATE_EMPTY)) {
+      gst_shifter_cache_shm_invalidate (cache, slot);
+      slot->offset = INVALID_OFFSET;
+      slot->size = 0;
+      slot->wptr = slot->data;
+    }
+  }
+  g_atomic_int_set (&cache->fslots, 0);
+  cache->head = cache->tail;
+  cache->l_rb_offset = cache->h_rb_offset = offset;
+}
+
+/* Frees the oldest slot of a full ring buffer, used when there's no disk to
+ * grow into. Returns FALSE if the slot is still in use downstream. */
+static gboolean
+gst_shifter_cache_drop_oldest (GstShifterCache * cache, Slot * slot)
+{
+  if (gst_shifter_cache_slot_pinned (cache, slot) ||
+      !slot_transition (slot, STATE_FULL, STATE_EMPTY))
+    return FALSE;
+
+  gst_shifter_cache_shm_invalidate (cache, slot);
+  g_atomic_int_add (&cache->fslots, -1);
+  if (cache->head == cache->tail) {
+    /* the reader loses the data it was about to read */
+    cache->head = (cache->head + 1) % cache->nslots;
+    cache->need_discont = TRUE;
+  }
+  cache->l_rb_offset = MAX (cache->l_rb_offset, slot->offset + slot->size);
+  slot->offset = INVALID_OFFSET;
+  slot->size = 0;
+  slot->wptr = slot->data;
+
+  return TRUE;
+}
+
+/* Drops the oldest slot not read yet, the reader continues after it.
+ * Returns FALSE if the slot can't be dropped. */
+static gboolean
+gst_shifter_cache_evict_head (GstShifterCache * cache)
+{
+  Slot *head = cache->slots[cache->head];
+
+  if (gst_shifter_cache_slot_pinned (cache, head) ||
+      !slot_transition (head, STATE_FULL, STATE_EMPTY))
+    return FALSE;
+
+  gst_shifter_cache_shm_invalidate (cache, head);
+  g_atomic_int_add (&cache->fslots, -1);
+  cache->l_rb_offset = MAX (cache->l_rb_offset, head->offset + head->size);
+  head->offset = INVALID_OFFSET;
+  head->size = 0;
+  head->wptr = head->data;
+  cache->head = (cache->head + 1) % cache->nslots;
+  cache->need_discont = TRUE;
+
+  return TRUE;
+}
+
+/* Stops using the disk and keeps going with the ring buffer only. When the
+ * ring buffer was being refilled from the disk its content is dropped and
+ * the reading position jumps to the live edge. */
+static void
+gst_shifter_cache_disable_disk (GstShifterCache * cache)
+{
+  Slot *tail;
+  guint64 h_rb_offset;
+
+  GST_CACHE_LOCK (cache);
+  if (cache->disk_disabled)
+    goto beach;
+
+  GST_WARNING ("disabling the disk, continue in memory only");
+  cache->disk_disabled = TRUE;
+  cache->disk_state = GST_SHIFTER_CACHE_DISK_FULL;
+  cache->is_recording = FALSE;
+  gst_shifter_cache_publish_levels (cache);
+
+  tail = cache->slots[cache->tail];
+  h_rb_offset = cache->h_rb_offset;
+  if (g_atomic_int_get (&tail->state) == STATE_PART)
+    h_rb_offset += tail->size;
+
+  if (h_rb_offset != cache->h_offset) {
+    gst_shifter_cache_clear_ring (cache, cache->h_offset);
+    cache->need_discont = TRUE;
+  }
+
+beach:
+  GST_CACHE_UNLOCK (cache);
+}
+
+/* Drops the newest slots loaded from the disk, they are read again later.
+ * Called with the cache lock. */
+static void
+gst_shifter_cache_unload (GstShifterCache * cache, guint nslots)
+{
+  guint n = cache->nslots;
+
+  if (g_atomic_int_get (&cache->slots[cache->tail]->state) == STATE_PART)
+    return;
+
+  while (n > nslots) {
+    guint prev = (cache->tail + cache->nslots - 1) % cache->nslots;
+    Slot *slot = cache->slots[prev];
+
+    /* keep the head, the reader is about to pop it */
+    if (prev == cache->head ||
+        !slot_transition (slot, STATE_FULL, STATE_EMPTY))
+      break;
+
+    g_atomic_int_add (&cache->fslots, -1);
+    cache->h_rb_offset = slot->offset;
+    cache->r_dk_pos -= slot->size;
+    slot->offset = INVALID_OFFSET;
+    slot->size = 0;
+    slot->wptr = slot->data;
+    cache->tail = prev;
+    n--;
+  }
+}
+
+/* Resizes the ring buffer to @nslots, called from the writer. Slots are
+ * added after the tail and only the free ones are removed, or the ones
+ * loaded from the disk. If @spill the data that doesn't fit is recorded to
+ * the disk so it can be removed later. Returns the new number of slots. */
+static guint
+gst_shifter_cache_resize_ring (GstShifterCache * cache, guint nslots,
+    gboolean spill)
+{
+  Slot **slots;
+  guint i, j, n, t;
+  gboolean pinned;
+
+  nslots = MAX (nslots, MIN_SLOTS);
+
+  GST_CACHE_LOCK (cache);
+  n = cache->nslots;
+  /* the shared memory has a fixed size, and exports and the migration read
+   * the slots without the lock */
+  if (n == nslots || cache->shm || cache->exports ||
+      (cache->migrating && !cache->is_rb_migrated))
+    goto beach;
+
+  if (nslots < n && cache->is_recording && cache->is_rb_migrated)
+    gst_shifter_cache_unload (cache, nslots);
+
+  /* position of the tail from the head, the slots after it are free */
+  t = (cache->tail + n - cache->head) % n;
+  if (t == 0 &&
+      g_atomic_int_get (&cache->slots[cache->tail]->state) == STATE_FULL)
+    t = n;
+
+  pinned = cache->cursors && !(cache->is_recording && cache->is_rb_migrated);
+
+  slots = g_new (Slot *, MAX (n, nslots));
+  for (i = 0, j = 0; i < n; i++) {
+    Slot *slot = cache->slots[(cache->head + i) % n];
+
+    if (i > t && j + (n - i) > nslots) {
+      if (g_atomic_int_get (&slot->state) == STATE_EMPTY) {
+        gst_shifter_cache_slot_free (cache, slot);
+        continue;
+      }
+      if (!(pinned && slot->offset != INVALID_OFFSET &&
+              slot->offset + slot->size > cache->c_offset) &&
+          slot_transition (slot, STATE_RECYCLE, STATE_EMPTY)) {
+        if (slot->offset != INVALID_OFFSET)
+          cache->l_rb_offset =
+              MAX (cache->l_rb_offset, slot->offset + slot->size);
+        gst_shifter_cache_slot_free (cache, slot);
+        continue;
+      }
+    }
+    slot->index = j;
+    slots[j++] = slot;
+  }
+  for (; j < nslots; j++)
+    slots[j] = gst_shifter_cache_slot_new (cache, j);
+
+  g_free (cache->slots);
+  cache->slots = slots;
+  cache->nslots = j;
+  cache->head = 0;
+  cache->tail = t % j;
+  gst_shifter_cache_publish_levels (cache);
+
+  GST_DEBUG ("ring buffer resized from %u to %u slots", n, j);
+  dump_cache_state (cache, "post-resize");
+
+  if (j > nslots && spill && cache->fd != -1 && !cache->is_recording &&
+      !cache->disk_disabled) {
+    /* the slots can be removed once they are on the disk */
+    GST_CACHE_UNLOCK (cache);
+    gst_shifter_cache_start_recording (cache);
+    return j;
+  }
+
+beach:
+  n = cache->nslots;
+  GST_CACHE_UNLOCK (cache);
+  return n;
+}
+
+/* Reports our usage to the memory manager and applies the size it gives
+ * back, called from the writer */
+static void
+gst_shifter_cache_balance (GstShifterCache * cache)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  gsize size, cap, target;
+
+  if (G_LIKELY (now < cache->balance_time + BALANCE_INTERVAL))
+    return;
+  cache->balance_time = now;
+
+  if (G_UNLIKELY (cache->resize_slots)) {
+    /* finish a gst_shifter_cache_resize() waiting for the migration or
+     * for slots in use downstream */
+    if (gst_shifter_cache_resize_ring (cache, cache->resize_slots,
+            FALSE) <= cache->resize_slots)
+      cache->resize_slots = 0;
+    return;
+  }
+
+  size = (gsize) cache->nslots * CACHE_SLOT_SIZE;
+  cap = (gsize) cache->max_slots * CACHE_SLOT_SIZE;
+  target = gst_flucachemanager_update (cache, size, cap, cache->h_offset);
+  if (target != size)
+    gst_shifter_cache_resize_ring (cache, target / CACHE_SLOT_SIZE, TRUE);
+}
+
 /**
  * gst_shifter_cache_push:
  * @cache: a #GstShifterCache
@@ -801,58 +1956,87 @@ gst_shifter_cache_pop (GstShifterCache * cache, gboolean drain)
  *
  * Cache the @buffer and takes ownership of the it.
  *
+ * Returns: the offset the data was written at.
  */
-
-void
+guint64
 gst_shifter_cache_push (GstShifterCache * cache, guint8 *data, gsize size)
 {
   Slot *tail;
   gsize avail;
-  gboolean is_recording;
+  gboolean is_recording, disk_failed;
+  guint64 offset;
 
   GST_CACHE_LOCK (cache);
   is_recording = cache->is_recording;
+  disk_failed = cache->disk_failed;
+  offset = cache->h_offset;
+  FLUCACHE_PROBE3 (push, offset, size, is_recording);
   GST_CACHE_UNLOCK (cache);
 
 #if DEBUG_RINGBUFFER
   dump_cache_state (cache, "pre-push");
 #endif
 
+  if (G_UNLIKELY (disk_failed)) {
+    gst_shifter_cache_disable_disk (cache);
+    is_recording = FALSE;
+  }
+
   if (is_recording) {
-    gst_shifter_cache_disk_write (cache, data, size);
-    /* handle underruns by refilling the ringbuffer */
-    if (gst_shifter_cache_is_empty (cache)) {
-      gst_shifter_cache_reload (cache, FALSE);
+    if (gst_shifter_cache_disk_write (cache, data, size)) {
+      /* handle underruns by refilling the ringbuffer */
+      if (gst_shifter_cache_is_empty (cache)) {
+        gst_shifter_cache_reload (cache, FALSE);
+      }
+      goto beach;
     }
-  } else {
-    while (size) {
+    /* keep the live edge in memory */
+    gst_shifter_cache_disable_disk (cache);
+  }
+
+  while (size) {
 #if DEBUG_RINGBUFFER
-      GST_DEBUG ("remaining size %d", size);
-      dump_cache_state (cache, "pre-push");
+    GST_DEBUG ("remaining size %d", size);
+    dump_cache_state (cache, "pre-push");
 #endif
-      tail = &cache->slots[cache->tail];
-      gst_shifter_cache_recycle (cache, tail);
-      if (slot_available (tail, &avail)) {
-        avail = MIN (avail, size);
-        if (slot_write (tail, data, avail, cache->h_rb_offset)) {
-          /* Move the tail when the slot is full */
-          cache->tail = (cache->tail + 1) % cache->nslots;
-          cache->h_rb_offset += CACHE_SLOT_SIZE;
-          g_atomic_int_inc (&cache->fslots);
-        }
-        data += avail;
-        size -= avail;
-        cache->h_offset += avail;
+    tail = cache->slots[cache->tail];
+    gst_shifter_cache_recycle (cache, tail);
+    if (slot_available (tail, &avail)) {
+      avail = MIN (avail, size);
+      if (slot_write (tail, data, avail, cache->h_rb_offset)) {
+        gst_shifter_cache_shm_commit (cache, tail);
+        /* Move the tail when the slot is full */
+        cache->tail = (cache->tail + 1) % cache->nslots;
+        cache->h_rb_offset += CACHE_SLOT_SIZE;
+        g_atomic_int_inc (&cache->fslots);
       } else {
-        gst_shifter_cache_start_recording (cache);
-        gst_shifter_cache_disk_write (cache, data, size);
+        gst_shifter_cache_shm_commit (cache, tail);
+      }
+      data += avail;
+      size -= avail;
+      cache->h_offset += avail;
+    } else if (cache->fd != -1 && !cache->disk_disabled) {
+      if (gst_shifter_cache_start_recording (cache) &&
+          gst_shifter_cache_disk_write (cache, data, size)) {
         size = 0;
+      } else {
+        gst_shifter_cache_disable_disk (cache);
       }
+    } else if (!gst_shifter_cache_drop_oldest (cache, tail)) {
+      GST_WARNING ("ring buffer full, dropping %" G_GSIZE_FORMAT " bytes",
+          size);
+      cache->need_discont = TRUE;
+      size = 0;
     }
   }
+
+beach:
+  gst_shifter_cache_shm_publish (cache);
+  gst_shifter_cache_balance (cache);
 #if DEBUG_RINGBUFFER
   dump_cache_state (cache, "post-push");
 #endif
+  return offset;
 }
 
 /**
@@ -934,13 +2118,16 @@ gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset)
   }
   GST_CACHE_UNLOCK (cache);
 
+  FLUCACHE_PROBE2 (seek, offset, is_disk_usable);
+
   GST_DEBUG ("seeking for offset: %" G_GUINT64_FORMAT, offset);
+  cache->skip_offset = 0;
 
   /* First check if we can find it in the ringbuffer */
   if (offset >= cache->l_rb_offset && offset < cache->h_rb_offset) {
     GST_DEBUG ("seeking in the ringbuffer");
     guint seeker = cache->head;
-    head = &cache->slots[seeker];
+    head = cache->slots[seeker];
 
     if (offset >= head->offset) {
       if (offset < head->offset + head->size) {
@@ -954,7 +2141,7 @@ gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset)
       do {
         gst_shifter_cache_rollforward (cache, head);
         seeker = (seeker + 1) % cache->nslots;
-        head = &cache->slots[seeker];
+        head = cache->slots[seeker];
       } while (!(offset >= head->offset && offset < head->offset + head->size));
       gst_shifter_cache_rollback (cache, head);
     } else {
@@ -966,7 +2153,7 @@ gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset)
           seeker = cache->nslots - 1;
         else
           seeker--;
-        head = &cache->slots[seeker];
+        head = cache->slots[seeker];
         if (!gst_shifter_cache_rollback (cache, head)) {
           seeker = (seeker + 1) % cache->nslots;
           break;
@@ -986,7 +2173,7 @@ gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset)
 
     /* update the reading position in the disk */
     GST_CACHE_LOCK (cache);
-    cache->r_dk_pos = offset - cache->l_dk_offset;
+    cache->r_dk_pos = offset - cache->m_dk_offset;
     cache->h_rb_offset = cache->l_rb_offset = offset;
     GST_CACHE_UNLOCK (cache);
 
@@ -996,26 +2183,447 @@ gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset)
   }
 
 beach:
+  gst_shifter_cache_shm_publish (cache);
   dump_cache_state (cache, "post-seek");
 
   return TRUE;
 }
 
+/* Looks in the ring buffer for the slot holding @offset, starting at the
+ * index in @hint which is updated. The offset and size of the slot at the
+ * time of the lookup are returned, the caller must check with
+ * slot_is_valid() that the slot was not reused once done with its data. */
+static Slot *
+gst_shifter_cache_find_slot (GstShifterCache * cache, guint64 offset,
+    guint * hint, guint64 * s_offset, gsize * s_size)
+{
+  guint i;
+
+  for (i = 0; i < cache->nslots; i++) {
+    guint index = (*hint + i) % cache->nslots;
+    Slot *slot = cache->slots[index];
+    guint64 start = slot->offset;
+    gsize size = slot->size;
+
+    if (g_atomic_int_get (&slot->state) != STATE_EMPTY &&
+        start != INVALID_OFFSET && offset >= start && offset < start + size) {
+      *hint = index;
+      *s_offset = start;
+      *s_size = size;
+      return slot;
+    }
+  }
+  return NULL;
+}
+
+static inline gboolean
+slot_is_valid (Slot * slot, guint64 offset)
+{
+  return slot->offset == offset &&
+      g_atomic_int_get (&slot->state) != STATE_EMPTY;
+}
+
 /**
- * gst_shifter_cache_is_empty:
+ * gst_shifter_cache_export:
  * @cache: a #GstShifterCache
+ * @start: first byte offset to export
+ * @stop: byte offset where the export ends, exclusive
+ * @fd: file descriptor where the data is written
  *
- * Return TRUE if cache is empty.
+ * Writes the cached bytes in [@start, @stop) to @fd. The range is clamped to
+ * the data available in the cache. Data on the disk is copied in the kernel
+ * when possible and data in the ringbuffer is written straight from the slots,
+ * the reading position of the cache is not modified.
  *
+ * Returns: TRUE if the whole clamped range was written to @fd.
  */
 gboolean
-gst_shifter_cache_is_empty (GstShifterCache * cache)
+gst_shifter_cache_export (GstShifterCache * cache, guint64 start,
+    guint64 stop, gint fd)
 {
-  gboolean is_empty = TRUE;
+  guint64 l_offset, l_dk_offset, h_dk_offset, dk_base;
+  gboolean is_recording, ret = FALSE;
+  guint seeker = 0;
 
-  g_return_val_if_fail (cache != NULL, TRUE);
+  g_return_val_if_fail (cache != NULL, FALSE);
+  g_return_val_if_fail (fd >= 0, FALSE);
 
-  is_empty = (g_atomic_int_get (&cache->fslots) == 0);
+  GST_CACHE_LOCK (cache);
+  /* keeps the slots in place until we are done */
+  cache->exports++;
+  is_recording = cache->is_recording;
+  l_dk_offset = cache->l_dk_offset;
+  h_dk_offset = cache->h_dk_offset;
+  dk_base = cache->m_dk_offset;
+  if (is_recording && cache->is_rb_migrated) {
+    l_offset = l_dk_offset;
+  } else {
+    l_offset = cache->l_rb_offset;
+  }
+  stop = MIN (stop, cache->h_offset);
+  GST_CACHE_UNLOCK (cache);
+
+  start = MAX (start, l_offset);
+
+  GST_DEBUG ("exporting range %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+      start, stop);
+
+  while (start < stop) {
+    if (is_recording && start >= l_dk_offset && start < h_dk_offset) {
+      gssize ret;
+
+      ret = gst_shifter_cache_disk_copy (cache, start - dk_base,
+          MIN (stop, h_dk_offset) - start, fd);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      if (ret <= 0)
+        goto write_failed;
+      start += ret;
+    } else {
+      Slot *slot;
+      guint64 offset;
+      gsize size;
+
+      /* slots are consecutive so continue from the last one we used */
+      slot = gst_shifter_cache_find_slot (cache, start, &seeker, &offset,
+          &size);
+      if (slot == NULL)
+        goto not_cached;
+
+      size = MIN (stop, offset + size) - start;
+      if (!gst_shifter_cache_write_all (fd, slot->data + (start - offset),
+              size))
+        goto write_failed;
+
+      /* the writer could have recycled the slot meanwhile */
+      if (!slot_is_valid (slot, offset))
+        goto not_cached;
+      start += size;
+    }
+  }
+  ret = TRUE;
+
+beach:
+  GST_CACHE_LOCK (cache);
+  cache->exports--;
+  GST_CACHE_UNLOCK (cache);
+  return ret;
+
+  /* ERRORS */
+write_failed:
+  {
+    GST_ERROR ("export write failed: %s", g_strerror (errno));
+    goto beach;
+  }
+not_cached:
+  {
+    GST_WARNING ("offset %" G_GUINT64_FORMAT " is no longer cached", start);
+    goto beach;
+  }
+}
+
+/**
+ * gst_shifter_cache_read:
+ * @cache: a #GstShifterCache
+ * @offset: byte offset to read from
+ * @size: bytes to read
+ *
+ * Copies up to @size cached bytes starting at @offset to a new buffer,
+ * wherever they are in the ringbuffer or the disk. The reading position of
+ * the cache is not modified.
+ *
+ * Returns: a new #GstBuffer, which may be smaller than @size, or NULL if
+ * @offset is not cached.
+ */
+GstBuffer *
+gst_shifter_cache_read (GstShifterCache * cache, guint64 offset, gsize size)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint64 l_dk_offset, h_dk_offset, dk_base;
+  gboolean is_recording;
+  gsize done = 0;
+  guint seeker;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  seeker = cache->head;
+
+  GST_CACHE_LOCK (cache);
+  is_recording = cache->is_recording;
+  l_dk_offset = cache->l_dk_offset;
+  h_dk_offset = cache->h_dk_offset;
+  dk_base = cache->m_dk_offset;
+  if (offset < cache->h_offset)
+    size = MIN (size, cache->h_offset - offset);
+  else
+    size = 0;
+  GST_CACHE_UNLOCK (cache);
+
+  if (size == 0)
+    return NULL;
+
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  if (buffer == NULL || !gst_buffer_map (buffer, &map, GST_MAP_WRITE)) {
+    GST_ERROR ("could not allocate a buffer of %" G_GSIZE_FORMAT " bytes",
+        size);
+    if (buffer)
+      gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  while (done < size) {
+    guint64 pos = offset + done;
+    guint64 s_offset;
+    gsize s_size, len;
+    Slot *slot;
+
+    /* prefer the memory, only go to the disk for what's not there */
+    slot = gst_shifter_cache_find_slot (cache, pos, &seeker, &s_offset,
+        &s_size);
+    if (slot) {
+      len = MIN (size - done, s_offset + s_size - pos);
+      memcpy (map.data + done, slot->data + (pos - s_offset), len);
+      if (!slot_is_valid (slot, s_offset))
+        break;
+    } else if (is_recording && pos >= l_dk_offset && pos < h_dk_offset) {
+      len = MIN (size - done, h_dk_offset - pos);
+      if (!gst_shifter_cache_pread (cache->fd, map.data + done, len,
+              pos - dk_base))
+        break;
+    } else {
+      break;
+    }
+    done += len;
+  }
+
+  gst_buffer_unmap (buffer, &map);
+
+  if (done == 0) {
+    GST_DEBUG ("offset %" G_GUINT64_FORMAT " not cached", offset);
+    gst_buffer_unref (buffer);
+    return NULL;
+  }
+
+  gst_buffer_resize (buffer, 0, done);
+  GST_BUFFER_OFFSET (buffer) = offset;
+  GST_BUFFER_OFFSET_END (buffer) = offset + done;
+
+  return buffer;
+}
+
+/**
+ * gst_shifter_cache_skip:
+ * @cache: a #GstShifterCache
+ * @offset: byte offset where the reading continues
+ *
+ * Tells the cache the data before @offset was consumed without popping it,
+ * the next popped buffer starts at @offset. The skipped data stays cached
+ * and can still be seeked back to.
+ */
+void
+gst_shifter_cache_skip (GstShifterCache * cache, guint64 offset)
+{
+  Slot *head;
+
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->skip_offset = offset;
+  GST_CACHE_UNLOCK (cache);
+
+  gst_shifter_cache_release_skipped (cache);
+
+  GST_CACHE_LOCK (cache);
+  head = cache->slots[cache->head];
+  if (g_atomic_int_get (&head->state) != STATE_FULL &&
+      cache->is_recording && cache->is_rb_migrated &&
+      cache->h_rb_offset < offset) {
+    /* the ringbuffer is behind, continue reloading from the disk at @offset */
+    gst_shifter_cache_clear_ring (cache, offset);
+    cache->r_dk_pos = offset - cache->m_dk_offset;
+  }
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_get_read_offset:
+ * @cache: a #GstShifterCache
+ *
+ * Returns: the offset of the next byte gst_shifter_cache_pop() will return.
+ */
+guint64
+gst_shifter_cache_get_read_offset (GstShifterCache * cache)
+{
+  Slot *head;
+  guint64 offset;
+
+  g_return_val_if_fail (cache != NULL, 0);
+
+  head = cache->slots[cache->head];
+  if (g_atomic_int_get (&head->state) == STATE_FULL)
+    offset = head->offset;
+  else
+    offset = cache->h_rb_offset;
+
+  return MAX (offset, cache->skip_offset);
+}
+
+/* Recomputes the offset of the slowest cursor, called with the cache lock */
+static void
+gst_shifter_cache_update_cursors (GstShifterCache * cache)
+{
+  GSList *walk;
+
+  cache->c_offset = G_MAXUINT64;
+  for (walk = cache->cursors; walk; walk = g_slist_next (walk)) {
+    GstShifterCacheCursor *cursor = walk->data;
+    cache->c_offset = MIN (cache->c_offset, cursor->offset);
+  }
+}
+
+/**
+ * gst_shifter_cache_cursor_new:
+ * @cache: a #GstShifterCache
+ * @offset: byte offset the cursor starts reading at
+ *
+ * Adds a reader independent from gst_shifter_cache_pop(). The ring buffer
+ * slots are not reused until all the cursors have read them, unless their
+ * data is on the disk too.
+ *
+ * Returns: a new cursor, owned by @cache until
+ * gst_shifter_cache_cursor_free().
+ */
+GstShifterCacheCursor *
+gst_shifter_cache_cursor_new (GstShifterCache * cache, guint64 offset)
+{
+  GstShifterCacheCursor *cursor;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  cursor = g_new0 (GstShifterCacheCursor, 1);
+  cursor->offset = offset;
+  cursor->discont = TRUE;
+
+  GST_CACHE_LOCK (cache);
+  cache->cursors = g_slist_prepend (cache->cursors, cursor);
+  gst_shifter_cache_update_cursors (cache);
+  GST_CACHE_UNLOCK (cache);
+
+  return cursor;
+}
+
+/**
+ * gst_shifter_cache_cursor_free:
+ * @cache: a #GstShifterCache
+ * @cursor: a cursor of @cache
+ *
+ * Removes @cursor, the data it didn't read can be reused.
+ */
+void
+gst_shifter_cache_cursor_free (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (cursor != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->cursors = g_slist_remove (cache->cursors, cursor);
+  gst_shifter_cache_update_cursors (cache);
+  GST_CACHE_UNLOCK (cache);
+
+  g_free (cursor);
+}
+
+/**
+ * gst_shifter_cache_cursor_seek:
+ * @cache: a #GstShifterCache
+ * @cursor: a cursor of @cache
+ * @offset: byte offset to read next
+ *
+ * Moves @cursor to @offset.
+ */
+void
+gst_shifter_cache_cursor_seek (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor, guint64 offset)
+{
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (cursor != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cursor->offset = offset;
+  cursor->discont = TRUE;
+  gst_shifter_cache_update_cursors (cache);
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_cursor_read:
+ * @cache: a #GstShifterCache
+ * @cursor: a cursor of @cache
+ * @size: maximum bytes to read
+ *
+ * Reads the data at @cursor and moves it after the data read. When the data
+ * at @cursor is not cached anymore it jumps to the oldest cached data and
+ * marks the buffer as DISCONT.
+ *
+ * Returns: a new #GstBuffer or NULL when there's no data after @cursor yet.
+ */
+GstBuffer *
+gst_shifter_cache_cursor_read (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor, gsize size)
+{
+  GstBuffer *buffer;
+  guint64 l_offset;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (cursor != NULL, NULL);
+
+  buffer = gst_shifter_cache_read (cache, cursor->offset, size);
+  if (buffer == NULL) {
+    GST_CACHE_LOCK (cache);
+    l_offset = cache->is_recording ? cache->l_dk_offset : cache->l_rb_offset;
+    GST_CACHE_UNLOCK (cache);
+
+    if (l_offset <= cursor->offset)
+      return NULL;
+
+    GST_DEBUG ("cursor %p lost data, jumping from %" G_GUINT64_FORMAT " to %"
+        G_GUINT64_FORMAT, cursor, cursor->offset, l_offset);
+    cursor->discont = TRUE;
+    buffer = gst_shifter_cache_read (cache, l_offset, size);
+    if (buffer == NULL)
+      return NULL;
+  }
+
+  if (cursor->discont) {
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+    cursor->discont = FALSE;
+  }
+
+  GST_CACHE_LOCK (cache);
+  cursor->offset = GST_BUFFER_OFFSET_END (buffer);
+  gst_shifter_cache_update_cursors (cache);
+  GST_CACHE_UNLOCK (cache);
+
+  return buffer;
+}
+
+/**
+ * gst_shifter_cache_is_empty:
+ * @cache: a #GstShifterCache
+ *
+ * Return TRUE if cache is empty.
+ *
+ */
+gboolean
+gst_shifter_cache_is_empty (GstShifterCache * cache)
+{
+  gboolean is_empty = TRUE;
+
+  g_return_val_if_fail (cache != NULL, TRUE);
+
+  is_empty = (g_atomic_int_get (&cache->fslots) == 0);
 
   return is_empty;
 }
@@ -1036,8 +2644,8 @@ gst_shifter_cache_fullness (GstShifterCache * cache)
     return 0;
   } else {
     Slot *head, *tail;
-    head = &cache->slots[cache->head];
-    tail = &cache->slots[cache->tail];
+    head = cache->slots[cache->head];
+    tail = cache->slots[cache->tail];
     return (tail->offset - head->offset + head->size);
   }
 }
@@ -1107,3 +2715,439 @@ gst_shifter_cache_set_autoremove (GstShifterCache * cache, gboolean autoremove)
 
   cache->autoremove = autoremove;
 }
+
+/**
+ * gst_shifter_cache_set_io_priority:
+ * @cache: a #GstShifterCache
+ * @io_class: the I/O scheduling class
+ * @level: priority inside the class, from 0 (highest) to 7
+ *
+ * Sets the I/O scheduling class used while writing to the disk. The thread
+ * doing the migration keeps it until it is done or @io_class is set back to
+ * %GST_SHIFTER_CACHE_IO_CLASS_NONE, the streaming thread recording the live
+ * data only gets it around each write. Reads keep the priority of the
+ * streaming threads doing them. Only supported on Linux.
+ */
+void
+gst_shifter_cache_set_io_priority (GstShifterCache * cache,
+    GstShifterCacheIOClass io_class, gint level)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->io_class = io_class;
+  cache->io_level = CLAMP (level, 0, 7);
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_set_write_rate:
+ * @cache: a #GstShifterCache
+ * @rate: max. bytes per second, 0 to disable the limit
+ *
+ * Limits the rate at which the ring buffer is migrated to the disk. Live
+ * data written while recording counts against the same budget, the writer
+ * gets the time to hold back from gst_shifter_cache_take_write_delay().
+ */
+void
+gst_shifter_cache_set_write_rate (GstShifterCache * cache, guint64 rate)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->write_rate = rate;
+  cache->refill_time = GST_CLOCK_TIME_NONE;
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_take_write_delay:
+ * @cache: a #GstShifterCache
+ *
+ * Live data can't be dropped to honour the write rate limit, the writer
+ * should wait the returned time before pushing more, without holding the
+ * locks the reader needs.
+ *
+ * Returns: the time the writer is ahead of the write rate limit, 0 if none.
+ */
+GstClockTime
+gst_shifter_cache_take_write_delay (GstShifterCache * cache)
+{
+  GstClockTime delay;
+
+  g_return_val_if_fail (cache != NULL, 0);
+
+  GST_CACHE_LOCK (cache);
+  delay = cache->write_delay;
+  cache->write_delay = 0;
+  GST_CACHE_UNLOCK (cache);
+
+  return delay;
+}
+
+/**
+ * gst_shifter_cache_get_read_stats:
+ * @cache: a #GstShifterCache
+ *
+ * Returns: a new #GstStructure with the latency counters of the disk reads
+ * done to reload the ring buffer, the ones done while data was being written
+ * to the disk are also accounted separately.
+ */
+GstStructure *
+gst_shifter_cache_get_read_stats (GstShifterCache * cache)
+{
+  GstStructure *stru;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  GST_CACHE_LOCK (cache);
+  stru = gst_structure_new ("shifter-read-stats",
+      "reads", G_TYPE_UINT64, cache->reads,
+      "reads-under-load", G_TYPE_UINT64, cache->loaded_reads,
+      "average-latency", G_TYPE_UINT64,
+      cache->reads ? cache->read_time / cache->reads : 0,
+      "average-latency-under-load", G_TYPE_UINT64,
+      cache->loaded_reads ? cache->loaded_read_time / cache->loaded_reads : 0,
+      "max-latency", G_TYPE_UINT64, cache->max_read_time, NULL);
+  GST_CACHE_UNLOCK (cache);
+
+  return stru;
+}
+
+/* Copies the sizes read by gst_shifter_cache_get_levels(), called with the
+ * lock after changing nslots, is_recording, the disk offsets or reloads */
+static void
+gst_shifter_cache_publish_levels (GstShifterCache * cache)
+{
+  g_atomic_int_inc (&cache->levels_seq);
+  cache->levels_nslots = cache->nslots;
+  cache->levels_disk_fill = 0;
+  if (cache->is_recording && cache->l_dk_offset != INVALID_OFFSET &&
+      cache->h_dk_offset != INVALID_OFFSET &&
+      cache->h_dk_offset > cache->l_dk_offset)
+    cache->levels_disk_fill = cache->h_dk_offset - cache->l_dk_offset;
+  cache->levels_reloads = cache->reloads;
+  g_atomic_int_inc (&cache->levels_seq);
+}
+
+/**
+ * gst_shifter_cache_get_levels:
+ * @cache: a #GstShifterCache
+ * @ring_fill: where to store the bytes in the full slots of the ring buffer
+ * @ring_size: where to store the size of the ring buffer
+ * @disk_fill: where to store the bytes recorded on the disk
+ * @reloads: where to store the reloads that brought slots back
+ *
+ * Samples the fill levels without taking the lock, so it never waits for
+ * the disk I/O. The ring buffer fill only counts the full slots. Can be
+ * called from any thread.
+ */
+void
+gst_shifter_cache_get_levels (GstShifterCache * cache, guint64 * ring_fill,
+    guint64 * ring_size, guint64 * disk_fill, guint64 * reloads)
+{
+  gint seq;
+
+  g_return_if_fail (cache != NULL);
+
+  do {
+    while ((seq = g_atomic_int_get (&cache->levels_seq)) & 1)
+      g_thread_yield ();
+    *ring_size = (guint64) cache->levels_nslots * CACHE_SLOT_SIZE;
+    *disk_fill = cache->levels_disk_fill;
+    *reloads = cache->levels_reloads;
+  } while (g_atomic_int_get (&cache->levels_seq) != seq);
+
+  *ring_fill = (guint64) g_atomic_int_get (&cache->fslots) * CACHE_SLOT_SIZE;
+}
+
+/**
+ * gst_shifter_cache_get_stats:
+ * @cache: a #GstShifterCache
+ *
+ * Returns: a new #GstStructure with the fill levels of the ring buffer and
+ * the disk, the slots lent downstream, the disk traffic counters and the
+ * disk latencies.
+ */
+GstStructure *
+gst_shifter_cache_get_stats (GstShifterCache * cache)
+{
+  GstStructure *stru;
+  guint64 disk_fill = 0;
+  guint i, lent = 0;
+
+  g_return_val_if_fail (cache != NULL, NULL);
+
+  GST_CACHE_LOCK (cache);
+  /* counted here so that popping stays free of bookkeeping */
+  for (i = 0; i < cache->nslots; i++) {
+    if (g_atomic_int_get (&cache->slots[i]->state) == STATE_POP)
+      lent++;
+  }
+  if (cache->is_recording)
+    disk_fill = cache->h_dk_offset - cache->l_dk_offset;
+
+  stru = gst_structure_new ("shifter-cache-stats",
+      "ring-size", G_TYPE_UINT64, (guint64) cache->nslots * CACHE_SLOT_SIZE,
+      "ring-fill", G_TYPE_UINT64, gst_shifter_cache_fullness (cache),
+      "disk-fill", G_TYPE_UINT64, disk_fill,
+      "slots-lent", G_TYPE_UINT, lent,
+      "reloads", G_TYPE_UINT64, cache->reloads,
+      "reloaded-slots", G_TYPE_UINT64, cache->reads,
+      "disk-read-bytes", G_TYPE_UINT64, cache->read_bytes,
+      "disk-write-bytes", G_TYPE_UINT64, cache->write_bytes,
+      "disk-read-latency", G_TYPE_UINT64,
+      cache->reads ? cache->read_time / cache->reads : 0,
+      "disk-read-latency-max", G_TYPE_UINT64, cache->max_read_time,
+      "disk-write-latency", G_TYPE_UINT64,
+      cache->writes ? cache->write_time / cache->writes : 0,
+      "disk-write-latency-max", G_TYPE_UINT64, cache->max_write_time,
+      "migration-time", G_TYPE_UINT64, cache->migration_time, NULL);
+  GST_CACHE_UNLOCK (cache);
+
+  return stru;
+}
+
+/**
+ * gst_shifter_cache_set_disk_thresholds:
+ * @cache: a #GstShifterCache
+ * @low: free space in bytes below which the oldest recorded data is discarded
+ * @critical: free space in bytes below which the disk isn't used anymore
+ *
+ * Configures how the cache reacts when the recording filesystem fills up.
+ */
+void
+gst_shifter_cache_set_disk_thresholds (GstShifterCache * cache, guint64 low,
+    guint64 critical)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->low_space = MAX (low, critical);
+  cache->critical_space = critical;
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_get_disk_state:
+ * @cache: a #GstShifterCache
+ * @free_space: (out) (allow-none): free space found at the last check
+ *
+ * Returns: the current #GstShifterCacheDiskState of @cache.
+ */
+GstShifterCacheDiskState
+gst_shifter_cache_get_disk_state (GstShifterCache * cache,
+    guint64 * free_space)
+{
+  GstShifterCacheDiskState state;
+
+  g_return_val_if_fail (cache != NULL, GST_SHIFTER_CACHE_DISK_OK);
+
+  GST_CACHE_LOCK (cache);
+  state = cache->disk_state;
+  if (free_space)
+    *free_space = cache->free_space;
+  GST_CACHE_UNLOCK (cache);
+
+  return state;
+}
+
+/**
+ * gst_shifter_cache_set_sync_policy:
+ * @cache: a #GstShifterCache
+ * @policy: a #GstShifterCacheSyncPolicy
+ * @interval: bytes written between syncs
+ *
+ * Configures how the recorded data is pushed to the disk, see
+ * #GstShifterCacheSyncPolicy for what survives a crash with each policy.
+ */
+void
+gst_shifter_cache_set_sync_policy (GstShifterCache * cache,
+    GstShifterCacheSyncPolicy policy, gsize interval)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->sync_policy = policy;
+  cache->sync_interval = MAX (interval, CACHE_SLOT_SIZE);
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_set_shared_scheduler:
+ * @cache: a #GstShifterCache
+ * @shared: whether to use the shared workers
+ *
+ * Runs the migration of the ring buffer to the disk on the workers shared by
+ * all the instances instead of a thread of its own, one slot per run. Applies
+ * to the next migration.
+ */
+void
+gst_shifter_cache_set_shared_scheduler (GstShifterCache * cache,
+    gboolean shared)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->shared_scheduler = shared;
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_get_shared_fd:
+ * @cache: a #GstShifterCache
+ *
+ * Returns: the memfd holding the ringbuffer of a cache created with
+ * gst_shifter_cache_new_shared() or -1. The descriptor is owned by @cache.
+ */
+gint
+gst_shifter_cache_get_shared_fd (GstShifterCache * cache)
+{
+  g_return_val_if_fail (cache != NULL, -1);
+
+  return cache->shm_fd;
+}
+
+/**
+ * gst_shifter_cache_get_memory_usage:
+ * @cache: a #GstShifterCache
+ *
+ * Returns: the bytes of memory allocated by the ringbuffer of @cache.
+ */
+guint64
+gst_shifter_cache_get_memory_usage (GstShifterCache * cache)
+{
+  guint64 size;
+
+  g_return_val_if_fail (cache != NULL, 0);
+
+  GST_CACHE_LOCK (cache);
+  size = (guint64) cache->nslots * CACHE_SLOT_SIZE;
+  GST_CACHE_UNLOCK (cache);
+
+  return size;
+}
+
+/**
+ * gst_shifter_cache_resize:
+ * @cache: a #GstShifterCache
+ * @size: new size of the ringbuffer in bytes
+ *
+ * Grows or shrinks the ringbuffer keeping the reading position and the
+ * offsets. With a memory budget @size is a cap: the ringbuffer grows into it
+ * only as far as the budget allows, and can be shrunk below it later. When
+ * shrinking, the free slots are removed first. If the data still doesn't
+ * fit it's recorded to the disk when there is one, and the ringbuffer
+ * shrinks once it's there; otherwise the oldest data not read yet is
+ * dropped. Slots in use downstream are removed when they come back.
+ * Must be called from the writer, or with the writer stopped.
+ *
+ * Returns: FALSE if the ringbuffer can't be resized because it's shared
+ * with other processes.
+ */
+gboolean
+gst_shifter_cache_resize (GstShifterCache * cache, gsize size)
+{
+  guint nslots, n;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+
+  if (cache->shm)
+    return FALSE;
+
+  nslots = MAX (size / CACHE_SLOT_SIZE, MIN_SLOTS);
+  GST_DEBUG ("resizing the ring buffer to %u slots", nslots);
+  cache->max_slots = nslots;
+  if (nslots > cache->nslots && gst_flucachemanager_get_budget ()) {
+    /* only a cap, the writer grows into it as the budget allows */
+    cache->resize_slots = 0;
+    cache->balance_time = 0;
+    return TRUE;
+  }
+
+  n = gst_shifter_cache_resize_ring (cache, nslots, FALSE);
+  if (n > nslots) {
+    GST_CACHE_LOCK (cache);
+    if (cache->fd != -1 && !cache->disk_disabled && !cache->is_recording) {
+      GST_CACHE_UNLOCK (cache);
+      gst_shifter_cache_start_recording (cache);
+    } else if (cache->fd == -1 || cache->disk_disabled) {
+      guint drop = n - nslots;
+
+      GST_CACHE_UNLOCK (cache);
+      while (drop && gst_shifter_cache_evict_head (cache))
+        drop--;
+      if (drop != n - nslots)
+        GST_WARNING ("dropped %u slots not read yet", n - nslots - drop);
+      n = gst_shifter_cache_resize_ring (cache, nslots, FALSE);
+    } else {
+      GST_CACHE_UNLOCK (cache);
+    }
+  }
+  /* the rest is done by the writer */
+  cache->resize_slots = n > nslots ? nslots : 0;
+
+  return TRUE;
+}
+
+/**
+ * gst_shifter_cache_set_disk_window:
+ * @cache: a #GstShifterCache
+ * @size: bytes of recorded data to keep, 0 for no limit
+ *
+ * Limits the recording to the last @size bytes, the older data is discarded
+ * as new data is written. The data still being read is kept.
+ */
+void
+gst_shifter_cache_set_disk_window (GstShifterCache * cache, guint64 size)
+{
+  g_return_if_fail (cache != NULL);
+
+  GST_CACHE_LOCK (cache);
+  cache->disk_window = size;
+  GST_CACHE_UNLOCK (cache);
+}
+
+/**
+ * gst_shifter_cache_get_ranges:
+ * @cache: a #GstShifterCache
+ * @rb_start: (out): first byte offset held in memory
+ * @rb_stop: (out): byte offset where the data in memory ends, exclusive
+ * @dk_start: (out): first byte offset on the disk
+ * @dk_stop: (out): byte offset where the data on the disk ends, exclusive
+ *
+ * Gets the data held by each tier of @cache. When recording the memory
+ * holds the data loaded from the disk for the reader, so both ranges can
+ * overlap.
+ *
+ * Returns: TRUE if there's data on the disk, @dk_start and @dk_stop are
+ * left untouched otherwise.
+ */
+gboolean
+gst_shifter_cache_get_ranges (GstShifterCache * cache, guint64 * rb_start,
+    guint64 * rb_stop, guint64 * dk_start, guint64 * dk_stop)
+{
+  gboolean on_disk;
+
+  g_return_val_if_fail (cache != NULL, FALSE);
+
+  GST_CACHE_LOCK (cache);
+  if (cache->is_recording && cache->is_rb_migrated) {
+    *rb_start = gst_shifter_cache_get_read_offset (cache);
+    *rb_stop = MAX (*rb_start, cache->h_rb_offset);
+  } else {
+    *rb_start = cache->l_rb_offset;
+    *rb_stop = cache->h_offset;
+  }
+
+  on_disk = cache->is_recording && cache->l_dk_offset != INVALID_OFFSET &&
+      cache->h_dk_offset != INVALID_OFFSET &&
+      cache->h_dk_offset > cache->l_dk_offset;
+  if (on_disk) {
+    *dk_start = cache->l_dk_offset;
+    *dk_stop = cache->h_dk_offset;
+  }
+  GST_CACHE_UNLOCK (cache);
+
+  return on_disk;
+}
@@ -35,17 +35,109 @@ G_BEGIN_DECLS
  */
 typedef struct _GstShifterCache GstShifterCache;
 
+/**
+ * GstShifterCacheCursor:
+ * @offset: byte offset of the next data to read
+ *
+ * An extra reader of a #GstShifterCache.
+ */
+typedef struct _GstShifterCacheCursor GstShifterCacheCursor;
+
+struct _GstShifterCacheCursor
+{
+  guint64 offset;
+
+  /*< private > */
+  gboolean discont;
+};
+
+/**
+ * GstShifterCacheIOClass:
+ * @GST_SHIFTER_CACHE_IO_CLASS_NONE: leave the I/O priority of the writer
+ *   threads untouched
+ * @GST_SHIFTER_CACHE_IO_CLASS_REALTIME: realtime I/O scheduling class
+ * @GST_SHIFTER_CACHE_IO_CLASS_BEST_EFFORT: best-effort I/O scheduling class
+ * @GST_SHIFTER_CACHE_IO_CLASS_IDLE: only get disk time when nobody else needs
+ *   it
+ *
+ * I/O scheduling class applied to the threads writing to the disk.
+ */
+typedef enum
+{
+  GST_SHIFTER_CACHE_IO_CLASS_NONE,
+  GST_SHIFTER_CACHE_IO_CLASS_REALTIME,
+  GST_SHIFTER_CACHE_IO_CLASS_BEST_EFFORT,
+  GST_SHIFTER_CACHE_IO_CLASS_IDLE
+} GstShifterCacheIOClass;
+
+/**
+ * GstShifterCacheDiskState:
+ * @GST_SHIFTER_CACHE_DISK_OK: enough free space for recording
+ * @GST_SHIFTER_CACHE_DISK_LOW: free space is below the low threshold, the
+ *   oldest recorded data is being discarded
+ * @GST_SHIFTER_CACHE_DISK_FULL: the disk can't be used anymore, the cache
+ *   only keeps data in memory
+ *
+ * State of the filesystem holding the recording file.
+ */
+typedef enum
+{
+  GST_SHIFTER_CACHE_DISK_OK,
+  GST_SHIFTER_CACHE_DISK_LOW,
+  GST_SHIFTER_CACHE_DISK_FULL
+} GstShifterCacheDiskState;
+
+/**
+ * GstShifterCacheSyncPolicy:
+ * @GST_SHIFTER_CACHE_SYNC_NONE: leave the writeback to the kernel. After an
+ *   application crash all the written data is in the file, after a system
+ *   crash any amount of the recording can be lost or hold garbage.
+ * @GST_SHIFTER_CACHE_SYNC_RANGE: start the writeback of every completed
+ *   interval with sync_file_range() and wait for the previous one. This bounds
+ *   the dirty data and smooths the disk load but neither the file metadata nor
+ *   the drive cache are flushed, so it gives no guarantee after a system crash.
+ *   Linux only, behaves as @GST_SHIFTER_CACHE_SYNC_NONE elsewhere.
+ * @GST_SHIFTER_CACHE_SYNC_DATA: fdatasync() the file every interval. After a
+ *   system crash the recording is intact up to the last completed sync, at
+ *   most one interval is lost.
+ *
+ * How the recorded data is pushed to the disk.
+ */
+typedef enum
+{
+  GST_SHIFTER_CACHE_SYNC_NONE,
+  GST_SHIFTER_CACHE_SYNC_RANGE,
+  GST_SHIFTER_CACHE_SYNC_DATA
+} GstShifterCacheSyncPolicy;
+
 GstShifterCache *gst_shifter_cache_new (gsize size, gchar * filename_template);
+GstShifterCache *gst_shifter_cache_new_shared (gsize size,
+    gchar * filename_template);
 
 GstShifterCache *gst_shifter_cache_ref (GstShifterCache * cache);
 void gst_shifter_cache_unref (GstShifterCache * cache);
 
-void gst_shifter_cache_push (GstShifterCache * cache, guint8 *data, gsize size);
+guint64 gst_shifter_cache_push (GstShifterCache * cache, guint8 *data, gsize size);
 GstBuffer *gst_shifter_cache_pop (GstShifterCache * cache, gboolean drain);
 
 gboolean gst_shifter_cache_has_offset (GstShifterCache * cache, guint64 offset);
 guint64 gst_shifter_cache_get_total_bytes_received(GstShifterCache * cache);
 gboolean gst_shifter_cache_seek (GstShifterCache * cache, guint64 offset);
+gboolean gst_shifter_cache_export (GstShifterCache * cache, guint64 start,
+    guint64 stop, gint fd);
+GstBuffer *gst_shifter_cache_read (GstShifterCache * cache, guint64 offset,
+    gsize size);
+void gst_shifter_cache_skip (GstShifterCache * cache, guint64 offset);
+guint64 gst_shifter_cache_get_read_offset (GstShifterCache * cache);
+
+GstShifterCacheCursor *gst_shifter_cache_cursor_new (GstShifterCache * cache,
+    guint64 offset);
+void gst_shifter_cache_cursor_free (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor);
+void gst_shifter_cache_cursor_seek (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor, guint64 offset);
+GstBuffer *gst_shifter_cache_cursor_read (GstShifterCache * cache,
+    GstShifterCacheCursor * cursor, gsize size);
 
 gboolean gst_shifter_cache_start_recording (GstShifterCache * cache);
 void gst_shifter_cache_stop_recording (GstShifterCache * cache);
@@ -58,6 +150,38 @@ gboolean gst_shifter_cache_get_autoremove (GstShifterCache * cache);
 void gst_shifter_cache_set_autoremove (GstShifterCache * cache,
     gboolean autoremove);
 
+void gst_shifter_cache_set_io_priority (GstShifterCache * cache,
+    GstShifterCacheIOClass io_class, gint level);
+void gst_shifter_cache_set_write_rate (GstShifterCache * cache,
+    guint64 rate);
+GstClockTime gst_shifter_cache_take_write_delay (GstShifterCache * cache);
+GstStructure *gst_shifter_cache_get_read_stats (GstShifterCache * cache);
+GstStructure *gst_shifter_cache_get_stats (GstShifterCache * cache);
+void gst_shifter_cache_get_levels (GstShifterCache * cache,
+    guint64 * ring_fill, guint64 * ring_size, guint64 * disk_fill,
+    guint64 * reloads);
+
+void gst_shifter_cache_set_disk_thresholds (GstShifterCache * cache,
+    guint64 low, guint64 critical);
+GstShifterCacheDiskState gst_shifter_cache_get_disk_state (
+    GstShifterCache * cache, guint64 * free_space);
+
+void gst_shifter_cache_set_sync_policy (GstShifterCache * cache,
+    GstShifterCacheSyncPolicy policy, gsize interval);
+
+gint gst_shifter_cache_get_shared_fd (GstShifterCache * cache);
+
+void gst_shifter_cache_set_shared_scheduler (GstShifterCache * cache,
+    gboolean shared);
+
+guint64 gst_shifter_cache_get_memory_usage (GstShifterCache * cache);
+gboolean gst_shifter_cache_resize (GstShifterCache * cache, gsize size);
+void gst_shifter_cache_set_disk_window (GstShifterCache * cache,
+    guint64 size);
+gboolean gst_shifter_cache_get_ranges (GstShifterCache * cache,
+    guint64 * rb_start, guint64 * rb_stop, guint64 * dk_start,
+    guint64 * dk_stop);
+
 G_END_DECLS
 
 #endif /* __FLUCACHE_H__ */
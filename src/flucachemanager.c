@@ -0,0 +1,225 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-compat.h"
+#include "flucache.h"
+#include "flucachemanager.h"
+
+GST_DEBUG_CATEGORY_EXTERN (ts_flow);
+#define GST_CAT_DEFAULT (ts_flow)
+
+/* smallest size a cache is shrunk to */
+#define MIN_SIZE (16 * CACHE_SLOT_SIZE)
+
+typedef struct
+{
+  gconstpointer owner;
+  gsize size;                   /* bytes allocated by the cache */
+  guint64 received;             /* bytes received at the last update */
+  GstClockTime time;            /* timestamp of the last update */
+  guint64 rate;                 /* input rate in bytes/s */
+} Member;
+
+static GMutex *lock = NULL;     /* protects the members */
+static GList *members = NULL;
+static guint64 budget = 0;
+
+static void
+gst_flucachemanager_init (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    const gchar *env = g_getenv ("GST_FLUTS_MEMORY_BUDGET");
+
+    if (env)
+      budget = g_ascii_strtoull (env, NULL, 10);
+    GST_INFO ("memory budget set to %" G_GUINT64_FORMAT " bytes", budget);
+    lock = g_mutex_new ();
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+static Member *
+gst_flucachemanager_find (gconstpointer owner)
+{
+  GList *walk;
+
+  for (walk = members; walk; walk = g_list_next (walk)) {
+    Member *member = walk->data;
+    if (member->owner == owner)
+      return member;
+  }
+  return NULL;
+}
+
+/**
+ * gst_flucachemanager_get_budget:
+ *
+ * Returns: the process-wide memory budget of the caches, 0 if unlimited.
+ */
+guint64
+gst_flucachemanager_get_budget (void)
+{
+  guint64 size;
+
+  gst_flucachemanager_init ();
+
+  g_mutex_lock (lock);
+  size = budget;
+  g_mutex_unlock (lock);
+
+  return size;
+}
+
+/**
+ * gst_flucachemanager_add:
+ * @owner: the cache
+ * @cap: bytes asked by the user of @owner
+ *
+ * Registers @owner with the manager.
+ *
+ * Returns: the size @owner should start with, at most @cap and the part of
+ * the budget the others are not using.
+ */
+gsize
+gst_flucachemanager_add (gconstpointer owner, gsize cap)
+{
+  Member *member;
+  guint64 used = 0;
+  GList *walk;
+  gsize size = cap;
+
+  gst_flucachemanager_init ();
+
+  member = g_new0 (Member, 1);
+  member->owner = owner;
+  member->time = GST_CLOCK_TIME_NONE;
+
+  g_mutex_lock (lock);
+  if (budget) {
+    for (walk = members; walk; walk = g_list_next (walk))
+      used += ((Member *) walk->data)->size;
+    size = used < budget ? budget - used : 0;
+    size = MIN (MAX (size, MIN_SIZE), cap);
+    size -= size % CACHE_SLOT_SIZE;
+  }
+  member->size = size;
+  members = g_list_prepend (members, member);
+  g_mutex_unlock (lock);
+
+  return size;
+}
+
+/**
+ * gst_flucachemanager_remove:
+ * @owner: the cache
+ *
+ * Unregisters @owner, its memory goes back to the budget.
+ */
+void
+gst_flucachemanager_remove (gconstpointer owner)
+{
+  Member *member;
+
+  g_mutex_lock (lock);
+  member = gst_flucachemanager_find (owner);
+  if (member) {
+    members = g_list_remove (members, member);
+    g_free (member);
+  }
+  g_mutex_unlock (lock);
+}
+
+/**
+ * gst_flucachemanager_update:
+ * @owner: the cache
+ * @size: bytes allocated by @owner
+ * @cap: bytes asked by the user of @owner, never exceeded
+ * @received: bytes received by @owner since it was created
+ *
+ * Reports the usage of @owner and computes its share of the budget.
+ *
+ * Returns: the size @owner should have, @cap if the budget is disabled.
+ */
+gsize
+gst_flucachemanager_update (gconstpointer owner, gsize size, gsize cap,
+    guint64 received)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  guint64 rate = 0, used = 0;
+  guint count = 0;
+  Member *member;
+  GList *walk;
+  gsize target = cap;
+
+  g_mutex_lock (lock);
+  member = gst_flucachemanager_find (owner);
+  if (member == NULL)
+    goto beach;
+
+  if (GST_CLOCK_TIME_IS_VALID (member->time) && now > member->time &&
+      received >= member->received) {
+    guint64 inst = gst_util_uint64_scale (received - member->received,
+        GST_SECOND, now - member->time);
+    /* smooth over the bursts of the input */
+    member->rate = (member->rate * 3 + inst) / 4;
+  }
+  member->size = size;
+  member->received = received;
+  member->time = now;
+
+  if (budget == 0)
+    goto beach;
+
+  for (walk = members; walk; walk = g_list_next (walk)) {
+    Member *m = walk->data;
+    rate += m->rate;
+    used += m->size;
+    count++;
+  }
+
+  if (rate)
+    target = gst_util_uint64_scale (budget, member->rate, rate);
+  else
+    target = budget / count;
+  target = MAX (target, MIN (MIN_SIZE, cap));
+
+  /* only grow into what the others are not using, they will give back
+   * their excess on their next update */
+  if (target > size)
+    target = size + MIN (target - size, used < budget ? budget - used : 0);
+  target = MIN (target, cap);
+
+  target -= target % CACHE_SLOT_SIZE;
+
+  GST_LOG ("cache %p: %" G_GSIZE_FORMAT " bytes, %" G_GUINT64_FORMAT
+      " bytes/s, target %" G_GSIZE_FORMAT " bytes (%" G_GUINT64_FORMAT
+      " of %" G_GUINT64_FORMAT " bytes used)", owner, size, member->rate,
+      target, used, budget);
+
+beach:
+  g_mutex_unlock (lock);
+  return target;
+}
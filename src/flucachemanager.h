@@ -0,0 +1,53 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __FLUCACHEMANAGER_H__
+#define __FLUCACHEMANAGER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Shares one memory budget between all the caches of the process. The caches
+ * register with the manager and report their size and the bytes they
+ * received from time to time, the manager answers with the size they should
+ * have: the budget is split according to the input rate of every cache, so
+ * the busy ones grow and the idle ones shrink down to a minimum. A cache only
+ * grows into the part of the budget the others are not using.
+ *
+ * The size asked by the user of a cache is a cap: the manager shrinks a
+ * cache below it but never grows it past it.
+ *
+ * The budget is set once for the whole process with the
+ * GST_FLUTS_MEMORY_BUDGET environment variable, in bytes. A budget of 0, the
+ * default, disables the manager.
+ */
+
+guint64 gst_flucachemanager_get_budget (void);
+
+gsize gst_flucachemanager_add (gconstpointer owner, gsize cap);
+void gst_flucachemanager_remove (gconstpointer owner);
+gsize gst_flucachemanager_update (gconstpointer owner, gsize size,
+    gsize cap, guint64 received);
+
+G_END_DECLS
+
+#endif /* __FLUCACHEMANAGER_H__ */
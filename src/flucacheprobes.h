@@ -0,0 +1,61 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __FLUCACHEPROBES_H__
+#define __FLUCACHEPROBES_H__
+
+/* Static tracepoints of the cache, compiled in with --enable-usdt. They are
+ * a nop until bpftrace or perf attach to them, e.g.:
+ *
+ *   bpftrace -e 'usdt:libgstflutimeshift.so:flucache:disk_read
+ *       { @latency = hist (arg3); }'
+ *
+ * slot_state (index, from, to, offset, size)  a slot changed of state
+ * push (offset, size, recording)              data came in
+ * pop (offset, size)                          a slot is lent downstream
+ * reload (wanted, loaded, offset)             slots reloaded from the disk
+ * seek (offset, disk)                         seek to a clamped offset
+ * disk_write (position, size, offset)         live data written to the disk
+ * disk_read (position, size, offset, time)    slot read from the disk
+ * migration_start (offset, position)          ring buffer migration started
+ * migration_finish (position, time)           ring buffer migration done
+ *
+ * The arguments are fields of the cache, nothing is computed for them when
+ * the probes are compiled out.
+ */
+
+#ifdef HAVE_USDT
+#include <sys/sdt.h>
+
+#define FLUCACHE_PROBE2(name, a, b) \
+  DTRACE_PROBE2 (flucache, name, a, b)
+#define FLUCACHE_PROBE3(name, a, b, c) \
+  DTRACE_PROBE3 (flucache, name, a, b, c)
+#define FLUCACHE_PROBE4(name, a, b, c, d) \
+  DTRACE_PROBE4 (flucache, name, a, b, c, d)
+#define FLUCACHE_PROBE5(name, a, b, c, d, e) \
+  DTRACE_PROBE5 (flucache, name, a, b, c, d, e)
+#else
+#define FLUCACHE_PROBE2(name, a, b) G_STMT_START { } G_STMT_END
+#define FLUCACHE_PROBE3(name, a, b, c) G_STMT_START { } G_STMT_END
+#define FLUCACHE_PROBE4(name, a, b, c, d) G_STMT_START { } G_STMT_END
+#define FLUCACHE_PROBE5(name, a, b, c, d, e) G_STMT_START { } G_STMT_END
+#endif
+
+#endif /* __FLUCACHEPROBES_H__ */
@@ -0,0 +1,129 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __FLUCACHESHM_H__
+#define __FLUCACHESHM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Layout of a ring buffer shared through a memfd. The mapping starts with a
+ * FluCacheShmHeader followed by one FluCacheShmSlot per slot, the slot data
+ * begins at data_offset. There is a single writer, readers never block it:
+ * they detect that the data they used was overwritten with the sequence
+ * counters and retry or give up.
+ *
+ * The header seq is odd while the writer updates the offsets. A slot seq
+ * changes every time the slot is reused, the bytes [0, size) of a slot are
+ * never modified while its seq stays the same.
+ */
+
+#define FLUCACHE_SHM_MAGIC   0x464c5453 /* FLTS */
+#define FLUCACHE_SHM_VERSION 1
+
+typedef struct _FluCacheShmHeader FluCacheShmHeader;
+typedef struct _FluCacheShmSlot FluCacheShmSlot;
+
+struct _FluCacheShmHeader
+{
+  guint32 magic;
+  guint32 version;
+  guint32 slot_size;
+  guint32 nslots;
+  guint64 data_offset;          /* start of the slot data in the mapping */
+
+  volatile gint seq;
+  guint32 reserved;
+  guint64 l_offset;             /* lowest offset in the ring buffer */
+  guint64 h_offset;             /* highest offset written */
+};
+
+struct _FluCacheShmSlot
+{
+  volatile gint seq;
+  guint32 size;                 /* bytes available in the slot */
+  guint64 offset;               /* stream offset of the first byte */
+};
+
+#define FLUCACHE_SHM_SLOTS(hdr) \
+  ((FluCacheShmSlot *) ((guint8 *) (hdr) + sizeof (FluCacheShmHeader)))
+#define FLUCACHE_SHM_SLOT_DATA(hdr,i) \
+  ((guint8 *) (hdr) + (hdr)->data_offset + (gsize) (i) * (hdr)->slot_size)
+
+static inline gboolean
+flucache_shm_is_valid (const FluCacheShmHeader * hdr)
+{
+  return hdr->magic == FLUCACHE_SHM_MAGIC &&
+      hdr->version == FLUCACHE_SHM_VERSION;
+}
+
+/* Gets the range of offsets currently held in the ring buffer */
+static inline void
+flucache_shm_get_range (FluCacheShmHeader * hdr, guint64 * l_offset,
+    guint64 * h_offset)
+{
+  gint seq;
+
+  do {
+    while ((seq = g_atomic_int_get (&hdr->seq)) & 1);
+    *l_offset = hdr->l_offset;
+    *h_offset = hdr->h_offset;
+  } while (g_atomic_int_get (&hdr->seq) != seq);
+}
+
+/* Finds the slot holding @offset. On success returns a pointer to the data
+ * at @offset inside the mapping and fills the bytes available from there and
+ * the slot index and seq to check the data with flucache_shm_slot_check()
+ * once used. */
+static inline const guint8 *
+flucache_shm_slot_find (FluCacheShmHeader * hdr, guint64 offset,
+    gsize * avail, guint * index, gint * seq)
+{
+  FluCacheShmSlot *slots = FLUCACHE_SHM_SLOTS (hdr);
+  guint i;
+
+  for (i = 0; i < hdr->nslots; i++) {
+    gint s = g_atomic_int_get (&slots[i].seq);
+    guint64 start = slots[i].offset;
+    guint32 size = slots[i].size;
+
+    if (offset >= start && offset < start + size &&
+        g_atomic_int_get (&slots[i].seq) == s) {
+      *avail = start + size - offset;
+      *index = i;
+      *seq = s;
+      return FLUCACHE_SHM_SLOT_DATA (hdr, i) + (offset - start);
+    }
+  }
+  return NULL;
+}
+
+/* Returns TRUE if the data returned by flucache_shm_slot_find() was not
+ * overwritten meanwhile */
+static inline gboolean
+flucache_shm_slot_check (FluCacheShmHeader * hdr, guint index, gint seq)
+{
+  return g_atomic_int_get (&FLUCACHE_SHM_SLOTS (hdr)[index].seq) == seq;
+}
+
+G_END_DECLS
+
+#endif /* __FLUCACHESHM_H__ */
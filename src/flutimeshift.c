@@ -26,6 +26,7 @@
 #include "flutsmpegbin.h"
 #include "gsttimeshiftseeker.h"
 #include "gsttimeshifttsindexer.h"
+#include "gsttimeshifttracer.h"
 
 GST_DEBUG_CATEGORY (ts_base);
 GST_DEBUG_CATEGORY (ts_flow);
@@ -71,6 +72,12 @@ plugin_init (GstPlugin * plugin)
       gst_time_shift_ts_indexer_get_type ()))
     return FALSE;
 
+#ifdef HAVE_TIME_SHIFT_TRACER
+  if (!gst_tracer_register (plugin, "timeshift",
+          gst_time_shift_tracer_get_type ()))
+    return FALSE;
+#endif
+
   return TRUE;
 }
 
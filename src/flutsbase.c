@@ -22,8 +22,17 @@
 #endif
 
 #include "flutsbase.h"
+#include "flucachemanager.h"
 
 #include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#ifdef G_OS_WIN32
+#include <io.h>                 /* close */
+#else
+#include <unistd.h>
+#endif
 
 GST_DEBUG_CATEGORY_EXTERN (ts_base);
 GST_DEBUG_CATEGORY_EXTERN (ts_flow);
@@ -38,6 +47,50 @@ enum
 #define DEFAULT_RECORDING_REMOVE   TRUE
 #define DEFAULT_MIN_CACHE_SIZE     (4 * CACHE_SLOT_SIZE)        /* 4 cache slots */
 #define DEFAULT_CACHE_SIZE         (256 * 1024 * 1024)          /* 256 MB */
+#define DEFAULT_IO_CLASS           GST_SHIFTER_CACHE_IO_CLASS_NONE
+#define DEFAULT_IO_LEVEL           4
+#define DEFAULT_WRITE_RATE_LIMIT   0                            /* unlimited */
+#define DEFAULT_DISK_LOW_THRESHOLD (128 * 1024 * 1024)          /* 128 MB */
+#define DEFAULT_DISK_CRITICAL_THRESHOLD (32 * 1024 * 1024)      /* 32 MB */
+#define DEFAULT_SYNC_POLICY        GST_SHIFTER_CACHE_SYNC_NONE
+#define DEFAULT_SYNC_INTERVAL      (4 * 1024 * 1024)            /* 4 MB */
+#define DEFAULT_SHARED_MEMORY      FALSE
+#define DEFAULT_LIVE_PASSTHROUGH   FALSE
+#define DEFAULT_CATCH_UP           FALSE
+#define DEFAULT_CATCH_UP_RATE      1.1
+#define DEFAULT_CATCH_UP_THRESHOLD (4 * 1024 * 1024)            /* 4 MB */
+#define DEFAULT_PCR_PACING         FALSE
+#define DEFAULT_ALLOW_PULL         FALSE
+#define DEFAULT_SHARED_SCHEDULER   FALSE
+#define DEFAULT_WINDOW_DURATION    0                            /* disabled */
+#define DEFAULT_USE_BUFFERING      FALSE
+#define DEFAULT_LOW_PERCENT        10
+#define DEFAULT_HIGH_PERCENT       99
+#define DEFAULT_STATS_INTERVAL     0                            /* disabled */
+
+/* stream time between the key units pushed in trick play, scaled by the
+ * rate so decoders get about that many frames per second at any speed */
+#define TRICK_PLAY_INTERVAL        (GST_SECOND / 4)
+
+/* how late the paced output can get before pacing restarts from the
+ * current buffer, after downstream blocked for a while */
+#define PACING_MAX_LATE            (GST_SECOND / 2)
+
+/* how often the cache is resized to the bitrate for window-duration, and
+ * by how much the size has to change for it (1/16) */
+#define WINDOW_UPDATE_INTERVAL     GST_SECOND
+#define WINDOW_UPDATE_SHIFT        4
+
+/* upper bounds of the seek latency histogram buckets, the last bucket
+ * takes the rest */
+static const GstClockTime seek_buckets[GST_FLUTSBASE_SEEK_BUCKETS - 1] = {
+  10 * GST_MSECOND, 50 * GST_MSECOND, 100 * GST_MSECOND, 500 * GST_MSECOND,
+  GST_SECOND
+};
+
+/* max. amount of data queued for forwarding before falling back to the
+ * cache, when downstream doesn't keep up with the live stream */
+#define PASSTHROUGH_MAX_BYTES      (2 * 1024 * 1024)
 
 enum
 {
@@ -45,6 +98,32 @@ enum
   PROP_CACHE_SIZE,
   PROP_RECORDING_TEMPLATE,
   PROP_RECORDING_REMOVE,
+  PROP_IO_CLASS,
+  PROP_IO_LEVEL,
+  PROP_WRITE_RATE_LIMIT,
+  PROP_READ_LATENCY_STATS,
+  PROP_DISK_LOW_THRESHOLD,
+  PROP_DISK_CRITICAL_THRESHOLD,
+  PROP_SYNC_POLICY,
+  PROP_SYNC_INTERVAL,
+  PROP_SHARED_MEMORY,
+  PROP_SHARED_MEMORY_FD,
+  PROP_LIVE_PASSTHROUGH,
+  PROP_CATCH_UP,
+  PROP_CATCH_UP_RATE,
+  PROP_CATCH_UP_THRESHOLD,
+  PROP_LIVE_DISTANCE,
+  PROP_PCR_PACING,
+  PROP_ALLOW_PULL,
+  PROP_SHARED_SCHEDULER,
+  PROP_MEMORY_BUDGET,
+  PROP_MEMORY_USAGE,
+  PROP_WINDOW_DURATION,
+  PROP_USE_BUFFERING,
+  PROP_LOW_PERCENT,
+  PROP_HIGH_PERCENT,
+  PROP_STATS,
+  PROP_STATS_INTERVAL,
   PROP_LAST
 };
 
@@ -54,8 +133,10 @@ enum
       GST_DEBUG_PAD_NAME (pad),                                           \
       gst_shifter_cache_fullness (ts->cache))
 
+/* only a contended lock is timed, taking a free one costs a trylock */
 #define FLOW_MUTEX_LOCK(ts) G_STMT_START {                                \
-  g_mutex_lock (ts->flow_lock);                                           \
+  if (G_UNLIKELY (!g_mutex_trylock (ts->flow_lock)))                      \
+    gst_flutsbase_lock_contended (ts);                                    \
 } G_STMT_END
 
 #define FLOW_MUTEX_LOCK_CHECK(ts,res,label) G_STMT_START {                \
@@ -80,12 +161,36 @@ enum
 
 #define FLOW_SIGNAL_ADD(ts) G_STMT_START {                                \
   STATUS (ts, ts->sinkpad, "signal ADD");                                 \
-  g_cond_signal (ts->buffer_add);                                         \
+  g_cond_broadcast (ts->buffer_add);                                      \
+} G_STMT_END
+
+/* the flow lock serializes the writers of the counters, the readers only
+ * retry while counters_seq is odd or changed meanwhile */
+#define COUNTERS_BEGIN(ts) g_atomic_int_inc (&(ts)->counters_seq)
+#define COUNTERS_END(ts) g_atomic_int_inc (&(ts)->counters_seq)
+
+#define COUNTERS_ADD(ts, field, value) G_STMT_START {                     \
+  COUNTERS_BEGIN (ts);                                                    \
+  (ts)->counters.field += (value);                                        \
+  COUNTERS_END (ts);                                                      \
 } G_STMT_END
 
 static GstElementClass *parent_class = NULL;
+
+static void
+gst_flutsbase_lock_contended (GstFluTSBase * ts)
+{
+  GstClockTime start = gst_util_get_timestamp ();
+
+  g_mutex_lock (ts->flow_lock);
+  COUNTERS_BEGIN (ts);
+  ts->counters.lock_waits++;
+  ts->counters.lock_wait_time += gst_util_get_timestamp () - start;
+  COUNTERS_END (ts);
+}
 static void gst_flutsbase_class_init (GstFluTSBaseClass * klass);
 static void gst_flutsbase_init (GstFluTSBase * ts, GstFluTSBaseClass * klass);
+static void gst_flutsbase_loop_pause (GstFluTSBase * ts);
 
 GType
 gst_flutsbase_get_type (void)
@@ -113,28 +218,298 @@ gst_flutsbase_get_type (void)
   return type;
 }
 
+GType
+gst_flutsbase_io_class_get_type (void)
+{
+  static volatile gsize type = 0;
+  static const GEnumValue values[] = {
+    {GST_SHIFTER_CACHE_IO_CLASS_NONE, "Leave it untouched", "none"},
+    {GST_SHIFTER_CACHE_IO_CLASS_REALTIME, "Realtime", "realtime"},
+    {GST_SHIFTER_CACHE_IO_CLASS_BEST_EFFORT, "Best effort", "best-effort"},
+    {GST_SHIFTER_CACHE_IO_CLASS_IDLE, "Idle", "idle"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = g_enum_register_static ("GstFluTSBaseIOClass", values);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+GType
+gst_flutsbase_disk_state_get_type (void)
+{
+  static volatile gsize type = 0;
+  static const GEnumValue values[] = {
+    {GST_SHIFTER_CACHE_DISK_OK, "Enough free space", "ok"},
+    {GST_SHIFTER_CACHE_DISK_LOW, "Discarding old recorded data", "low"},
+    {GST_SHIFTER_CACHE_DISK_FULL, "Disk not used, memory only", "full"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = g_enum_register_static ("GstFluTSBaseDiskState", values);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+GType
+gst_flutsbase_sync_policy_get_type (void)
+{
+  static volatile gsize type = 0;
+  static const GEnumValue values[] = {
+    {GST_SHIFTER_CACHE_SYNC_NONE, "Let the kernel write back", "none"},
+    {GST_SHIFTER_CACHE_SYNC_RANGE, "Start the writeback of every interval",
+        "range"},
+    {GST_SHIFTER_CACHE_SYNC_DATA, "Sync the data every interval", "data"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = g_enum_register_static ("GstFluTSBaseSyncPolicy", values);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+/* Leaves the passthrough mode, the pushing loop continues from the cache at
+ * the first byte that was not forwarded. Called with the flow lock */
+static void
+gst_flutsbase_passthrough_stop (GstFluTSBase * ts)
+{
+  GstBuffer *buffer;
+
+  if (!ts->passthrough)
+    return;
+
+  GST_DEBUG_OBJECT (ts, "leaving passthrough at offset %" G_GUINT64_FORMAT,
+      ts->cur_bytes);
+
+  while ((buffer = g_queue_pop_head (&ts->passthrough_queue)))
+    gst_buffer_unref (buffer);
+  ts->passthrough_bytes = 0;
+  ts->passthrough = FALSE;
+  /* the loop could be waiting for the queue */
+  FLOW_SIGNAL_ADD (ts);
+}
+
+/* Called with the flow lock */
+static void
+gst_flutsbase_reset_stats (GstFluTSBase * ts)
+{
+  COUNTERS_BEGIN (ts);
+  memset (&ts->counters, 0, sizeof (ts->counters));
+  COUNTERS_END (ts);
+}
+
+/**
+ * gst_flutsbase_get_counters:
+ * @ts: a #GstFluTSBase
+ * @counters: where to copy the counters
+ *
+ * Takes a consistent snapshot of the runtime statistics without taking any
+ * lock, so it never holds up the streaming threads. Can be called from any
+ * thread.
+ */
+void
+gst_flutsbase_get_counters (GstFluTSBase * ts,
+    GstFluTSBaseCounters * counters)
+{
+  gint seq;
+
+  do {
+    while ((seq = g_atomic_int_get (&ts->counters_seq)) & 1)
+      g_thread_yield ();
+    *counters = ts->counters;
+  } while (g_atomic_int_get (&ts->counters_seq) != seq);
+}
+
+/**
+ * gst_flutsbase_get_ingest_offset:
+ * @ts: a #GstFluTSBase
+ *
+ * Returns: the cache offset the data of the last buffer or buffer list
+ * received was stored at, or GST_BUFFER_OFFSET_NONE if it wasn't stored.
+ * Read like the counters, without taking any lock.
+ */
+guint64
+gst_flutsbase_get_ingest_offset (GstFluTSBase * ts)
+{
+  guint64 offset;
+  gint seq;
+
+  do {
+    while ((seq = g_atomic_int_get (&ts->counters_seq)) & 1)
+      g_thread_yield ();
+    offset = ts->ingest_offset;
+  } while (g_atomic_int_get (&ts->counters_seq) != seq);
+
+  return offset;
+}
+
+/* Sets the fields of the runtime statistics in @stru */
+static void
+gst_flutsbase_set_counters (GstStructure * stru,
+    const GstFluTSBaseCounters * counters)
+{
+  GValue histogram = { 0, };
+  GValue value = { 0, };
+  guint i;
+
+  gst_structure_set (stru,
+      "bytes-in", G_TYPE_UINT64, counters->bytes_in,
+      "bytes-out", G_TYPE_UINT64, counters->bytes_out,
+      "underruns", G_TYPE_UINT64, counters->underruns,
+      "lock-waits", G_TYPE_UINT64, counters->lock_waits,
+      "lock-wait-time", G_TYPE_UINT64, counters->lock_wait_time,
+      "seeks", G_TYPE_UINT64, counters->seeks,
+      "seek-latency-max", G_TYPE_UINT64, counters->seek_latency_max, NULL);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&value, G_TYPE_UINT64);
+  for (i = 0; i < GST_FLUTSBASE_SEEK_BUCKETS; i++) {
+    g_value_set_uint64 (&value, counters->seek_histogram[i]);
+    gst_value_array_append_value (&histogram, &value);
+  }
+  gst_structure_take_value (stru, "seek-latency-histogram", &histogram);
+  g_value_unset (&value);
+}
+
+/* Posts the counters from the thread of the system clock. Neither the flow
+ * lock nor the cache lock are taken, the levels of the cache are only in the
+ * stats property */
+static gboolean
+gst_flutsbase_stats_timeout (GstClock * clock, GstClockTime time,
+    GstClockID id, GstFluTSBase * ts)
+{
+  GstFluTSBaseCounters counters;
+  GstStructure *stru;
+  gboolean stopped;
+
+  g_mutex_lock (ts->stats_lock);
+  stopped = ts->stats_id != id;
+  g_mutex_unlock (ts->stats_lock);
+  if (stopped)
+    return TRUE;
+
+  gst_flutsbase_get_counters (ts, &counters);
+  stru = gst_structure_new_empty ("shifter-stats");
+  gst_flutsbase_set_counters (stru, &counters);
+
+  gst_element_post_message (GST_ELEMENT_CAST (ts),
+      gst_message_new_element (GST_OBJECT (ts), stru));
+  return TRUE;
+}
+
+/* Called with the flow lock */
+static void
+gst_flutsbase_stats_stop (GstFluTSBase * ts)
+{
+  GstClockID id;
+
+  g_mutex_lock (ts->stats_lock);
+  id = ts->stats_id;
+  ts->stats_id = NULL;
+  g_mutex_unlock (ts->stats_lock);
+
+  if (id) {
+    gst_clock_id_unschedule (id);
+    gst_clock_id_unref (id);
+  }
+}
+
+/* Posts the stats every stats-interval until gst_flutsbase_stats_stop(),
+ * called with the flow lock */
+static void
+gst_flutsbase_stats_start (GstFluTSBase * ts)
+{
+  GstClock *clock;
+  GstClockID id;
+
+  gst_flutsbase_stats_stop (ts);
+  if (!ts->stats_interval)
+    return;
+
+  clock = gst_system_clock_obtain ();
+  id = gst_clock_new_periodic_id (clock,
+      gst_clock_get_time (clock) + ts->stats_interval, ts->stats_interval);
+  g_mutex_lock (ts->stats_lock);
+  ts->stats_id = id;
+  g_mutex_unlock (ts->stats_lock);
+  gst_clock_id_wait_async (id,
+      (GstClockCallback) gst_flutsbase_stats_timeout, gst_object_ref (ts),
+      (GDestroyNotify) gst_object_unref);
+  gst_object_unref (clock);
+}
+
 static void
 gst_flutsbase_start (GstFluTSBase * ts)
 {
+  GstFluTSBaseClass *klass = GST_FLUTSBASE_GET_CLASS (ts);
+  GList *walk;
+
   FLOW_MUTEX_LOCK (ts);
+  gst_flutsbase_passthrough_stop (ts);
   if (ts->cache) {
     gst_shifter_cache_unref (ts->cache);
     ts->cache = NULL;
   }
 
-  ts->cache = gst_shifter_cache_new (ts->cache_size, ts->recording_template);
+  if (ts->shared_memory) {
+    ts->cache = gst_shifter_cache_new_shared (ts->cache_size,
+        ts->recording_template);
+  } else {
+    ts->cache = gst_shifter_cache_new (ts->cache_size,
+        ts->recording_template);
+  }
   gst_shifter_cache_set_autoremove (ts->cache, ts->recording_remove);
+  gst_shifter_cache_set_io_priority (ts->cache, ts->io_class, ts->io_level);
+  gst_shifter_cache_set_write_rate (ts->cache, ts->write_rate_limit);
+  gst_shifter_cache_set_disk_thresholds (ts->cache, ts->disk_low_threshold,
+      ts->disk_critical_threshold);
+  ts->disk_state = GST_SHIFTER_CACHE_DISK_OK;
+  gst_shifter_cache_set_sync_policy (ts->cache, ts->sync_policy,
+      ts->sync_interval);
+  gst_shifter_cache_set_shared_scheduler (ts->cache, ts->shared_scheduler);
+  ts->window_size = 0;
+  ts->window_update = GST_CLOCK_TIME_NONE;
+  ts->first_offset = 0;
+  if (klass->trim)
+    klass->trim (ts, 0);
+  gst_flutsbase_reset_stats (ts);
+  gst_flutsbase_stats_start (ts);
+
+  /* the request pads start over with the new cache */
+  for (walk = ts->outputs; walk; walk = g_list_next (walk)) {
+    GstFluTSBaseOutput *out = walk->data;
+
+    out->cursor = gst_shifter_cache_cursor_new (ts->cache, 0);
+    gst_segment_init (&out->segment, GST_FORMAT_BYTES);
+    out->need_newsegment = TRUE;
+  }
 
   gst_segment_init (&ts->segment, GST_FORMAT_BYTES);
   ts->recording_started = FALSE;
+  ts->buffering = FALSE;
+  ts->buffering_percent = 100;
   FLOW_MUTEX_UNLOCK (ts);
 }
 
+static void
+gst_flutsbase_output_clear_cursor (GstFluTSBaseOutput * out)
+{
+  out->cursor = NULL;
+}
+
 static void
 gst_flutsbase_stop (GstFluTSBase * ts)
 {
   gboolean is_recording = FALSE;
   FLOW_MUTEX_LOCK (ts);
+  gst_flutsbase_stats_stop (ts);
+  gst_flutsbase_passthrough_stop (ts);
   if (ts->cache) {
     gchar *filename = gst_shifter_cache_get_filename (ts->cache);
     is_recording = gst_shifter_cache_is_recording (ts->cache);
@@ -149,6 +524,9 @@ gst_flutsbase_stop (GstFluTSBase * ts)
     gst_shifter_cache_unref (ts->cache);
     ts->cache = NULL;
   }
+  /* the cursors went away with the cache */
+  g_list_foreach (ts->outputs, (GFunc) gst_flutsbase_output_clear_cursor,
+      NULL);
   FLOW_MUTEX_UNLOCK (ts);
 }
 
@@ -179,33 +557,33 @@ wrong_state:
   }
 }
 
-/* Pop a buffer from the cache and push it downstream.
- * This functions returns the result of the push. */
-static GstFlowReturn
-gst_flutsbase_pop (GstFluTSBase * ts)
+/* Pushes the STREAM_START and SEGMENT events due before the buffer at
+ * @offset, called with the flow lock */
+static gboolean
+gst_flutsbase_push_pending_events (GstFluTSBase * ts, guint64 offset)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBuffer *buffer;
-
-  if (!(buffer = gst_shifter_cache_pop (ts->cache, ts->is_eos)))
-    goto no_item;
-
-  if (ts->srcresult == GST_FLOW_FLUSHING) {
-    gst_buffer_unref (buffer);
-    goto out_flushing;
-  }
-
   if (ts->stream_start_event) {
-    if (!gst_pad_push_event (ts->srcpad, ts->stream_start_event)) {
-      goto stream_start_failed;
-    }
+    GstEvent *event = ts->stream_start_event;
+
     ts->stream_start_event = NULL;
+    if (!gst_pad_push_event (ts->srcpad, event)) {
+      GST_CAT_LOG_OBJECT (ts_flow, ts, "push of STREAM_START event failed");
+      return FALSE;
+    }
   }
 
   if (G_UNLIKELY (ts->need_newsegment)) {
     GstEvent *newsegment;
 
-    ts->segment.start = GST_BUFFER_OFFSET (buffer);
+    if (ts->segment.rate < 0.0) {
+      /* played backwards from @offset */
+      ts->segment.start = 0;
+      ts->segment.stop = offset;
+    } else {
+      ts->segment.start = offset;
+      /* the stop of the seek, in bytes like the start */
+      ts->segment.stop = ts->seek_stop;
+    }
     ts->segment.time = 0; /* <- Not relevant for FORMAT_BYTES */
     ts->segment.flags |= GST_SEGMENT_FLAG_RESET;
 
@@ -214,12 +592,218 @@ gst_flutsbase_pop (GstFluTSBase * ts)
     newsegment = gst_event_new_segment (&ts->segment);
     if (newsegment) {
       if (!gst_pad_push_event (ts->srcpad, newsegment)) {
-        goto segment_failed;
+        GST_CAT_LOG_OBJECT (ts_flow, ts, "push of SEGMENT event failed");
+        return FALSE;
       }
     }
     ts->need_newsegment = FALSE;
+
+    if (GST_CLOCK_TIME_IS_VALID (ts->seek_time)) {
+      GstClockTime latency = gst_util_get_timestamp () - ts->seek_time;
+      guint i;
+
+      GST_DEBUG_OBJECT (ts, "first buffer %" GST_TIME_FORMAT " after seek",
+          GST_TIME_ARGS (latency));
+      for (i = 0; i < G_N_ELEMENTS (seek_buckets); i++) {
+        if (latency < seek_buckets[i])
+          break;
+      }
+      COUNTERS_BEGIN (ts);
+      ts->counters.seek_histogram[i]++;
+      ts->counters.seek_latency_max =
+          MAX (ts->counters.seek_latency_max, latency);
+      COUNTERS_END (ts);
+      ts->seek_time = GST_CLOCK_TIME_NONE;
+    }
+  }
+
+  if (G_UNLIKELY (ts->need_rate_update)) {
+    GstSegment segment = ts->segment;
+    GstEvent *update;
+
+    /* continues the current segment at the new rate */
+    segment.start = offset;
+    segment.flags &= ~GST_SEGMENT_FLAG_RESET;
+    if (ts->catching_up)
+      segment.rate *= ts->catch_up_rate;
+
+    GST_DEBUG_OBJECT (ts, "pushing rate update %" GST_SEGMENT_FORMAT,
+        &segment);
+
+    update = gst_event_new_segment (&segment);
+    ts->need_rate_update = FALSE;
+    if (update && !gst_pad_push_event (ts->srcpad, update)) {
+      GST_CAT_LOG_OBJECT (ts_flow, ts, "push of SEGMENT event failed");
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* Waits until the data at stream @time is due, so the cache is pushed at
+ * the original bitrate scaled by the rate. Called with the flow lock,
+ * released while waiting. Returns FALSE if we started flushing meanwhile. */
+static gboolean
+gst_flutsbase_pace_time (GstFluTSBase * ts, GstClockTime time)
+{
+  GstClockTime now, target, delta;
+  GstClock *clock;
+  gdouble rate;
+
+  if (!ts->pcr_pacing || !GST_CLOCK_TIME_IS_VALID (time))
+    return TRUE;
+
+  clock = gst_system_clock_obtain ();
+  now = gst_clock_get_time (clock);
+
+  /* the stream time runs at the rate of the segment, backwards too */
+  rate = ts->segment.rate;
+  if (ts->catching_up)
+    rate *= ts->catch_up_rate;
+
+  if (GST_CLOCK_TIME_IS_VALID (ts->pacing_base) &&
+      (rate > 0.0 ? time >= ts->pacing_time : time <= ts->pacing_time)) {
+    delta = rate > 0.0 ? time - ts->pacing_time : ts->pacing_time - time;
+    target = ts->pacing_base + (GstClockTime) (delta / ABS (rate));
+    if (target > now) {
+      GstClockID id = gst_clock_new_single_shot_id (clock, target);
+
+      ts->pacing_id = id;
+      FLOW_MUTEX_UNLOCK (ts);
+      gst_clock_id_wait (id, NULL);
+      FLOW_MUTEX_LOCK (ts);
+      ts->pacing_id = NULL;
+      gst_clock_id_unref (id);
+      goto done;
+    } else if (now - target <= PACING_MAX_LATE) {
+      goto done;
+    }
+    GST_DEBUG_OBJECT (ts, "%" GST_TIME_FORMAT " late, restart pacing",
+        GST_TIME_ARGS (now - target));
+  }
+
+  /* the reference for the next buffers */
+  ts->pacing_base = now;
+  ts->pacing_time = time;
+
+done:
+  gst_object_unref (clock);
+  return ts->srcresult == GST_FLOW_OK;
+}
+
+/* Paces the data at @offset, see gst_flutsbase_pace_time() */
+static gboolean
+gst_flutsbase_pace (GstFluTSBase * ts, guint64 offset)
+{
+  GstFluTSBaseClass *klass = GST_FLUTSBASE_GET_CLASS (ts);
+
+  if (!ts->pcr_pacing || !klass->get_stream_time)
+    return TRUE;
+
+  return gst_flutsbase_pace_time (ts, klass->get_stream_time (ts, offset));
+}
+
+/* Stops pacing, a new reference is taken with the next buffer. Called with
+ * the flow lock */
+static void
+gst_flutsbase_pace_reset (GstFluTSBase * ts)
+{
+  if (ts->pacing_id)
+    gst_clock_id_unschedule (ts->pacing_id);
+  ts->pacing_base = GST_CLOCK_TIME_NONE;
+}
+
+static guint64
+gst_flutsbase_get_live_distance (GstFluTSBase * ts)
+{
+  guint64 live;
+
+  if (!ts->cache)
+    return 0;
+
+  live = gst_shifter_cache_get_total_bytes_received (ts->cache);
+  return live > ts->cur_bytes ? live - ts->cur_bytes : 0;
+}
+
+/* Part of the data between the reader and the live edge that is in the ring
+ * buffer, in percent, up to the size of the ring buffer. At the live edge
+ * all there is to read is in memory, so we don't buffer there. Called with
+ * the flow lock */
+static gint
+gst_flutsbase_ring_percent (GstFluTSBase * ts)
+{
+  guint64 size, ahead, level;
+
+  size = gst_shifter_cache_get_memory_usage (ts->cache);
+  ahead = MIN (gst_flutsbase_get_live_distance (ts), size);
+  if (ts->is_eos || ahead == 0)
+    return 100;
+  level = gst_shifter_cache_fullness (ts->cache);
+
+  return MIN (level * 100 / ahead, 100);
+}
+
+/* Posts buffering messages when the ring buffer goes below low-percent and
+ * until it gets back to high-percent, called with the flow lock */
+static void
+gst_flutsbase_update_buffering (GstFluTSBase * ts)
+{
+  GstMessage *msg;
+  gint percent;
+
+  if (G_LIKELY (!ts->use_buffering) || !ts->cache)
+    return;
+
+  percent = gst_flutsbase_ring_percent (ts);
+  if (ts->buffering) {
+    if (percent >= ts->high_percent) {
+      ts->buffering = FALSE;
+      percent = 100;
+    } else {
+      percent = percent * 100 / ts->high_percent;
+    }
+  } else if (percent < ts->low_percent) {
+    ts->buffering = TRUE;
+    percent = percent * 100 / ts->high_percent;
+  } else {
+    return;
+  }
+
+  if (percent == ts->buffering_percent)
+    return;
+  ts->buffering_percent = percent;
+
+  GST_DEBUG_OBJECT (ts, "buffering %d%%", percent);
+  msg = gst_message_new_buffering (GST_OBJECT_CAST (ts), percent);
+  gst_message_set_buffering_stats (msg, GST_BUFFERING_TIMESHIFT, -1, -1, -1);
+  gst_element_post_message (GST_ELEMENT_CAST (ts), msg);
+}
+
+/* Pop a buffer from the cache and push it downstream.
+ * This functions returns the result of the push. */
+static GstFlowReturn
+gst_flutsbase_pop (GstFluTSBase * ts)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *buffer;
+
+  if (!(buffer = gst_shifter_cache_pop (ts->cache, ts->is_eos)))
+    goto no_item;
+
+  if (ts->srcresult == GST_FLOW_FLUSHING) {
+    gst_buffer_unref (buffer);
+    goto out_flushing;
+  }
+
+  if (!gst_flutsbase_push_pending_events (ts, GST_BUFFER_OFFSET (buffer)) ||
+      !gst_flutsbase_pace (ts, GST_BUFFER_OFFSET (buffer))) {
+    gst_buffer_unref (buffer);
+    goto out_flushing;
   }
   ts->cur_bytes = GST_BUFFER_OFFSET_END (buffer);
+  COUNTERS_ADD (ts, bytes_out, gst_buffer_get_size (buffer));
+  gst_flutsbase_update_buffering (ts);
   FLOW_MUTEX_UNLOCK (ts);
 
   GST_CAT_LOG_OBJECT (ts_flow, ts,
@@ -257,7 +841,7 @@ no_item:
     if (ts->is_eos) {
       GST_CAT_LOG_OBJECT (ts_flow, ts, "pushing EOS");
       gst_pad_push_event (ts->srcpad, gst_event_new_eos ());
-      gst_pad_pause_task (ts->srcpad);
+      gst_flutsbase_loop_pause (ts);
       GST_CAT_LOG_OBJECT (ts_flow, ts, "pause task, reason: EOS");
       return GST_FLOW_OK;
     } else {
@@ -270,57 +854,350 @@ out_flushing:
     GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we are flushing");
     return GST_FLOW_FLUSHING;
   }
-segment_failed:
-  {
-    GST_CAT_LOG_OBJECT (ts_flow, ts, "push of SEGMENT event failed");
-    return GST_FLOW_FLUSHING;
+}
+
+/* Starts playing at catch-up-rate when more than catch-up-threshold behind
+ * the live edge, and goes back to normal speed once there. Called with the
+ * flow lock */
+static void
+gst_flutsbase_update_catch_up (GstFluTSBase * ts)
+{
+  gboolean catching_up = FALSE;
+
+  if (ts->catch_up && ts->segment.rate == 1.0 && !ts->passthrough) {
+    guint64 distance = gst_flutsbase_get_live_distance (ts);
+
+    if (ts->catching_up)
+      catching_up = distance > CACHE_SLOT_SIZE;
+    else
+      catching_up = distance > ts->catch_up_threshold;
   }
-stream_start_failed:
-  {
-    ts->stream_start_event = NULL;
-    GST_CAT_LOG_OBJECT (ts_flow, ts, "push of STREAM_START event failed");
-    return GST_FLOW_FLUSHING;
+
+  if (catching_up != ts->catching_up) {
+    GST_DEBUG_OBJECT (ts, "%s catching up, %" G_GUINT64_FORMAT
+        " bytes behind live", catching_up ? "start" : "stop",
+        gst_flutsbase_get_live_distance (ts));
+    ts->catching_up = catching_up;
+    ts->need_rate_update = TRUE;
+    /* the pacing reference was taken at the previous rate */
+    ts->pacing_base = GST_CLOCK_TIME_NONE;
   }
 }
 
-/* called repeadedly with @pad as the source pad. This function should push out
- * data to the peer element. */
-static void
-gst_flutsbase_loop (GstPad * pad)
+/* Switches to forwarding the incoming buffers directly when playing at the
+ * live edge, what's left in the cache until then is forwarded first.
+ * Called with the flow lock, returns TRUE when in passthrough. */
+static gboolean
+gst_flutsbase_passthrough_start (GstFluTSBase * ts)
 {
-  GstFluTSBase *ts;
-  GstFlowReturn ret;
+  GstBuffer *buffer;
+  guint64 offset, live;
 
-  ts = GST_FLUTSBASE (GST_PAD_PARENT (pad));
+  if (ts->passthrough)
+    return TRUE;
 
-  /* have to lock for thread-safety */
-  FLOW_MUTEX_LOCK_CHECK (ts, ts->srcresult, out_flushing);
+  if (!ts->live_passthrough || !ts->playing || ts->is_eos || ts->unexpected ||
+      ts->segment.rate != 1.0 || ts->catching_up)
+    return FALSE;
 
-  if (gst_shifter_cache_is_empty (ts->cache) && !ts->is_eos) {
-    GST_CAT_LOG_OBJECT (ts_flow, ts, "empty, waiting for new data");
-    do {
-      /* Wait for data to be available, we could be unlocked because of a flush. */
-      FLOW_WAIT_ADD_CHECK (ts, ts->srcresult, out_flushing);
+  /* only when the cache holds less than a slot to play */
+  offset = gst_shifter_cache_get_read_offset (ts->cache);
+  live = gst_shifter_cache_get_total_bytes_received (ts->cache);
+  if (live - offset > CACHE_SLOT_SIZE)
+    return FALSE;
+
+  if (live > offset) {
+    buffer = gst_shifter_cache_read (ts->cache, offset, live - offset);
+    if (buffer == NULL)
+      return FALSE;
+    if (GST_BUFFER_OFFSET_END (buffer) != live) {
+      gst_buffer_unref (buffer);
+      return FALSE;
     }
-    while (gst_shifter_cache_is_empty (ts->cache) && !ts->is_eos);
+    g_queue_push_tail (&ts->passthrough_queue, buffer);
+    ts->passthrough_bytes = live - offset;
   }
-  ret = gst_flutsbase_pop (ts);
-  ts->srcresult = ret;
-  if (ret != GST_FLOW_OK)
-    goto out_flushing;
 
-  FLOW_MUTEX_UNLOCK (ts);
+  GST_DEBUG_OBJECT (ts, "entering passthrough at offset %" G_GUINT64_FORMAT,
+      offset);
+  ts->passthrough = TRUE;
 
-  return;
+  return TRUE;
+}
 
-  /* ERRORS */
-out_flushing:
-  {
-    gboolean eos = ts->is_eos;
-    GstFlowReturn ret = ts->srcresult;
+/* Push the next buffer queued in passthrough downstream, the cache is moved
+ * past it so that leaving passthrough continues at the next byte.
+ * This functions returns the result of the push. */
+static GstFlowReturn
+gst_flutsbase_passthrough_pop (GstFluTSBase * ts)
+{
+  GstFlowReturn ret;
+  GstBuffer *buffer;
 
-    gst_pad_pause_task (ts->srcpad);
-    FLOW_MUTEX_UNLOCK (ts);
+  buffer = g_queue_pop_head (&ts->passthrough_queue);
+  ts->passthrough_bytes -= gst_buffer_get_size (buffer);
+
+  if (!gst_flutsbase_push_pending_events (ts, GST_BUFFER_OFFSET (buffer))) {
+    gst_buffer_unref (buffer);
+    goto out_flushing;
+  }
+  ts->cur_bytes = GST_BUFFER_OFFSET_END (buffer);
+  COUNTERS_ADD (ts, bytes_out, gst_buffer_get_size (buffer));
+  FLOW_MUTEX_UNLOCK (ts);
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts,
+      "forwarding buffer %p of size %d, offset %" G_GUINT64_FORMAT,
+      buffer, gst_buffer_get_size (buffer), GST_BUFFER_OFFSET (buffer));
+
+  ret = gst_pad_push (ts->srcpad, buffer);
+
+  /* need to check for srcresult here as well */
+  FLOW_MUTEX_LOCK_CHECK (ts, ts->srcresult, out_flushing);
+  gst_shifter_cache_skip (ts->cache, ts->cur_bytes);
+  if (ret == GST_FLOW_EOS) {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "got GST_FLOW_EOS from downstream");
+    /* same as in gst_flutsbase_pop(), drop everything we have */
+    gst_flutsbase_passthrough_stop (ts);
+    gst_shifter_cache_skip (ts->cache,
+        gst_shifter_cache_get_total_bytes_received (ts->cache));
+    ts->unexpected = TRUE;
+    ret = GST_FLOW_OK;
+  }
+
+  return ret;
+
+  /* ERRORS */
+out_flushing:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we are flushing");
+    return GST_FLOW_FLUSHING;
+  }
+}
+
+static gboolean
+gst_flutsbase_is_trick_play (GstFluTSBase * ts)
+{
+  return (ts->segment.rate > 1.0 || ts->segment.rate < 0.0) &&
+      GST_FLUTSBASE_GET_CLASS (ts)->find_key_unit != NULL;
+}
+
+/* Push the next key unit downstream in fast forward or reverse, skipping
+ * the data in between. The key units are chosen TRICK_PLAY_INTERVAL * rate
+ * apart so the amount of data read and decoded doesn't depend on the rate,
+ * with pcr-pacing they are pushed TRICK_PLAY_INTERVAL apart too, otherwise
+ * as fast as downstream takes them.
+ * This functions returns the result of the push. */
+static GstFlowReturn
+gst_flutsbase_trick_pop (GstFluTSBase * ts)
+{
+  GstFluTSBaseClass *klass = GST_FLUTSBASE_GET_CLASS (ts);
+  GstFlowReturn ret;
+  GstBuffer *buffer;
+  GstClockTime time;
+  guint64 start, stop;
+  gboolean found;
+
+  gboolean forward = ts->segment.rate > 0.0;
+  GstClockTime step;
+
+  step = (GstClockTime) (TRICK_PLAY_INTERVAL * ABS (ts->segment.rate));
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts->trick_time)) {
+    /* first key unit from the seek position */
+    found = klass->find_key_unit (ts, GST_FORMAT_BYTES,
+        gst_shifter_cache_get_read_offset (ts->cache), forward, &start,
+        &stop, &time);
+  } else if (forward) {
+    found = klass->find_key_unit (ts, GST_FORMAT_TIME, ts->trick_time + step,
+        forward, &start, &stop, &time);
+  } else if (ts->trick_time > step) {
+    found = klass->find_key_unit (ts, GST_FORMAT_TIME, ts->trick_time - step,
+        forward, &start, &stop, &time);
+  } else {
+    goto reverse_done;
+  }
+
+  if (!found) {
+    if (!forward)
+      goto reverse_done;
+    goto no_key_unit;
+  }
+  if (stop > gst_shifter_cache_get_total_bytes_received (ts->cache))
+    goto no_key_unit;
+
+  /* the ranges come from the ring buffer or the disk, whatever is there, so
+   * stepping back never flushes the slots we could reuse */
+  if (!(buffer = gst_shifter_cache_read (ts->cache, start, stop - start))) {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "key unit at %" G_GUINT64_FORMAT
+        " not cached", start);
+    /* going backwards nothing older is cached either */
+    if (!forward)
+      goto reverse_done;
+    /* not cached anymore, try with the next one */
+    ts->trick_time = time;
+    return GST_FLOW_OK;
+  }
+  GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DISCONT);
+  ts->trick_time = time;
+
+  if (!gst_flutsbase_push_pending_events (ts, start) ||
+      !gst_flutsbase_pace_time (ts, time)) {
+    gst_buffer_unref (buffer);
+    goto out_flushing;
+  }
+  ts->cur_bytes = GST_BUFFER_OFFSET_END (buffer);
+  COUNTERS_ADD (ts, bytes_out, gst_buffer_get_size (buffer));
+  FLOW_MUTEX_UNLOCK (ts);
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts,
+      "pushing key unit %p of size %d, offset %" G_GUINT64_FORMAT
+      ", time %" GST_TIME_FORMAT, buffer, gst_buffer_get_size (buffer),
+      start, GST_TIME_ARGS (time));
+
+  ret = gst_pad_push (ts->srcpad, buffer);
+
+  /* need to check for srcresult here as well */
+  FLOW_MUTEX_LOCK_CHECK (ts, ts->srcresult, out_flushing);
+  if (ret == GST_FLOW_EOS) {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "got GST_FLOW_EOS from downstream");
+    ts->unexpected = TRUE;
+    ret = GST_FLOW_OK;
+  }
+
+  return ret;
+
+  /* ERRORS */
+reverse_done:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "reached the start of the cache, "
+        "pushing EOS");
+    gst_pad_push_event (ts->srcpad, gst_event_new_eos ());
+    gst_flutsbase_loop_pause (ts);
+    return GST_FLOW_OK;
+  }
+no_key_unit:
+  {
+    if (ts->is_eos) {
+      GST_CAT_LOG_OBJECT (ts_flow, ts, "pushing EOS");
+      gst_pad_push_event (ts->srcpad, gst_event_new_eos ());
+      gst_flutsbase_loop_pause (ts);
+      GST_CAT_LOG_OBJECT (ts_flow, ts, "pause task, reason: EOS");
+      return GST_FLOW_OK;
+    }
+    /* caught up with the live stream, wait for the next key unit */
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "no key unit, waiting for new data");
+    FLOW_WAIT_ADD_CHECK (ts, ts->srcresult, out_flushing);
+    return GST_FLOW_OK;
+  }
+out_flushing:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we are flushing");
+    return GST_FLOW_FLUSHING;
+  }
+}
+
+/* Moves the cache to the latest seek requested and resumes the pushing
+ * from there, called with the flow lock */
+static void
+gst_flutsbase_perform_seek (GstFluTSBase * ts)
+{
+  GST_DEBUG_OBJECT (ts, "moving cache to offset %" G_GUINT64_FORMAT,
+      ts->seek_offset);
+  gst_shifter_cache_seek (ts->cache, ts->seek_offset);
+
+  /* remember the rate and the flags */
+  ts->segment.rate = ts->seek_rate;
+  ts->segment.flags = GST_SEGMENT_FLAG_RESET;
+  if (ts->seek_flags & GST_SEEK_FLAG_SKIP)
+    ts->segment.flags |= GST_SEGMENT_FLAG_SKIP;
+  if (ts->seek_flags & GST_SEEK_FLAG_SEGMENT)
+    ts->segment.flags |= GST_SEGMENT_FLAG_SEGMENT;
+  ts->trick_time = GST_CLOCK_TIME_NONE;
+  ts->catching_up = FALSE;
+  ts->need_rate_update = FALSE;
+
+  ts->srcresult = GST_FLOW_OK;
+  ts->is_eos = FALSE;
+  ts->unexpected = FALSE;
+  ts->need_newsegment = TRUE;
+  ts->seeking = FALSE;
+}
+
+/* called repeadedly with @pad as the source pad. This function should push out
+ * data to the peer element. */
+static void
+gst_flutsbase_loop (GstPad * pad)
+{
+  GstFluTSBase *ts;
+  GstFlowReturn ret;
+  gboolean waited;
+
+  ts = GST_FLUTSBASE (GST_PAD_PARENT (pad));
+
+  /* have to lock for thread-safety */
+  FLOW_MUTEX_LOCK_CHECK (ts, ts->srcresult, out_flushing);
+
+  if (gst_flutsbase_is_trick_play (ts)) {
+    ret = gst_flutsbase_trick_pop (ts);
+    goto done;
+  }
+
+  gst_flutsbase_update_catch_up (ts);
+
+  for (waited = FALSE;; waited = TRUE) {
+    if (gst_flutsbase_passthrough_start (ts)) {
+      if (!g_queue_is_empty (&ts->passthrough_queue))
+        break;
+    } else if (!gst_shifter_cache_is_empty (ts->cache) || ts->is_eos) {
+      break;
+    }
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "empty, waiting for new data");
+    if (!waited)
+      COUNTERS_ADD (ts, underruns, 1);
+    /* Wait for data to be available, we could be unlocked because of a flush. */
+    FLOW_WAIT_ADD_CHECK (ts, ts->srcresult, out_flushing);
+  }
+  if (ts->passthrough)
+    ret = gst_flutsbase_passthrough_pop (ts);
+  else
+    ret = gst_flutsbase_pop (ts);
+
+done:
+  ts->srcresult = ret;
+  if (ret != GST_FLOW_OK)
+    goto out_flushing;
+
+  FLOW_MUTEX_UNLOCK (ts);
+
+  return;
+
+  /* ERRORS */
+out_flushing:
+  {
+    gboolean eos = ts->is_eos;
+    GstFlowReturn ret = ts->srcresult;
+
+    if (ts->seeking) {
+      /* the seek moves the cache from here instead of pausing the task, we
+       * continue at the new position right after */
+      if (ts->sinkresult == GST_FLOW_OK) {
+        GST_CAT_LOG_OBJECT (ts_flow, ts, "performing pending seek");
+        FLOW_MUTEX_UNLOCK (ts);
+        gst_pad_push_event (ts->srcpad, gst_event_new_flush_stop (TRUE));
+        FLOW_MUTEX_LOCK (ts);
+      }
+      /* upstream flushed or we are shutting down meanwhile */
+      if (ts->sinkresult == GST_FLOW_OK) {
+        gst_flutsbase_perform_seek (ts);
+        FLOW_MUTEX_UNLOCK (ts);
+        return;
+      }
+      GST_CAT_LOG_OBJECT (ts_flow, ts, "pending seek dropped");
+      ts->seeking = FALSE;
+    }
+
+    gst_flutsbase_loop_pause (ts);
+    FLOW_MUTEX_UNLOCK (ts);
     GST_CAT_LOG_OBJECT (ts_flow, ts,
         "pause task, reason:  %s", gst_flow_get_name (ts->srcresult));
     /* let app know about us giving up if upstream is not expected to do so */
@@ -337,11 +1214,37 @@ out_flushing:
   }
 }
 
+/* Starts or resumes the pushing loop, called with the flow lock */
+static gboolean
+gst_flutsbase_loop_start (GstFluTSBase * ts)
+{
+  return gst_pad_start_task (ts->srcpad, (GstTaskFunction) gst_flutsbase_loop,
+      ts->srcpad, NULL);
+}
+
+/* Pauses the pushing loop from the loop itself, called with the flow lock */
+static void
+gst_flutsbase_loop_pause (GstFluTSBase * ts)
+{
+  gst_pad_pause_task (ts->srcpad);
+}
+
+/* Pauses the pushing loop, or stops it when @deactivate, and waits until it
+ * returns. Called without the flow lock */
+static gboolean
+gst_flutsbase_loop_stop (GstFluTSBase * ts, gboolean deactivate)
+{
+  if (deactivate)
+    return gst_pad_stop_task (ts->srcpad);
+  return gst_pad_pause_task (ts->srcpad);
+}
+
+/* Checks if the sinkpad accepts more data, called with the flow lock */
 static GstFlowReturn
-gst_flutsbase_push (GstFluTSBase * ts, guint8 * data, gsize size)
+gst_flutsbase_accept_data (GstFluTSBase * ts)
 {
-  /* we have to lock since we span threads */
-  FLOW_MUTEX_LOCK_CHECK (ts, ts->sinkresult, out_flushing);
+  if (ts->sinkresult != GST_FLOW_OK)
+    goto out_flushing;
   /* when we received EOS, we refuse more data */
   if (ts->is_eos)
     goto out_eos;
@@ -349,10 +1252,123 @@ gst_flutsbase_push (GstFluTSBase * ts, guint8 * data, gsize size)
   if (ts->unexpected)
     goto out_unexpected;
 
-  /* add data to the cache */
-  gst_shifter_cache_push (ts->cache, data, size);
+  return GST_FLOW_OK;
+
+  /* special conditions */
+out_flushing:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts,
+        "exit because task paused, reason: %s",
+        gst_flow_get_name (ts->sinkresult));
+    return ts->sinkresult;
+  }
+out_eos:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we received EOS");
+    return GST_FLOW_EOS;
+  }
+out_unexpected:
+  {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we received UNEXPECTED");
+    return GST_FLOW_EOS;
+  }
+}
+
+/* Resizes the ring buffer to cache-size, or less when the window is
+ * smaller. The cache takes it as a cap and the memory manager can only lower
+ * it, so all the resizes go through here. Called with the flow lock */
+static gboolean
+gst_flutsbase_resize_cache (GstFluTSBase * ts)
+{
+  guint64 size = ts->cache_size;
+
+  if (ts->window_size)
+    size = MIN (size, ts->window_size);
+
+  return gst_shifter_cache_resize (ts->cache, size);
+}
+
+/* Sizes the cache to hold window-duration at the current bitrate. The disk
+ * keeps the window and the ring buffer never goes beyond cache-size, without
+ * a recording the window is limited to cache-size. Called with the flow
+ * lock */
+static void
+gst_flutsbase_update_window (GstFluTSBase * ts)
+{
+  GstFluTSBaseClass *klass = GST_FLUTSBASE_GET_CLASS (ts);
+  GstClockTime now;
+  guint64 bitrate, size;
+
+  if (G_LIKELY (!ts->window_duration) || !klass->get_bitrate)
+    return;
+
+  now = gst_util_get_timestamp ();
+  if (GST_CLOCK_TIME_IS_VALID (ts->window_update) &&
+      now < ts->window_update + WINDOW_UPDATE_INTERVAL)
+    return;
+  ts->window_update = now;
+
+  bitrate = klass->get_bitrate (ts);
+  if (!bitrate)
+    return;
+
+  size = gst_util_uint64_scale (bitrate, ts->window_duration, GST_SECOND);
+  size = MAX (GST_ROUND_UP_N (size, CACHE_SLOT_SIZE), DEFAULT_MIN_CACHE_SIZE);
+  if (size > ts->window_size - (ts->window_size >> WINDOW_UPDATE_SHIFT) &&
+      size < ts->window_size + (ts->window_size >> WINDOW_UPDATE_SHIFT))
+    return;
+
+  GST_INFO_OBJECT (ts, "%" G_GUINT64_FORMAT " bytes/s, %" G_GUINT64_FORMAT
+      " bytes for a window of %" GST_TIME_FORMAT, bitrate, size,
+      GST_TIME_ARGS (ts->window_duration));
+  ts->window_size = size;
+
+  if (ts->recording_template) {
+    gst_shifter_cache_set_disk_window (ts->cache, size);
+  } else if (size > ts->cache_size) {
+    GST_WARNING_OBJECT (ts, "no recording-template, the window is limited "
+        "to cache-size (%" G_GUINT64_FORMAT " bytes)", ts->cache_size);
+  }
+  gst_flutsbase_resize_cache (ts);
+}
+
+/* Tells the subclass when the oldest data leaves the cache, called with the
+ * flow lock */
+static void
+gst_flutsbase_update_first_offset (GstFluTSBase * ts)
+{
+  GstFluTSBaseClass *klass = GST_FLUTSBASE_GET_CLASS (ts);
+  guint64 rb_start, rb_stop, dk_start, dk_stop, first;
+
+  if (!klass->trim)
+    return;
+
+  if (gst_shifter_cache_get_ranges (ts->cache, &rb_start, &rb_stop, &dk_start,
+          &dk_stop))
+    first = MIN (rb_start, dk_start);
+  else
+    first = rb_start;
+  if (G_LIKELY (first == ts->first_offset))
+    return;
+
+  ts->first_offset = first;
+  klass->trim (ts, first);
+}
+
+/* Wakes up the pushing loop and posts the messages about the changes caused
+ * by the new data, called with the flow lock */
+static void
+gst_flutsbase_data_added (GstFluTSBase * ts)
+{
+  GstShifterCacheDiskState state;
+  guint64 free_space;
+
   FLOW_SIGNAL_ADD (ts);
 
+  gst_flutsbase_update_first_offset (ts);
+  gst_flutsbase_update_window (ts);
+  gst_flutsbase_update_buffering (ts);
+
   if (G_UNLIKELY (!ts->recording_started &&
           gst_shifter_cache_is_recording (ts->cache))) {
     gchar *filename = gst_shifter_cache_get_filename (ts->cache);
@@ -364,75 +1380,459 @@ gst_flutsbase_push (GstFluTSBase * ts, guint8 * data, gsize size)
     ts->recording_started = TRUE;
   }
 
-  FLOW_MUTEX_UNLOCK (ts);
+  state = gst_shifter_cache_get_disk_state (ts->cache, &free_space);
+  if (G_UNLIKELY (state != ts->disk_state)) {
+    GstStructure *stru = gst_structure_new ("shifter-disk-space",
+        "state", gst_flutsbase_disk_state_get_type (), state,
+        "free-space", G_TYPE_UINT64, free_space, NULL);
+
+    GST_INFO_OBJECT (ts, "disk state changed to %d, %" G_GUINT64_FORMAT
+        " bytes free", state, free_space);
+    gst_element_post_message (GST_ELEMENT_CAST (ts),
+        gst_message_new_element (GST_OBJECT (ts), stru));
+    ts->disk_state = state;
+  }
+}
+
+/* Adds @buffer to the cache and queues it for forwarding when in
+ * passthrough, called with the flow lock */
+static GstFlowReturn
+gst_flutsbase_add_buffer (GstFluTSBase * ts, GstBuffer * buffer)
+{
+  GstMapInfo map;
+  guint64 offset;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    goto map_failed;
+  offset = gst_shifter_cache_push (ts->cache, map.data, map.size);
+  gst_buffer_unmap (buffer, &map);
+  COUNTERS_BEGIN (ts);
+  ts->counters.bytes_in += map.size;
+  if (ts->ingest_offset == GST_BUFFER_OFFSET_NONE)
+    ts->ingest_offset = offset;
+  COUNTERS_END (ts);
+
+  if (!ts->passthrough)
+    return GST_FLOW_OK;
+
+  if (ts->passthrough_bytes + map.size > PASSTHROUGH_MAX_BYTES) {
+    GST_DEBUG_OBJECT (ts, "downstream is too slow for passthrough");
+    gst_flutsbase_passthrough_stop (ts);
+    return GST_FLOW_OK;
+  }
+
+  /* the memory is shared, only the metadata is copied */
+  buffer = gst_buffer_make_writable (gst_buffer_ref (buffer));
+  GST_BUFFER_OFFSET (buffer) = offset;
+  GST_BUFFER_OFFSET_END (buffer) = offset + map.size;
+  GST_BUFFER_PTS (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+  GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DISCONT);
+  g_queue_push_tail (&ts->passthrough_queue, buffer);
+  ts->passthrough_bytes += map.size;
 
   return GST_FLOW_OK;
 
-  /* special conditions */
-out_flushing:
+  /* ERRORS */
+map_failed:
   {
-    GstFlowReturn ret = ts->sinkresult;
+    GST_ELEMENT_ERROR (ts, RESOURCE, READ, (NULL),
+        ("could not map the input buffer"));
+    return GST_FLOW_ERROR;
+  }
+}
 
-    GST_CAT_LOG_OBJECT (ts_flow, ts,
-        "exit because task paused, reason: %s", gst_flow_get_name (ret));
-    FLOW_MUTEX_UNLOCK (ts);
-    return ret;
+static GstFlowReturn
+gst_flutsbase_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (parent);
+  GstFlowReturn res;
+  GstClockTime delay;
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts,
+      "received buffer %p of size %d, time %" GST_TIME_FORMAT ", duration %"
+      GST_TIME_FORMAT, buffer, gst_buffer_get_size (buffer),
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)),
+      GST_TIME_ARGS (GST_BUFFER_DURATION (buffer)));
+
+  /* we have to lock since we span threads */
+  FLOW_MUTEX_LOCK (ts);
+  COUNTERS_BEGIN (ts);
+  ts->ingest_offset = GST_BUFFER_OFFSET_NONE;
+  COUNTERS_END (ts);
+  res = gst_flutsbase_accept_data (ts);
+  if (res == GST_FLOW_OK) {
+    res = gst_flutsbase_add_buffer (ts, buffer);
+    gst_flutsbase_data_added (ts);
   }
-out_eos:
+  delay = gst_shifter_cache_take_write_delay (ts->cache);
+  FLOW_MUTEX_UNLOCK (ts);
+
+  /* keep to the write rate limit without stalling the pushing loop */
+  if (delay)
+    g_usleep (delay / GST_USECOND);
+
+  gst_buffer_unref (buffer);
+ 
+  return res;
+}
+
+/* Adds all the buffers of the list to the cache taking the flow lock and
+ * waking up the pushing loop only once */
+static GstFlowReturn
+gst_flutsbase_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (parent);
+  GstFlowReturn res;
+  GstClockTime delay;
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts, "received buffer list %p of %u buffers",
+      list, len);
+
+  FLOW_MUTEX_LOCK (ts);
+  COUNTERS_BEGIN (ts);
+  ts->ingest_offset = GST_BUFFER_OFFSET_NONE;
+  COUNTERS_END (ts);
+  res = gst_flutsbase_accept_data (ts);
+  if (res == GST_FLOW_OK) {
+    for (i = 0; i < len && res == GST_FLOW_OK; i++)
+      res = gst_flutsbase_add_buffer (ts, gst_buffer_list_get (list, i));
+    gst_flutsbase_data_added (ts);
+  }
+  delay = gst_shifter_cache_take_write_delay (ts->cache);
+  FLOW_MUTEX_UNLOCK (ts);
+
+  /* keep to the write rate limit without stalling the pushing loop */
+  if (delay)
+    g_usleep (delay / GST_USECOND);
+
+  gst_buffer_list_unref (list);
+
+  return res;
+}
+
+typedef struct
+{
+  GstFluTSBase *ts;
+  GstShifterCache *cache;
+  guint64 start;
+  guint64 stop;
+  gchar *location;
+  gint fd;
+} GstFluTSBaseExport;
+
+static void
+gst_flutsbase_export_done (GstFluTSBase * ts, guint64 start, guint64 stop,
+    gboolean success)
+{
+  GST_DEBUG_OBJECT (ts, "export of %" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT
+      " %s", start, stop, success ? "finished" : "failed");
+
+  gst_element_post_message (GST_ELEMENT_CAST (ts),
+      gst_message_new_element (GST_OBJECT (ts),
+          gst_structure_new ("shifter-export-finished",
+              "start", G_TYPE_UINT64, start,
+              "stop", G_TYPE_UINT64, stop,
+              "success", G_TYPE_BOOLEAN, success, NULL)));
+}
+
+static gpointer
+gst_flutsbase_export_thread (GstFluTSBaseExport * job)
+{
+  GstFluTSBase *ts = job->ts;
+  gboolean ret = FALSE;
+  gint fd = job->fd;
+
+  if (job->location) {
+    fd = g_open (job->location, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      GST_WARNING_OBJECT (ts, "could not open export file \"%s\": %s",
+          job->location, g_strerror (errno));
+      goto done;
+    }
+  }
+
+  ret = gst_shifter_cache_export (job->cache, job->start, job->stop, fd);
+
+  if (job->location)
+    close (fd);
+
+done:
+  gst_flutsbase_export_done (ts, job->start, job->stop, ret);
+
+  gst_shifter_cache_unref (job->cache);
+  gst_object_unref (ts);
+  g_free (job->location);
+  g_slice_free (GstFluTSBaseExport, job);
+
+  return NULL;
+}
+
+/* Writes the requested byte range of the cache to a file. The structure
+ * carries "start" and "stop" byte offsets and either a "location" to create
+ * or an already opened "fd", which must stay open until the
+ * "shifter-export-finished" message is posted. The copy runs on its own
+ * thread so neither the sender of the event nor the streaming threads wait
+ * for it. */
+static gboolean
+gst_flutsbase_export (GstFluTSBase * ts, const GstStructure * stru)
+{
+  GstFluTSBaseExport *job;
+  GstShifterCache *cache = NULL;
+  guint64 start = 0, stop = G_MAXUINT64;
+  const gchar *location;
+  gint fd = -1;
+  GError *error = NULL;
+
+  gst_structure_get_uint64 (stru, "start", &start);
+  gst_structure_get_uint64 (stru, "stop", &stop);
+  location = gst_structure_get_string (stru, "location");
+
+  if (!location && (!gst_structure_get_int (stru, "fd", &fd) || fd < 0))
+    goto no_target;
+
+  FLOW_MUTEX_LOCK (ts);
+  if (ts->cache)
+    cache = gst_shifter_cache_ref (ts->cache);
+  FLOW_MUTEX_UNLOCK (ts);
+
+  if (cache == NULL)
+    goto no_cache;
+
+  job = g_slice_new0 (GstFluTSBaseExport);
+  job->ts = gst_object_ref (ts);
+  job->cache = cache;
+  job->start = start;
+  job->stop = stop;
+  job->location = g_strdup (location);
+  job->fd = fd;
+
+  if (!g_thread_create ((GThreadFunc) gst_flutsbase_export_thread, job,
+          FALSE, &error))
+    goto no_thread;
+
+  return TRUE;
+
+  /* ERRORS */
+no_target:
   {
-    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we received EOS");
+    GST_WARNING_OBJECT (ts, "export event without location or fd");
+    return FALSE;
+  }
+no_cache:
+  {
+    gst_flutsbase_export_done (ts, start, stop, FALSE);
+    return FALSE;
+  }
+no_thread:
+  {
+    GST_WARNING_OBJECT (ts, "could not create export thread: %s",
+        error->message);
+    g_error_free (error);
+    gst_flutsbase_export_done (ts, start, stop, FALSE);
+    gst_shifter_cache_unref (job->cache);
+    gst_object_unref (job->ts);
+    g_free (job->location);
+    g_slice_free (GstFluTSBaseExport, job);
+    return FALSE;
+  }
+}
+
+static gboolean
+gst_flutsbase_handle_custom_upstream (GstFluTSBase * ts, GstEvent * event)
+{
+  gboolean ret = FALSE;
+  const GstStructure *stru;
+
+  stru = gst_event_get_structure (event);
+  if (stru && gst_structure_has_name (stru, "shifter-start-recording")) {
+    if (GST_STATE (ts) < GST_STATE_PAUSED) {
+      GST_DEBUG_OBJECT (ts, "Received event while not in PAUSED/PLAYING state");
+      goto beach;
+    }
+    FLOW_MUTEX_LOCK (ts);
+    ret = gst_shifter_cache_start_recording (ts->cache);
     FLOW_MUTEX_UNLOCK (ts);
-    return GST_FLOW_EOS;
+  } else if (stru && gst_structure_has_name (stru, "shifter-export")) {
+    if (GST_STATE (ts) < GST_STATE_PAUSED) {
+      GST_DEBUG_OBJECT (ts, "Received event while not in PAUSED/PLAYING state");
+      goto beach;
+    }
+    ret = gst_flutsbase_export (ts, stru);
   }
-out_unexpected:
+
+beach:
+  return ret;
+}
+
+/* Pushes the STREAM_START and SEGMENT events due on a request pad before
+ * the buffer at @offset, called with the flow lock */
+static gboolean
+gst_flutsbase_output_push_pending_events (GstFluTSBaseOutput * out,
+    guint64 offset)
+{
+  GstEvent *event;
+
+  if (G_LIKELY (!out->need_newsegment))
+    return TRUE;
+
+  event = gst_pad_get_sticky_event (out->ts->sinkpad, GST_EVENT_STREAM_START,
+      0);
+  if (event && !gst_pad_push_event (out->pad, event)) {
+    GST_CAT_LOG_OBJECT (ts_flow, out->ts, "push of STREAM_START event failed");
+    return FALSE;
+  }
+
+  /* in bytes the stream time is the position we (re)started from, the
+   * stop is the one of the last seek */
+  out->segment.start = offset;
+  out->segment.time = offset;
+  out->segment.position = offset;
+  out->segment.flags |= GST_SEGMENT_FLAG_RESET;
+
+  GST_DEBUG_OBJECT (out->pad, "pushing segment %" GST_SEGMENT_FORMAT,
+      &out->segment);
+
+  if (!gst_pad_push_event (out->pad, gst_event_new_segment (&out->segment))) {
+    GST_CAT_LOG_OBJECT (ts_flow, out->ts, "push of SEGMENT event failed");
+    return FALSE;
+  }
+  out->need_newsegment = FALSE;
+
+  return TRUE;
+}
+
+/* Pushing loop of a request pad, it reads the cache with its own cursor
+ * and never modifies the cache */
+static void
+gst_flutsbase_output_loop (GstPad * pad)
+{
+  GstFluTSBaseOutput *out = gst_pad_get_element_private (pad);
+  GstFluTSBase *ts = out->ts;
+  GstBuffer *buffer;
+  GstFlowReturn ret;
+
+  FLOW_MUTEX_LOCK_CHECK (ts, out->srcresult, out_flushing);
+
+  for (;;) {
+    /* released meanwhile */
+    if (G_UNLIKELY (out->cursor == NULL)) {
+      out->srcresult = GST_FLOW_FLUSHING;
+      goto out_flushing;
+    }
+    buffer = gst_shifter_cache_cursor_read (ts->cache, out->cursor,
+        CACHE_SLOT_SIZE);
+    if (buffer)
+      break;
+    if (ts->is_eos) {
+      out->srcresult = GST_FLOW_EOS;
+      goto out_flushing;
+    }
+    FLOW_WAIT_ADD_CHECK (ts, out->srcresult, out_flushing);
+  }
+
+  if (!gst_flutsbase_output_push_pending_events (out,
+          GST_BUFFER_OFFSET (buffer))) {
+    gst_buffer_unref (buffer);
+    out->srcresult = GST_FLOW_FLUSHING;
+    goto out_flushing;
+  }
+  FLOW_MUTEX_UNLOCK (ts);
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts, "pushing buffer %p of size %d on %s:%s",
+      buffer, gst_buffer_get_size (buffer), GST_DEBUG_PAD_NAME (pad));
+
+  ret = gst_pad_push (pad, buffer);
+
+  FLOW_MUTEX_LOCK (ts);
+  /* don't overwrite a flush that happened during the push */
+  if (out->srcresult == GST_FLOW_OK)
+    out->srcresult = ret;
+  if (out->srcresult != GST_FLOW_OK)
+    goto out_flushing;
+  FLOW_MUTEX_UNLOCK (ts);
+
+  return;
+
+  /* ERRORS */
+out_flushing:
   {
-    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we received UNEXPECTED");
+    GstFlowReturn ret = out->srcresult;
+
+    gst_pad_pause_task (pad);
     FLOW_MUTEX_UNLOCK (ts);
-    return GST_FLOW_EOS;
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "pause task of %s:%s, reason: %s",
+        GST_DEBUG_PAD_NAME (pad), gst_flow_get_name (ret));
+    if (ret == GST_FLOW_EOS) {
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GST_ELEMENT_ERROR (ts, STREAM, FAILED,
+          ("Internal data flow error."),
+          ("streaming task paused, reason %s (%d)",
+              gst_flow_get_name (ret), ret));
+      gst_pad_push_event (pad, gst_event_new_eos ());
+    }
+    return;
   }
 }
 
-static GstFlowReturn
-gst_flutsbase_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+static void
+gst_flutsbase_output_flush_start (GstFluTSBaseOutput * out)
 {
-  GstFluTSBase *ts = GST_FLUTSBASE (parent);
-  GstFlowReturn res;
-  GstMapInfo map;
+  GstFluTSBase *ts = out->ts;
 
-  GST_CAT_LOG_OBJECT (ts_flow, ts,
-      "received buffer %p of size %d, time %" GST_TIME_FORMAT ", duration %"
-      GST_TIME_FORMAT, buffer, gst_buffer_get_size (buffer),
-      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)),
-      GST_TIME_ARGS (GST_BUFFER_DURATION (buffer)));
+  gst_pad_push_event (out->pad, gst_event_new_flush_start ());
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  res = gst_flutsbase_push (ts, map.data, map.size);
-  gst_buffer_unmap (buffer, &map);
+  FLOW_MUTEX_LOCK (ts);
+  out->srcresult = GST_FLOW_FLUSHING;
+  FLOW_SIGNAL_ADD (ts);
+  FLOW_MUTEX_UNLOCK (ts);
 
-  gst_buffer_unref (buffer);
- 
-  return res;
+  gst_pad_pause_task (out->pad);
 }
 
-static gboolean
-gst_flutsbase_handle_custom_upstream (GstFluTSBase * ts, GstEvent * event)
+static void
+gst_flutsbase_output_flush_stop (GstFluTSBaseOutput * out)
 {
-  gboolean ret = FALSE;
-  const GstStructure *stru;
+  GstFluTSBase *ts = out->ts;
 
-  stru = gst_event_get_structure (event);
-  if (stru && gst_structure_has_name (stru, "shifter-start-recording")) {
-    if (GST_STATE (ts) < GST_STATE_PAUSED) {
-      GST_DEBUG_OBJECT (ts, "Received event while not in PAUSED/PLAYING state");
-      goto beach;
-    }
-    FLOW_MUTEX_LOCK (ts);
-    ret = gst_shifter_cache_start_recording (ts->cache);
-    FLOW_MUTEX_UNLOCK (ts);
+  gst_pad_push_event (out->pad, gst_event_new_flush_stop (TRUE));
+
+  FLOW_MUTEX_LOCK (ts);
+  out->srcresult = GST_FLOW_OK;
+  out->need_newsegment = TRUE;
+  if (GST_PAD_IS_ACTIVE (out->pad))
+    gst_pad_start_task (out->pad, (GstTaskFunction) gst_flutsbase_output_loop,
+        out->pad, NULL);
+  FLOW_MUTEX_UNLOCK (ts);
+}
+
+/* Calls @func on every request pad without the flow lock, the pads are kept
+ * alive meanwhile */
+static void
+gst_flutsbase_foreach_output (GstFluTSBase * ts,
+    void (*func) (GstFluTSBaseOutput * out))
+{
+  GList *pads = NULL, *walk;
+
+  FLOW_MUTEX_LOCK (ts);
+  for (walk = ts->outputs; walk; walk = g_list_next (walk)) {
+    GstFluTSBaseOutput *out = walk->data;
+    pads = g_list_prepend (pads, gst_object_ref (out->pad));
   }
+  FLOW_MUTEX_UNLOCK (ts);
 
-beach:
-  return ret;
+  for (walk = pads; walk; walk = g_list_next (walk)) {
+    GstPad *pad = walk->data;
+    func (gst_pad_get_element_private (pad));
+    gst_object_unref (pad);
+  }
+  g_list_free (pads);
 }
 
 static inline gboolean
@@ -447,6 +1847,9 @@ gst_flutsbase_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       GST_CAT_LOG_OBJECT (ts_flow, ts, "received eos event");
       FLOW_MUTEX_LOCK (ts);
       ts->is_eos = TRUE;
+      /* the cache has everything that was not forwarded yet */
+      gst_flutsbase_passthrough_stop (ts);
+      gst_flutsbase_update_buffering (ts);
       /* Ensure to unlock the pushing loop */
       FLOW_SIGNAL_ADD (ts);
       FLOW_MUTEX_UNLOCK (ts);
@@ -472,14 +1875,18 @@ gst_flutsbase_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       FLOW_MUTEX_LOCK (ts);
       ts->srcresult = GST_FLOW_FLUSHING;
       ts->sinkresult = GST_FLOW_FLUSHING;
+      gst_flutsbase_passthrough_stop (ts);
+      gst_flutsbase_pace_reset (ts);
       /* unblock the loop and chain functions */
       FLOW_SIGNAL_ADD (ts);
       FLOW_MUTEX_UNLOCK (ts);
 
       /* make sure it pauses, this should happen since we sent
        * flush_start downstream. */
-      gst_pad_pause_task (ts->srcpad);
+      gst_flutsbase_loop_stop (ts, FALSE);
       GST_CAT_LOG_OBJECT (ts_flow, ts, "loop stopped");
+
+      gst_flutsbase_foreach_output (ts, gst_flutsbase_output_flush_start);
       break;
     }
     case GST_EVENT_FLUSH_STOP:
@@ -498,9 +1905,11 @@ gst_flutsbase_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       ts->sinkresult = GST_FLOW_OK;
       ts->is_eos = FALSE;
       ts->unexpected = FALSE;
-      gst_pad_start_task (ts->srcpad, (GstTaskFunction) gst_flutsbase_loop,
-          ts->srcpad, NULL);
+      if (GST_PAD_MODE (ts->srcpad) == GST_PAD_MODE_PUSH)
+        gst_flutsbase_loop_start (ts);
       FLOW_MUTEX_UNLOCK (ts);
+
+      gst_flutsbase_foreach_output (ts, gst_flutsbase_output_flush_stop);
       break;
     }
     case GST_EVENT_STREAM_START:
@@ -546,6 +1955,20 @@ gst_flutsbase_get_bytes_offset(GstFluTSBase * ts, GstFormat format,
   return offset;
 }
 
+static gboolean
+gst_flutsbase_task_is_started (GstFluTSBase * ts)
+{
+  GstTask *task;
+  gboolean started;
+
+  GST_OBJECT_LOCK (ts->srcpad);
+  task = GST_PAD_TASK (ts->srcpad);
+  started = task && gst_task_get_state (task) == GST_TASK_STARTED;
+  GST_OBJECT_UNLOCK (ts->srcpad);
+
+  return started;
+}
+
 static gboolean
 gst_flutsbase_handle_seek (GstFluTSBase * ts, GstEvent * event)
 {
@@ -554,7 +1977,7 @@ gst_flutsbase_handle_seek (GstFluTSBase * ts, GstEvent * event)
   GstSeekType start_type, stop_type;
   gint64 start, stop;
   gdouble rate;
-  guint64 offset = 0;
+  guint64 offset = 0, stop_offset = -1;
   gboolean ret = FALSE;
 
   gst_event_parse_seek (event, &rate, &format, &flags,
@@ -565,48 +1988,76 @@ gst_flutsbase_handle_seek (GstFluTSBase * ts, GstEvent * event)
     goto beach;
   }
 
-  offset = gst_flutsbase_get_bytes_offset(ts, format, start_type, start);
+  if (rate < 0.0 && stop_type != GST_SEEK_TYPE_NONE) {
+    /* backwards playback starts at the stop position */
+    offset = gst_flutsbase_get_bytes_offset (ts, format, stop_type, stop);
+  } else {
+    offset = gst_flutsbase_get_bytes_offset (ts, format, start_type, start);
+    if (stop_type != GST_SEEK_TYPE_NONE)
+      stop_offset = gst_flutsbase_get_bytes_offset (ts, format, stop_type,
+          stop);
+  }
   if (G_UNLIKELY (offset == (guint64) -1 || !gst_shifter_cache_has_offset (ts->cache, offset))) {
     GST_WARNING_OBJECT (ts, "seek failed");
     goto beach;
   }
-
-  /* remember the rate */
-  ts->segment.rate = rate;
-  ts->segment.flags |= GST_SEGMENT_FLAG_RESET;
+  if (G_UNLIKELY (stop_offset != (guint64) -1 && stop_offset < offset)) {
+    GST_WARNING_OBJECT (ts, "seek stop %" G_GUINT64_FORMAT " before start %"
+        G_GUINT64_FORMAT, stop_offset, offset);
+    goto beach;
+  }
 
   GST_DEBUG_OBJECT (ts, "seeking at offset %" G_GUINT64_FORMAT, offset);
 
-  /* now unblock the loop function */
   FLOW_MUTEX_LOCK (ts);
+  /* keep the whole request, a pending seek is replaced by this one */
+  ts->seek_offset = offset;
+  ts->seek_stop = stop_offset;
+  ts->seek_rate = rate;
+  ts->seek_flags = flags;
+  if (ts->seeking) {
+    GST_DEBUG_OBJECT (ts, "seek coalesced with the pending one");
+    FLOW_MUTEX_UNLOCK (ts);
+    ret = TRUE;
+    goto beach;
+  }
+  ts->seek_time = gst_util_get_timestamp ();
+  COUNTERS_ADD (ts, seeks, 1);
+
   /* Flush start downstream to make sure loop is idle */
   gst_pad_push_event (ts->srcpad, gst_event_new_flush_start ());
   ts->srcresult = GST_FLOW_FLUSHING;
+  ts->seeking = TRUE;
+  gst_flutsbase_passthrough_stop (ts);
+  gst_flutsbase_pace_reset (ts);
   /* unblock the loop function */
   FLOW_SIGNAL_ADD (ts);
+
+  if (gst_flutsbase_task_is_started (ts)) {
+    /* the running loop performs the seek as soon as it sees the flushing,
+     * with the latest parameters requested until then. We don't have to
+     * wait for it nor pause and restart the task */
+    FLOW_MUTEX_UNLOCK (ts);
+    ret = TRUE;
+    goto beach;
+  }
   FLOW_MUTEX_UNLOCK (ts);
 
-  /* make sure it pauses, this should happen since we sent
-   * flush_start downstream. */
-  gst_pad_pause_task (ts->srcpad);
+  /* the task paused itself, on EOS or an error, wait until the loop
+   * function returns */
+  gst_flutsbase_loop_stop (ts, FALSE);
   GST_DEBUG_OBJECT (ts, "loop stopped");
+
   /* Flush stop downstream to ensure that all pushed cache slots come back
    * to our control */
   gst_pad_push_event (ts->srcpad, gst_event_new_flush_stop (TRUE));
 
-  /* Reconfigure the cache to handle the new offset */
   FLOW_MUTEX_LOCK (ts);
-  gst_shifter_cache_seek (ts->cache, offset);
-
-  /* Restart the pushing loop */
-  ts->srcresult = GST_FLOW_OK;
-  ts->is_eos = FALSE;
-  ts->unexpected = FALSE;
-  ts->need_newsegment = TRUE;
-  gst_pad_start_task (ts->srcpad, (GstTaskFunction) gst_flutsbase_loop,
-      ts->srcpad, NULL);
+  gst_flutsbase_perform_seek (ts);
+  gst_flutsbase_loop_start (ts);
+  FLOW_SIGNAL_ADD (ts);
   FLOW_MUTEX_UNLOCK (ts);
-  GST_DEBUG_OBJECT (ts, "loop started");
+  GST_DEBUG_OBJECT (ts, "loop resumed");
   ret = TRUE;
 beach:
   return ret;
@@ -627,6 +2078,11 @@ gst_flutsbase_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
     case GST_EVENT_SEEK:
     {
       GST_CAT_LOG_OBJECT (ts_flow, ts, "received seek event");
+      /* downstream reads where it wants in pull mode */
+      if (GST_PAD_MODE (pad) != GST_PAD_MODE_PUSH) {
+        ret = FALSE;
+        break;
+      }
       /* Do the seek ourself now */
       ret = gst_flutsbase_handle_seek (ts, event);
       break;
@@ -647,85 +2103,379 @@ gst_flutsbase_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
       break;
   }
 
-  gst_event_unref (event);
+  gst_event_unref (event);
+
+  return ret;
+}
+
+/* Adds the union of the byte ranges [@a_start, @a_stop) and
+ * [@b_start, @b_stop) to @query, in order */
+static void
+gst_flutsbase_add_buffering_ranges (GstQuery * query, guint64 a_start,
+    guint64 a_stop, guint64 b_start, guint64 b_stop)
+{
+  if (b_start < a_start) {
+    guint64 tmp;
+
+    tmp = a_start, a_start = b_start, b_start = tmp;
+    tmp = a_stop, a_stop = b_stop, b_stop = tmp;
+  }
+  if (b_start <= a_stop) {
+    gst_query_add_buffering_range (query, a_start, MAX (a_stop, b_stop));
+  } else {
+    gst_query_add_buffering_range (query, a_start, a_stop);
+    gst_query_add_buffering_range (query, b_start, b_stop);
+  }
+}
+
+/* Answers with the data held in memory and on the disk. The ranges are the
+ * union of both, the ranges of each are in the ring-start, ring-stop,
+ * disk-start and disk-stop fields. */
+static gboolean
+gst_flutsbase_query_buffering (GstFluTSBase * ts, GstQuery * query)
+{
+  GstStructure *s;
+  GstFormat format;
+  guint64 rb_start, rb_stop, dk_start = 0, dk_stop = 0;
+  gboolean on_disk, busy;
+  gint percent;
+
+  gst_query_parse_buffering_range (query, &format, NULL, NULL, NULL);
+  if (format != GST_FORMAT_BYTES)
+    return FALSE;
+
+  FLOW_MUTEX_LOCK (ts);
+  if (!ts->cache) {
+    FLOW_MUTEX_UNLOCK (ts);
+    return FALSE;
+  }
+  on_disk = gst_shifter_cache_get_ranges (ts->cache, &rb_start, &rb_stop,
+      &dk_start, &dk_stop);
+  if (ts->use_buffering) {
+    busy = ts->buffering;
+    percent = ts->buffering ? ts->buffering_percent : 100;
+  } else {
+    busy = FALSE;
+    percent = gst_flutsbase_ring_percent (ts);
+  }
+  FLOW_MUTEX_UNLOCK (ts);
+
+  if (!on_disk)
+    dk_start = dk_stop = rb_start;
+
+  gst_query_set_buffering_percent (query, busy, percent);
+  gst_query_set_buffering_stats (query, GST_BUFFERING_TIMESHIFT, -1, -1, -1);
+  gst_query_set_buffering_range (query, GST_FORMAT_BYTES,
+      MIN (rb_start, dk_start), MAX (rb_stop, dk_stop), -1);
+  gst_flutsbase_add_buffering_ranges (query, rb_start, rb_stop, dk_start,
+      dk_stop);
+
+  s = gst_query_writable_structure (query);
+  gst_structure_set (s, "ring-start", G_TYPE_UINT64, rb_start,
+      "ring-stop", G_TYPE_UINT64, rb_stop, NULL);
+  if (on_disk) {
+    gst_structure_set (s, "disk-start", G_TYPE_UINT64, dk_start,
+        "disk-stop", G_TYPE_UINT64, dk_stop, NULL);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_flutsbase_query (GstElement * element, GstQuery * query)
+{
+  gboolean ret = TRUE;
+  GstFluTSBase * ts = GST_FLUTSBASE (element);
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_POSITION:
+    {
+      gint64 pos = -1;
+      GstFormat format;
+
+      /* get format */
+      gst_query_parse_position (query, &format, NULL);
+
+      switch (format) {
+        case GST_FORMAT_BYTES:
+          pos = ts->cur_bytes;
+          break;
+        default:
+          GST_WARNING_OBJECT (ts, "dropping query in %s format, don't "
+              "know how to handle", gst_format_get_name (format));
+          ret = FALSE;
+          break;
+      }
+      /* set updated position */
+      if (ret)
+        gst_query_set_position (query, format, pos);
+      break;
+    }
+    case GST_QUERY_DURATION:
+    {
+      GstFormat format;
+
+      gst_query_parse_duration (query, &format, NULL);
+
+      if (format == GST_FORMAT_BYTES) {
+        GST_LOG_OBJECT (ts, "replying duration query with %" G_GUINT64_FORMAT,
+            gst_shifter_cache_get_total_bytes_received(ts->cache));
+        gst_query_set_duration (query, GST_FORMAT_BYTES, 
+            gst_shifter_cache_get_total_bytes_received(ts->cache));
+        ret = TRUE;
+      }
+      else {
+        ret = FALSE;
+      }
+      break;
+    }
+    case GST_QUERY_SEEKING:
+    {
+      GstFormat fmt;
+
+      gst_query_parse_seeking (query, &fmt, NULL, NULL, NULL);
+      if (fmt == GST_FORMAT_BYTES) {
+        gst_query_set_seeking (query, fmt, TRUE, 0, -1);
+        ret = TRUE;
+      }
+      else {
+        ret = FALSE;
+      }
+      break;
+    }
+    case GST_QUERY_LATENCY:
+    {
+      gst_query_set_latency (query, FALSE, 0, -1);
+      break;
+    }
+    case GST_QUERY_BUFFERING:
+      ret = gst_flutsbase_query_buffering (ts, query);
+      break;
+
+    default:
+      ret = FALSE;
+      break;
+  }
+
+  return ret;
+}
+
+/* Moves the cursor of a request pad, only flushing seeks forward */
+static gboolean
+gst_flutsbase_output_handle_seek (GstFluTSBaseOutput * out, GstEvent * event)
+{
+  GstFluTSBase *ts = out->ts;
+  GstFormat format;
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  gint64 start, stop;
+  gdouble rate;
+  guint64 offset, stop_offset = -1;
+  gboolean flush;
+
+  gst_event_parse_seek (event, &rate, &format, &flags,
+      &start_type, &start, &stop_type, &stop);
+
+  /* the cursors only read forward, time seeks are converted to bytes by
+   * the seeker in front of the pad */
+  if (rate <= 0.0) {
+    GST_WARNING_OBJECT (out->pad, "we only support forward seeks");
+    return FALSE;
+  }
+
+  offset = gst_flutsbase_get_bytes_offset (ts, format, start_type, start);
+  if (G_UNLIKELY (offset == (guint64) -1 ||
+          !gst_shifter_cache_has_offset (ts->cache, offset))) {
+    GST_WARNING_OBJECT (out->pad, "seek failed");
+    return FALSE;
+  }
+  if (stop_type != GST_SEEK_TYPE_NONE)
+    stop_offset = gst_flutsbase_get_bytes_offset (ts, format, stop_type,
+        stop);
+  if (G_UNLIKELY (stop_offset != (guint64) -1 && stop_offset < offset)) {
+    GST_WARNING_OBJECT (out->pad, "seek stop before start");
+    return FALSE;
+  }
+
+  GST_DEBUG_OBJECT (out->pad, "seeking at offset %" G_GUINT64_FORMAT, offset);
+
+  flush = (flags & GST_SEEK_FLAG_FLUSH) != 0;
+  if (flush)
+    gst_flutsbase_output_flush_start (out);
+
+  FLOW_MUTEX_LOCK (ts);
+  if (out->cursor)
+    gst_shifter_cache_cursor_seek (ts->cache, out->cursor, offset);
+  out->segment.rate = rate;
+  out->segment.stop = stop_offset;
+  if (!flush) {
+    /* the loop continues from the new position after the buffer it is
+     * pushing, with a new segment */
+    out->need_newsegment = TRUE;
+    if (out->srcresult == GST_FLOW_EOS) {
+      out->srcresult = GST_FLOW_OK;
+      if (GST_PAD_IS_ACTIVE (out->pad))
+        gst_pad_start_task (out->pad,
+            (GstTaskFunction) gst_flutsbase_output_loop, out->pad, NULL);
+    }
+    FLOW_SIGNAL_ADD (ts);
+  }
+  FLOW_MUTEX_UNLOCK (ts);
+
+  if (flush)
+    gst_flutsbase_output_flush_stop (out);
+
+  return TRUE;
+}
+
+static gboolean
+gst_flutsbase_output_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstFluTSBaseOutput *out = gst_pad_get_element_private (pad);
+  gboolean ret = FALSE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      ret = gst_flutsbase_output_handle_seek (out, event);
+      break;
+    default:
+      GST_CAT_LOG_OBJECT (ts_flow, out->ts, "dropped event %s",
+          GST_EVENT_TYPE_NAME (event));
+      break;
+  }
+
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+gst_flutsbase_output_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstFluTSBaseOutput *out = gst_pad_get_element_private (pad);
+  GstFormat format;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_SCHEDULING:
+      gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PUSH);
+      return TRUE;
+    case GST_QUERY_POSITION:
+      gst_query_parse_position (query, &format, NULL);
+      if (format != GST_FORMAT_BYTES)
+        return FALSE;
+      FLOW_MUTEX_LOCK (out->ts);
+      gst_query_set_position (query, format,
+          out->cursor ? out->cursor->offset : 0);
+      FLOW_MUTEX_UNLOCK (out->ts);
+      return TRUE;
+    default:
+      return gst_flutsbase_query (GST_ELEMENT (parent), query);
+  }
+}
+
+static gboolean
+gst_flutsbase_output_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstFluTSBaseOutput *out = gst_pad_get_element_private (pad);
+  GstFluTSBase *ts = out->ts;
+  gboolean ret;
+
+  if (mode != GST_PAD_MODE_PUSH)
+    return FALSE;
+
+  if (active) {
+    FLOW_MUTEX_LOCK (ts);
+    GST_DEBUG_OBJECT (pad, "activating push mode");
+    out->srcresult = GST_FLOW_OK;
+    out->need_newsegment = TRUE;
+    ret = gst_pad_start_task (pad,
+        (GstTaskFunction) gst_flutsbase_output_loop, pad, NULL);
+    FLOW_MUTEX_UNLOCK (ts);
+  } else {
+    FLOW_MUTEX_LOCK (ts);
+    GST_DEBUG_OBJECT (pad, "deactivating push mode");
+    out->srcresult = GST_FLOW_FLUSHING;
+    FLOW_SIGNAL_ADD (ts);
+    FLOW_MUTEX_UNLOCK (ts);
+
+    ret = gst_pad_stop_task (pad);
+  }
 
   return ret;
 }
 
-static gboolean
-gst_flutsbase_query (GstElement * element, GstQuery * query)
+static GstPad *
+gst_flutsbase_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
 {
-  gboolean ret = TRUE;
-  GstFluTSBase * ts = GST_FLUTSBASE (element);
+  GstFluTSBase *ts = GST_FLUTSBASE (element);
+  GstFluTSBaseOutput *out;
+  gchar *padname;
 
-  switch (GST_QUERY_TYPE (query)) {
-    case GST_QUERY_POSITION:
-    {
-      gint64 pos = -1;
-      GstFormat format;
+  out = g_new0 (GstFluTSBaseOutput, 1);
+  out->ts = ts;
+  out->srcresult = GST_FLOW_FLUSHING;
+  out->need_newsegment = TRUE;
+  gst_segment_init (&out->segment, GST_FORMAT_BYTES);
 
-      /* get format */
-      gst_query_parse_position (query, &format, NULL);
+  FLOW_MUTEX_LOCK (ts);
+  if (name)
+    padname = g_strdup (name);
+  else
+    padname = g_strdup_printf ("src_%u", ts->output_count);
+  ts->output_count++;
+
+  out->pad = gst_pad_new_from_template (templ, padname);
+  g_free (padname);
+  /* the output lives as long as its pad */
+  gst_pad_set_element_private (out->pad, out);
+  g_object_set_data_full (G_OBJECT (out->pad), "flutsbase-output", out,
+      g_free);
+  gst_pad_set_activatemode_function (out->pad,
+      GST_DEBUG_FUNCPTR (gst_flutsbase_output_activate_mode));
+  gst_pad_set_event_function (out->pad,
+      GST_DEBUG_FUNCPTR (gst_flutsbase_output_src_event));
+  gst_pad_set_query_function (out->pad,
+      GST_DEBUG_FUNCPTR (gst_flutsbase_output_src_query));
+
+  /* new outputs start at the live edge */
+  if (ts->cache)
+    out->cursor = gst_shifter_cache_cursor_new (ts->cache,
+        gst_shifter_cache_get_total_bytes_received (ts->cache));
+  ts->outputs = g_list_append (ts->outputs, out);
+  FLOW_MUTEX_UNLOCK (ts);
 
-      switch (format) {
-        case GST_FORMAT_BYTES:
-          pos = ts->cur_bytes;
-          break;
-        default:
-          GST_WARNING_OBJECT (ts, "dropping query in %s format, don't "
-              "know how to handle", gst_format_get_name (format));
-          ret = FALSE;
-          break;
-      }
-      /* set updated position */
-      if (ret)
-        gst_query_set_position (query, format, pos);
-      break;
-    }
-    case GST_QUERY_DURATION:
-    {
-      GstFormat format;
+  GST_DEBUG_OBJECT (ts, "new output %s:%s", GST_DEBUG_PAD_NAME (out->pad));
 
-      gst_query_parse_duration (query, &format, NULL);
+  gst_element_add_pad (element, out->pad);
 
-      if (format == GST_FORMAT_BYTES) {
-        GST_LOG_OBJECT (ts, "replying duration query with %" G_GUINT64_FORMAT,
-            gst_shifter_cache_get_total_bytes_received(ts->cache));
-        gst_query_set_duration (query, GST_FORMAT_BYTES, 
-            gst_shifter_cache_get_total_bytes_received(ts->cache));
-        ret = TRUE;
-      }
-      else {
-        ret = FALSE;
-      }
-      break;
-    }
-    case GST_QUERY_SEEKING:
-    {
-      GstFormat fmt;
+  return out->pad;
+}
 
-      gst_query_parse_seeking (query, &fmt, NULL, NULL, NULL);
-      if (fmt == GST_FORMAT_BYTES) {
-        gst_query_set_seeking (query, fmt, TRUE, 0, -1);
-        ret = TRUE;
-      }
-      else {
-        ret = FALSE;
-      }
-      break;
-    }
-    case GST_QUERY_LATENCY:
-    {
-      gst_query_set_latency (query, FALSE, 0, -1);
-      break;
-    }
+static void
+gst_flutsbase_release_pad (GstElement * element, GstPad * pad)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (element);
+  GstFluTSBaseOutput *out = gst_pad_get_element_private (pad);
 
-    default:
-      ret = FALSE;
-      break;
-  }
+  GST_DEBUG_OBJECT (ts, "releasing output %s:%s", GST_DEBUG_PAD_NAME (pad));
 
-  return ret;
+  /* its data can be reused right away */
+  FLOW_MUTEX_LOCK (ts);
+  ts->outputs = g_list_remove (ts->outputs, out);
+  if (ts->cache && out->cursor)
+    gst_shifter_cache_cursor_free (ts->cache, out->cursor);
+  out->cursor = NULL;
+  out->srcresult = GST_FLOW_FLUSHING;
+  FLOW_SIGNAL_ADD (ts);
+  FLOW_MUTEX_UNLOCK (ts);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
 }
 
 /* sink currently only operates in push mode */
@@ -770,7 +2520,7 @@ gst_flutsbase_src_activate (GstPad * pad, GstObject * parent, gboolean active)
     ts->sinkresult = GST_FLOW_OK;
     ts->is_eos = FALSE;
     ts->unexpected = FALSE;
-    ret = gst_pad_start_task (pad, (GstTaskFunction) gst_flutsbase_loop, pad, NULL);
+    ret = gst_flutsbase_loop_start (ts);
     FLOW_MUTEX_UNLOCK (ts);
   } else {
     /* unblock loop function */
@@ -778,17 +2528,98 @@ gst_flutsbase_src_activate (GstPad * pad, GstObject * parent, gboolean active)
     GST_DEBUG_OBJECT (ts, "deactivating push mode");
     ts->srcresult = GST_FLOW_FLUSHING;
     ts->sinkresult = GST_FLOW_FLUSHING;
+    gst_flutsbase_pace_reset (ts);
     /* the item add signal will unblock */
     FLOW_SIGNAL_ADD (ts);
     FLOW_MUTEX_UNLOCK (ts);
 
     /* step 2, make sure streaming finishes */
-    ret = gst_pad_stop_task (pad);
+    ret = gst_flutsbase_loop_stop (ts, TRUE);
   }
  
   return ret;
 }
 
+/* src operating in pull mode, downstream reads any cached range with
+ * gst_flutsbase_get_range() and there is no task */
+static inline gboolean
+gst_flutsbase_src_activate_pull (GstPad * pad, GstObject * parent,
+    gboolean active)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (parent);
+
+  if (active && !ts->allow_pull) {
+    GST_DEBUG_OBJECT (ts, "pull mode not allowed");
+    return FALSE;
+  }
+
+  FLOW_MUTEX_LOCK (ts);
+  if (active) {
+    GST_DEBUG_OBJECT (ts, "activating pull mode");
+    ts->srcresult = GST_FLOW_OK;
+  } else {
+    GST_DEBUG_OBJECT (ts, "deactivating pull mode");
+    ts->srcresult = GST_FLOW_FLUSHING;
+    /* unblock the getrange waiting for data */
+    FLOW_SIGNAL_ADD (ts);
+  }
+  FLOW_MUTEX_UNLOCK (ts);
+
+  return TRUE;
+}
+
+/* Reads @length bytes at @offset from the ring buffer or the disk, waiting
+ * for them to be received when beyond the live edge */
+static GstFlowReturn
+gst_flutsbase_get_range (GstPad * pad, GstObject * parent, guint64 offset,
+    guint length, GstBuffer ** buffer)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (parent);
+
+  FLOW_MUTEX_LOCK_CHECK (ts, ts->srcresult, out_flushing);
+
+  while (offset + length >
+      gst_shifter_cache_get_total_bytes_received (ts->cache) && !ts->is_eos) {
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "waiting for offset %" G_GUINT64_FORMAT,
+        offset + length);
+    FLOW_WAIT_ADD_CHECK (ts, ts->srcresult, out_flushing);
+  }
+
+  if (!(*buffer = gst_shifter_cache_read (ts->cache, offset, length)))
+    goto not_cached;
+
+  ts->cur_bytes = GST_BUFFER_OFFSET_END (*buffer);
+  COUNTERS_ADD (ts, bytes_out, gst_buffer_get_size (*buffer));
+  FLOW_MUTEX_UNLOCK (ts);
+
+  GST_CAT_LOG_OBJECT (ts_flow, ts, "read %" G_GSIZE_FORMAT " bytes at offset %"
+      G_GUINT64_FORMAT, gst_buffer_get_size (*buffer), offset);
+
+  return GST_FLOW_OK;
+
+  /* ERRORS */
+out_flushing:
+  {
+    GstFlowReturn ret = ts->srcresult;
+
+    GST_CAT_LOG_OBJECT (ts_flow, ts, "exit because we are flushing");
+    FLOW_MUTEX_UNLOCK (ts);
+    return ret;
+  }
+not_cached:
+  {
+    GstFlowReturn ret = GST_FLOW_EOS;
+
+    if (offset < gst_shifter_cache_get_total_bytes_received (ts->cache)) {
+      GST_WARNING_OBJECT (ts, "offset %" G_GUINT64_FORMAT " is not cached "
+          "anymore", offset);
+      ret = GST_FLOW_ERROR;
+    }
+    FLOW_MUTEX_UNLOCK (ts);
+    return ret;
+  }
+}
+
 static gboolean
 gst_flutsbase_handle_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -805,6 +2636,15 @@ static gboolean
 gst_flutsbase_handle_src_query (GstPad * pad, GstObject * parent,
     GstQuery * query)
 {
+  GstFluTSBase *ts = GST_FLUTSBASE (parent);
+
+  if (GST_QUERY_TYPE (query) == GST_QUERY_SCHEDULING) {
+    gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+    gst_query_add_scheduling_mode (query, GST_PAD_MODE_PUSH);
+    if (ts->allow_pull)
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+    return TRUE;
+  }
   return gst_flutsbase_query (GST_ELEMENT (parent), query);
 }
 
@@ -828,6 +2668,8 @@ gst_flutsbase_src_activate_mode (GstPad * pad, GstObject * parent,
 
   if (mode == GST_PAD_MODE_PUSH) {
     ret = gst_flutsbase_src_activate (pad, parent, active);
+  } else if (mode == GST_PAD_MODE_PULL) {
+    ret = gst_flutsbase_src_activate_pull (pad, parent, active);
   }
   return ret;
 }
@@ -846,6 +2688,17 @@ gst_flutsbase_change_state (GstElement * element, GstStateChange transition)
       gst_event_replace (&ts->stream_start_event, NULL);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      FLOW_MUTEX_LOCK (ts);
+      ts->playing = TRUE;
+      FLOW_SIGNAL_ADD (ts);
+      FLOW_MUTEX_UNLOCK (ts);
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* continue from the cache at the exact byte we stopped forwarding */
+      FLOW_MUTEX_LOCK (ts);
+      ts->playing = FALSE;
+      gst_flutsbase_passthrough_stop (ts);
+      FLOW_MUTEX_UNLOCK (ts);
       break;
     default:
       break;
@@ -887,6 +2740,10 @@ gst_flutsbase_set_property (GObject * object,
   switch (prop_id) {
     case PROP_CACHE_SIZE:
       ts->cache_size = g_value_get_uint64 (value);
+      if (ts->cache && !gst_flutsbase_resize_cache (ts)) {
+        GST_WARNING_OBJECT (ts, "can't resize the shared memory cache, "
+            "the new size is applied on the next start");
+      }
       break;
     case PROP_RECORDING_TEMPLATE:
       gst_flutsbase_set_recording_template (ts, g_value_get_string (value));
@@ -897,6 +2754,119 @@ gst_flutsbase_set_property (GObject * object,
         gst_shifter_cache_set_autoremove (ts->cache, ts->recording_remove);
       }
       break;
+    case PROP_IO_CLASS:
+      ts->io_class = g_value_get_enum (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_io_priority (ts->cache, ts->io_class,
+            ts->io_level);
+      }
+      break;
+    case PROP_IO_LEVEL:
+      ts->io_level = g_value_get_int (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_io_priority (ts->cache, ts->io_class,
+            ts->io_level);
+      }
+      break;
+    case PROP_WRITE_RATE_LIMIT:
+      ts->write_rate_limit = g_value_get_uint64 (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_write_rate (ts->cache, ts->write_rate_limit);
+      }
+      break;
+    case PROP_DISK_LOW_THRESHOLD:
+      ts->disk_low_threshold = g_value_get_uint64 (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_disk_thresholds (ts->cache,
+            ts->disk_low_threshold, ts->disk_critical_threshold);
+      }
+      break;
+    case PROP_DISK_CRITICAL_THRESHOLD:
+      ts->disk_critical_threshold = g_value_get_uint64 (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_disk_thresholds (ts->cache,
+            ts->disk_low_threshold, ts->disk_critical_threshold);
+      }
+      break;
+    case PROP_SYNC_POLICY:
+      ts->sync_policy = g_value_get_enum (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_sync_policy (ts->cache, ts->sync_policy,
+            ts->sync_interval);
+      }
+      break;
+    case PROP_SYNC_INTERVAL:
+      ts->sync_interval = g_value_get_uint64 (value);
+      if (ts->cache) {
+        gst_shifter_cache_set_sync_policy (ts->cache, ts->sync_policy,
+            ts->sync_interval);
+      }
+      break;
+    case PROP_SHARED_MEMORY:
+      /* takes effect the next time the cache is created */
+      ts->shared_memory = g_value_get_boolean (value);
+      break;
+    case PROP_LIVE_PASSTHROUGH:
+      ts->live_passthrough = g_value_get_boolean (value);
+      if (!ts->live_passthrough)
+        gst_flutsbase_passthrough_stop (ts);
+      break;
+    case PROP_CATCH_UP:
+      ts->catch_up = g_value_get_boolean (value);
+      break;
+    case PROP_CATCH_UP_RATE:
+      ts->catch_up_rate = g_value_get_double (value);
+      if (ts->catching_up)
+        ts->need_rate_update = TRUE;
+      break;
+    case PROP_CATCH_UP_THRESHOLD:
+      ts->catch_up_threshold = g_value_get_uint64 (value);
+      break;
+    case PROP_SHARED_SCHEDULER:
+      ts->shared_scheduler = g_value_get_boolean (value);
+      break;
+    case PROP_USE_BUFFERING:
+      ts->use_buffering = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      ts->stats_interval = g_value_get_uint64 (value);
+      if (ts->cache)
+        gst_flutsbase_stats_start (ts);
+      break;
+    case PROP_LOW_PERCENT:
+      ts->low_percent = g_value_get_int (value);
+      if (ts->low_percent > ts->high_percent) {
+        GST_WARNING_OBJECT (ts, "low-percent %d above high-percent, clamped "
+            "to %d", ts->low_percent, ts->high_percent);
+        ts->low_percent = ts->high_percent;
+      }
+      break;
+    case PROP_HIGH_PERCENT:
+      ts->high_percent = g_value_get_int (value);
+      if (ts->high_percent < ts->low_percent) {
+        GST_WARNING_OBJECT (ts, "high-percent %d below low-percent, clamped "
+            "to %d", ts->high_percent, ts->low_percent);
+        ts->high_percent = ts->low_percent;
+      }
+      break;
+    case PROP_WINDOW_DURATION:
+      ts->window_duration = g_value_get_uint64 (value);
+      ts->window_size = 0;
+      ts->window_update = GST_CLOCK_TIME_NONE;
+      if (!ts->window_duration && ts->cache) {
+        /* back to the sizes in bytes */
+        gst_shifter_cache_set_disk_window (ts->cache, 0);
+        gst_flutsbase_resize_cache (ts);
+      }
+      break;
+    case PROP_PCR_PACING:
+      ts->pcr_pacing = g_value_get_boolean (value);
+      if (!ts->pcr_pacing)
+        gst_flutsbase_pace_reset (ts);
+      break;
+    case PROP_ALLOW_PULL:
+      ts->allow_pull = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -905,6 +2875,26 @@ gst_flutsbase_set_property (GObject * object,
   FLOW_MUTEX_UNLOCK (ts);
 }
 
+/* Adds the counters of the element to the ones of the cache */
+static GstStructure *
+gst_flutsbase_get_stats (GstFluTSBase * ts)
+{
+  GstFluTSBaseCounters counters;
+  GstStructure *stru;
+
+  if (ts->cache) {
+    stru = gst_shifter_cache_get_stats (ts->cache);
+    gst_structure_set_name (stru, "shifter-stats");
+  } else {
+    stru = gst_structure_new_empty ("shifter-stats");
+  }
+
+  gst_flutsbase_get_counters (ts, &counters);
+  gst_flutsbase_set_counters (stru, &counters);
+
+  return stru;
+}
+
 static void
 gst_flutsbase_get_property (GObject * object,
     guint prop_id, GValue * value, GParamSpec * pspec)
@@ -923,6 +2913,91 @@ gst_flutsbase_get_property (GObject * object,
     case PROP_RECORDING_REMOVE:
       g_value_set_boolean (value, ts->recording_remove);
       break;
+    case PROP_IO_CLASS:
+      g_value_set_enum (value, ts->io_class);
+      break;
+    case PROP_IO_LEVEL:
+      g_value_set_int (value, ts->io_level);
+      break;
+    case PROP_WRITE_RATE_LIMIT:
+      g_value_set_uint64 (value, ts->write_rate_limit);
+      break;
+    case PROP_READ_LATENCY_STATS:
+      if (ts->cache) {
+        g_value_take_boxed (value,
+            gst_shifter_cache_get_read_stats (ts->cache));
+      } else {
+        g_value_set_boxed (value, NULL);
+      }
+      break;
+    case PROP_DISK_LOW_THRESHOLD:
+      g_value_set_uint64 (value, ts->disk_low_threshold);
+      break;
+    case PROP_DISK_CRITICAL_THRESHOLD:
+      g_value_set_uint64 (value, ts->disk_critical_threshold);
+      break;
+    case PROP_SYNC_POLICY:
+      g_value_set_enum (value, ts->sync_policy);
+      break;
+    case PROP_SYNC_INTERVAL:
+      g_value_set_uint64 (value, ts->sync_interval);
+      break;
+    case PROP_SHARED_MEMORY:
+      g_value_set_boolean (value, ts->shared_memory);
+      break;
+    case PROP_SHARED_MEMORY_FD:
+      g_value_set_int (value,
+          ts->cache ? gst_shifter_cache_get_shared_fd (ts->cache) : -1);
+      break;
+    case PROP_LIVE_PASSTHROUGH:
+      g_value_set_boolean (value, ts->live_passthrough);
+      break;
+    case PROP_CATCH_UP:
+      g_value_set_boolean (value, ts->catch_up);
+      break;
+    case PROP_CATCH_UP_RATE:
+      g_value_set_double (value, ts->catch_up_rate);
+      break;
+    case PROP_CATCH_UP_THRESHOLD:
+      g_value_set_uint64 (value, ts->catch_up_threshold);
+      break;
+    case PROP_LIVE_DISTANCE:
+      g_value_set_uint64 (value, gst_flutsbase_get_live_distance (ts));
+      break;
+    case PROP_PCR_PACING:
+      g_value_set_boolean (value, ts->pcr_pacing);
+      break;
+    case PROP_ALLOW_PULL:
+      g_value_set_boolean (value, ts->allow_pull);
+      break;
+    case PROP_SHARED_SCHEDULER:
+      g_value_set_boolean (value, ts->shared_scheduler);
+      break;
+    case PROP_MEMORY_BUDGET:
+      g_value_set_uint64 (value, gst_flucachemanager_get_budget ());
+      break;
+    case PROP_MEMORY_USAGE:
+      g_value_set_uint64 (value,
+          ts->cache ? gst_shifter_cache_get_memory_usage (ts->cache) : 0);
+      break;
+    case PROP_WINDOW_DURATION:
+      g_value_set_uint64 (value, ts->window_duration);
+      break;
+    case PROP_USE_BUFFERING:
+      g_value_set_boolean (value, ts->use_buffering);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_flutsbase_get_stats (ts));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, ts->stats_interval);
+      break;
+    case PROP_LOW_PERCENT:
+      g_value_set_int (value, ts->low_percent);
+      break;
+    case PROP_HIGH_PERCENT:
+      g_value_set_int (value, ts->high_percent);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -939,7 +3014,9 @@ gst_flutsbase_finalize (GObject * object)
   GST_DEBUG_OBJECT (ts, "finalizing tsbase");
 
   g_mutex_free (ts->flow_lock);
+  g_mutex_free (ts->stats_lock);
   g_cond_free (ts->buffer_add);
+  g_list_free (ts->outputs);
 
   /* recording_file path cleanup  */
   g_free (ts->recording_template);
@@ -962,7 +3039,8 @@ gst_flutsbase_class_init (GstFluTSBaseClass * klass)
   g_object_class_install_property (gclass, PROP_CACHE_SIZE,
       g_param_spec_uint64 ("cache-size",
           "Cache size in bytes",
-          "Max. amount of data cached in memory (bytes)",
+          "Max. amount of data cached in memory, can be changed while "
+          "playing, the memory budget can only lower it (bytes)",
           DEFAULT_MIN_CACHE_SIZE, G_MAXUINT64, DEFAULT_CACHE_SIZE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
@@ -978,11 +3056,182 @@ gst_flutsbase_class_init (GstFluTSBaseClass * klass)
           DEFAULT_RECORDING_REMOVE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gclass, PROP_IO_CLASS,
+      g_param_spec_enum ("io-class", "I/O scheduling class",
+          "I/O scheduling class of the thread migrating the ring buffer to the "
+          "recording file",
+          gst_flutsbase_io_class_get_type (), DEFAULT_IO_CLASS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_IO_LEVEL,
+      g_param_spec_int ("io-level", "I/O priority level",
+          "I/O priority inside the scheduling class (0 = highest)",
+          0, 7, DEFAULT_IO_LEVEL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_WRITE_RATE_LIMIT,
+      g_param_spec_uint64 ("write-rate-limit", "Write rate limit",
+          "Max. rate the recording is written to the disk at, the input "
+          "is held back when the live data goes over it "
+          "(bytes per second, 0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_WRITE_RATE_LIMIT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_READ_LATENCY_STATS,
+      g_param_spec_boxed ("read-latency-stats", "Read latency statistics",
+          "Latency of the disk reads feeding the playback, in nanoseconds",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_DISK_LOW_THRESHOLD,
+      g_param_spec_uint64 ("disk-low-threshold", "Disk low threshold",
+          "Free space on the recording disk below which the oldest recorded "
+          "data is discarded (bytes)",
+          0, G_MAXUINT64, DEFAULT_DISK_LOW_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_DISK_CRITICAL_THRESHOLD,
+      g_param_spec_uint64 ("disk-critical-threshold",
+          "Disk critical threshold",
+          "Free space on the recording disk below which recording stops and "
+          "only the memory cache is used (bytes)",
+          0, G_MAXUINT64, DEFAULT_DISK_CRITICAL_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_SYNC_POLICY,
+      g_param_spec_enum ("sync-policy", "Sync policy",
+          "How the recording is pushed to the disk: none keeps nothing after "
+          "a system crash, range bounds the dirty data without guarantees and "
+          "data loses at most sync-interval bytes",
+          gst_flutsbase_sync_policy_get_type (), DEFAULT_SYNC_POLICY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_SYNC_INTERVAL,
+      g_param_spec_uint64 ("sync-interval", "Sync interval",
+          "Amount of data written to the recording between syncs (bytes)",
+          CACHE_SLOT_SIZE, G_MAXUINT64, DEFAULT_SYNC_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_SHARED_MEMORY,
+      g_param_spec_boolean ("shared-memory", "Shared memory",
+          "Keep the memory cache in a memfd other processes can map, "
+          "takes effect when going to PAUSED",
+          DEFAULT_SHARED_MEMORY, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_SHARED_MEMORY_FD,
+      g_param_spec_int ("shared-memory-fd", "Shared memory fd",
+          "File descriptor of the shared memory cache (-1 = none), owned by "
+          "the element and valid until it goes back to READY",
+          -1, G_MAXINT, -1, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_LIVE_PASSTHROUGH,
+      g_param_spec_boolean ("live-passthrough", "Live passthrough",
+          "Forward the incoming data directly downstream when playing at the "
+          "live edge, it is still recorded in the cache",
+          DEFAULT_LIVE_PASSTHROUGH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_CATCH_UP,
+      g_param_spec_boolean ("catch-up", "Catch up",
+          "Play at catch-up-rate while more than catch-up-threshold behind "
+          "the live edge",
+          DEFAULT_CATCH_UP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_CATCH_UP_RATE,
+      g_param_spec_double ("catch-up-rate", "Catch up rate",
+          "Playback rate used to get back to the live edge",
+          1.0, 2.0, DEFAULT_CATCH_UP_RATE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_CATCH_UP_THRESHOLD,
+      g_param_spec_uint64 ("catch-up-threshold", "Catch up threshold",
+          "Distance to the live edge from which to catch up (bytes)",
+          CACHE_SLOT_SIZE, G_MAXUINT64, DEFAULT_CATCH_UP_THRESHOLD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_LIVE_DISTANCE,
+      g_param_spec_uint64 ("live-distance", "Live distance",
+          "Distance between the playback position and the live edge (bytes)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_PCR_PACING,
+      g_param_spec_boolean ("pcr-pacing", "PCR pacing",
+          "Push the cached data at the pace of the stream clock instead of "
+          "as fast as downstream accepts it", DEFAULT_PCR_PACING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_ALLOW_PULL,
+      g_param_spec_boolean ("allow-pull", "Allow pull mode",
+          "Let downstream read any cached range in pull mode instead of "
+          "receiving the data pushed from our own thread, applied on the "
+          "next activation", DEFAULT_ALLOW_PULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_SHARED_SCHEDULER,
+      g_param_spec_boolean ("shared-scheduler", "Shared scheduler",
+          "Migrate the ring buffer to the disk on worker threads shared by "
+          "all the instances instead of a thread of our own, the output "
+          "keeps its own thread. Applied on the next start",
+          DEFAULT_SHARED_SCHEDULER,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_MEMORY_BUDGET,
+      g_param_spec_uint64 ("memory-budget", "Memory budget",
+          "Memory shared by the caches of all the instances of the process, "
+          "split according to their input rate, set with the "
+          "GST_FLUTS_MEMORY_BUDGET environment variable (0 = unlimited, bytes)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_WINDOW_DURATION,
+      g_param_spec_uint64 ("window-duration", "Window duration",
+          "Size the cache to keep this much of the stream at its current "
+          "bitrate, on the disk with the memory capped to cache-size, only "
+          "up to cache-size without a recording-template (0 = disabled, in ns)",
+          0, G_MAXUINT64, DEFAULT_WINDOW_DURATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_USE_BUFFERING,
+      g_param_spec_boolean ("use-buffering", "Use buffering",
+          "Post buffering messages when the memory cache holds less than "
+          "low-percent of the data up to the live edge, until it is back to "
+          "high-percent, never at the live edge",
+          DEFAULT_USE_BUFFERING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_LOW_PERCENT,
+      g_param_spec_int ("low-percent", "Low percent",
+          "Fullness of the memory cache where buffering starts, at most "
+          "high-percent", 0, 100,
+          DEFAULT_LOW_PERCENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_HIGH_PERCENT,
+      g_param_spec_int ("high-percent", "High percent",
+          "Fullness of the memory cache where buffering ends", 1, 100,
+          DEFAULT_HIGH_PERCENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_MEMORY_USAGE,
+      g_param_spec_uint64 ("memory-usage", "Memory usage",
+          "Memory used by the cache of this instance (bytes)",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_STATS,
+      g_param_spec_boxed ("stats", "Statistics",
+          "Counters of the data flow, the cache, the disk, the locking and "
+          "the seeks (latencies in nanoseconds)",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gclass, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Post the counters of the stats in a shifter-stats element message "
+          "at this interval from PAUSED (0 = disabled, in ns)",
+          0, G_MAXUINT64, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /* set several parent class virtual functions */
   gclass->finalize = gst_flutsbase_finalize;
 
   eclass->change_state = GST_DEBUG_FUNCPTR (gst_flutsbase_change_state);
   eclass->query = GST_DEBUG_FUNCPTR (gst_flutsbase_query);
+  eclass->request_new_pad = GST_DEBUG_FUNCPTR (gst_flutsbase_request_new_pad);
+  eclass->release_pad = GST_DEBUG_FUNCPTR (gst_flutsbase_release_pad);
 }
 
 static void
@@ -994,6 +3243,8 @@ gst_flutsbase_init (GstFluTSBase * ts, GstFluTSBaseClass * klass)
 
   gst_pad_set_chain_function (ts->sinkpad,
       GST_DEBUG_FUNCPTR (gst_flutsbase_chain));
+  gst_pad_set_chain_list_function (ts->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_flutsbase_chain_list));
   gst_pad_set_activatemode_function (ts->sinkpad,
       GST_DEBUG_FUNCPTR (gst_flutsbase_sink_activate_mode));
   gst_pad_set_event_function (ts->sinkpad,
@@ -1010,10 +3261,47 @@ gst_flutsbase_init (GstFluTSBase * ts, GstFluTSBaseClass * klass)
       GST_DEBUG_FUNCPTR (gst_flutsbase_handle_src_event));
   gst_pad_set_query_function (ts->srcpad,
       GST_DEBUG_FUNCPTR (gst_flutsbase_handle_src_query));
+  gst_pad_set_getrange_function (ts->srcpad,
+      GST_DEBUG_FUNCPTR (gst_flutsbase_get_range));
   gst_element_add_pad (GST_ELEMENT (ts), ts->srcpad);
 
   /* set default values */
   ts->cur_bytes = 0;
+  ts->io_class = DEFAULT_IO_CLASS;
+  ts->io_level = DEFAULT_IO_LEVEL;
+  ts->write_rate_limit = DEFAULT_WRITE_RATE_LIMIT;
+  ts->disk_low_threshold = DEFAULT_DISK_LOW_THRESHOLD;
+  ts->disk_critical_threshold = DEFAULT_DISK_CRITICAL_THRESHOLD;
+  ts->disk_state = GST_SHIFTER_CACHE_DISK_OK;
+  ts->sync_policy = DEFAULT_SYNC_POLICY;
+  ts->sync_interval = DEFAULT_SYNC_INTERVAL;
+  ts->shared_memory = DEFAULT_SHARED_MEMORY;
+  ts->live_passthrough = DEFAULT_LIVE_PASSTHROUGH;
+  ts->catch_up = DEFAULT_CATCH_UP;
+  ts->catch_up_rate = DEFAULT_CATCH_UP_RATE;
+  ts->catch_up_threshold = DEFAULT_CATCH_UP_THRESHOLD;
+  ts->catching_up = FALSE;
+  ts->need_rate_update = FALSE;
+  ts->pcr_pacing = DEFAULT_PCR_PACING;
+  ts->allow_pull = DEFAULT_ALLOW_PULL;
+  ts->pacing_id = NULL;
+  ts->pacing_base = GST_CLOCK_TIME_NONE;
+  ts->pacing_time = GST_CLOCK_TIME_NONE;
+  ts->window_duration = DEFAULT_WINDOW_DURATION;
+  ts->use_buffering = DEFAULT_USE_BUFFERING;
+  ts->low_percent = DEFAULT_LOW_PERCENT;
+  ts->high_percent = DEFAULT_HIGH_PERCENT;
+  ts->buffering = FALSE;
+  ts->buffering_percent = 100;
+  ts->window_size = 0;
+  ts->window_update = GST_CLOCK_TIME_NONE;
+  ts->outputs = NULL;
+  ts->output_count = 0;
+  ts->shared_scheduler = DEFAULT_SHARED_SCHEDULER;
+  ts->passthrough = FALSE;
+  ts->playing = FALSE;
+  g_queue_init (&ts->passthrough_queue);
+  ts->passthrough_bytes = 0;
 
   ts->srcresult = GST_FLOW_FLUSHING;
   ts->sinkresult = GST_FLOW_FLUSHING;
@@ -1021,7 +3309,19 @@ gst_flutsbase_init (GstFluTSBase * ts, GstFluTSBaseClass * klass)
   ts->need_newsegment = TRUE;
 
   ts->flow_lock = g_mutex_new ();
+  ts->stats_lock = g_mutex_new ();
   ts->buffer_add = g_cond_new ();
+  ts->seeking = FALSE;
+  ts->seek_time = GST_CLOCK_TIME_NONE;
+  ts->seek_offset = 0;
+  ts->seek_stop = -1;
+  ts->seek_rate = 1.0;
+  ts->seek_flags = GST_SEEK_FLAG_NONE;
+  ts->trick_time = GST_CLOCK_TIME_NONE;
+  ts->stats_interval = DEFAULT_STATS_INTERVAL;
+  ts->stats_id = NULL;
+  ts->ingest_offset = GST_BUFFER_OFFSET_NONE;
+  gst_flutsbase_reset_stats (ts);
 
   /* tempfile related */
   ts->recording_template = NULL;
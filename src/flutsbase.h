@@ -39,6 +39,37 @@ G_BEGIN_DECLS
   (G_TYPE_INSTANCE_GET_CLASS ((obj),GST_FLUTSBASE_TYPE,GstFluTSBaseClass))
 typedef struct _GstFluTSBase GstFluTSBase;
 typedef struct _GstFluTSBaseClass GstFluTSBaseClass;
+typedef struct _GstFluTSBaseOutput GstFluTSBaseOutput;
+
+/* buckets of the seek latency histogram in the stats */
+#define GST_FLUTSBASE_SEEK_BUCKETS 6
+
+typedef struct _GstFluTSBaseCounters GstFluTSBaseCounters;
+
+/* runtime statistics, see gst_flutsbase_get_counters() */
+struct _GstFluTSBaseCounters
+{
+  guint64 bytes_in;
+  guint64 bytes_out;
+  guint64 underruns;            /* times the output waited for data */
+  guint64 lock_waits;           /* contended takes of the flow lock */
+  GstClockTime lock_wait_time;
+  guint64 seeks;
+  GstClockTime seek_latency_max;
+  guint64 seek_histogram[GST_FLUTSBASE_SEEK_BUCKETS];
+};
+
+/* a requested src pad reading the cache at its own position */
+struct _GstFluTSBaseOutput
+{
+  GstFluTSBase *ts;
+  GstPad *pad;
+  GstShifterCacheCursor *cursor;
+
+  GstSegment segment;
+  GstFlowReturn srcresult;
+  gboolean need_newsegment;
+};
 
 struct _GstFluTSBase
 {
@@ -62,25 +93,130 @@ struct _GstFluTSBase
   GstShifterCache *cache;
   guint64 cache_size;
 
-  guint cur_bytes;              /* current position in bytes  */
+  guint64 cur_bytes;            /* current position in bytes  */
+  guint64 first_offset;         /* oldest byte in the cache */
 
   GMutex *flow_lock;            /* lock for flow control */
   GCond *buffer_add;            /* signals buffers added to the cache */
 
+  /* seeks performed by the pushing loop, the latest one requested wins */
+  gboolean seeking;
+  guint64 seek_offset;          /* latest position requested */
+  guint64 seek_stop;            /* its stop in bytes, -1 if none */
+  gdouble seek_rate;
+  GstSeekFlags seek_flags;
+
+  /* trick play */
+  GstClockTime trick_time;      /* stream time of the last key unit pushed */
+  GstClockTime seek_time;       /* when the last seek started */
+
   /* recording location stuff */
   gchar *recording_template;
   gboolean recording_remove;
   gboolean recording_started;
 
+  /* disk scheduling */
+  GstShifterCacheIOClass io_class;
+  gint io_level;
+  guint64 write_rate_limit;
+  guint64 disk_low_threshold;
+  guint64 disk_critical_threshold;
+  GstShifterCacheDiskState disk_state;
+  GstShifterCacheSyncPolicy sync_policy;
+  guint64 sync_interval;
+
+  /* ring buffer in a memfd shared with other processes */
+  gboolean shared_memory;
+
+  /* forwarding of the incoming buffers at the live edge */
+  gboolean live_passthrough;
+  gboolean passthrough;
+  gboolean playing;
+  GQueue passthrough_queue;
+  guint64 passthrough_bytes;
+
+  /* cache offset of the first buffer of the last chain call, for the
+   * tracer, changed with the flow lock and counters_seq like the counters */
+  guint64 ingest_offset;
+
+  /* playing faster to get back to the live edge */
+  gboolean catch_up;
+  gdouble catch_up_rate;
+  guint64 catch_up_threshold;
+  gboolean catching_up;
+  gboolean need_rate_update;
+
+  /* pushing cached data at the pace of the stream time */
+  gboolean pcr_pacing;
+  GstClockID pacing_id;
+  GstClockTime pacing_base;     /* clock time of the pacing reference */
+  GstClockTime pacing_time;     /* stream time of the pacing reference */
+
+  /* random access to the cache from downstream */
+  gboolean allow_pull;
+
+  /* buffering messages on the data ahead of the reader in the ring buffer */
+  gboolean use_buffering;
+  gint low_percent;
+  gint high_percent;
+  gboolean buffering;
+  gint buffering_percent;       /* last percent posted */
+
+  /* cache sized from the bitrate to keep a duration */
+  GstClockTime window_duration;
+  guint64 window_size;          /* bytes currently applied to the cache */
+  GstClockTime window_update;   /* when the bitrate was last checked */
+
+  /* disk writes on the workers shared by all the instances */
+  gboolean shared_scheduler;
+
+  /* runtime statistics, written with the flow lock and bumping
+   * counters_seq around every change so they can be read without it */
+  GstFluTSBaseCounters counters;
+  volatile gint counters_seq;   /* odd while the counters are written */
+  GstClockTime stats_interval;  /* period of the stats messages, 0 = none */
+  GMutex *stats_lock;           /* protects stats_id */
+  GstClockID stats_id;          /* periodic stats timer, NULL if none */
+
+  /* request src pads, protected by the flow lock */
+  GList *outputs;
+  guint output_count;
+
   GstEvent *stream_start_event;
 };
 
 struct _GstFluTSBaseClass
 {
   GstElementClass parent_class;
+
+  /* finds the byte range [start, stop) and stream time of the first key
+   * unit at or after @position, or at or before it when not @forward, for
+   * trick play. Optional. */
+  gboolean (*find_key_unit) (GstFluTSBase * ts, GstFormat format,
+      gint64 position, gboolean forward, guint64 * start, guint64 * stop,
+      GstClockTime * time);
+
+  /* returns the stream time of the data at byte @offset or
+   * GST_CLOCK_TIME_NONE when unknown, for pcr-pacing. Optional. */
+  GstClockTime (*get_stream_time) (GstFluTSBase * ts, guint64 offset);
+
+  /* returns the recent bitrate of the stream in bytes per second or 0 when
+   * unknown, for window-duration. Optional. */
+  guint64 (*get_bitrate) (GstFluTSBase * ts);
+
+  /* called when the data before byte @offset left the cache, or with 0
+   * when the cache starts over. Optional. */
+  void (*trim) (GstFluTSBase * ts, guint64 offset);
 };
 
 GType gst_flutsbase_get_type (void);
+GType gst_flutsbase_io_class_get_type (void);
+GType gst_flutsbase_disk_state_get_type (void);
+GType gst_flutsbase_sync_policy_get_type (void);
+
+void gst_flutsbase_get_counters (GstFluTSBase * ts,
+    GstFluTSBaseCounters * counters);
+guint64 gst_flutsbase_get_ingest_offset (GstFluTSBase * ts);
 
 G_END_DECLS
 #endif /* __FLUTSBASE_H__ */
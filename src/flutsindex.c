@@ -69,6 +69,10 @@ gst_flutsindex_init (GstFluTSIndex * index)
   index->writers = g_hash_table_new (NULL, NULL);
   index->last_id = 0;
   index->id = -1;
+  index->first_time = GST_CLOCK_TIME_NONE;
+  index->last_time = GST_CLOCK_TIME_NONE;
+  index->last_offset = 0;
+  index->first_offset = 0;
 
   GST_OBJECT_FLAG_SET (index, GST_FLUTSINDEX_WRITABLE);
   GST_OBJECT_FLAG_SET (index, GST_FLUTSINDEX_READABLE);
@@ -102,12 +106,91 @@ static inline void
 gst_flutsindex_add_entry (GstFluTSIndex * index, GstFluTSIndexEntry * entry)
 {
   GstFluTSIndexClass *iclass;
+  gint64 time, offset;
 
   iclass = GST_FLUTSINDEX_GET_CLASS (index);
 
   if (iclass->add_entry) {
     iclass->add_entry (index, entry);
   }
+
+  if (entry->type == GST_FLUTSINDEX_ENTRY_ASSOCIATION &&
+      gst_flutsindex_entry_assoc_map (entry, GST_FORMAT_TIME, &time) &&
+      gst_flutsindex_entry_assoc_map (entry, GST_FORMAT_BYTES, &offset)) {
+    GST_OBJECT_LOCK (index);
+    if (offset >= index->first_offset &&
+        (!GST_CLOCK_TIME_IS_VALID (index->first_time) ||
+            time < index->first_time))
+      index->first_time = time;
+    if (!GST_CLOCK_TIME_IS_VALID (index->last_time) ||
+        time > index->last_time) {
+      index->last_time = time;
+      index->last_offset = offset;
+    }
+    GST_OBJECT_UNLOCK (index);
+  }
+}
+
+/**
+ * gst_flutsindex_get_bounds:
+ * @index: the index to query
+ * @first_time: (out) (allow-none): time of the earliest entry still
+ *     available, see gst_flutsindex_set_first_offset()
+ * @last_time: (out) (allow-none): time of the latest entry
+ * @last_offset: (out) (allow-none): byte offset of the latest entry
+ *
+ * Gets the bounds of the entries without a lookup.
+ *
+ * Returns: FALSE if the index has no entries yet.
+ */
+gboolean
+gst_flutsindex_get_bounds (GstFluTSIndex * index, GstClockTime * first_time,
+    GstClockTime * last_time, guint64 * last_offset)
+{
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_FLUTSINDEX (index), FALSE);
+
+  GST_OBJECT_LOCK (index);
+  ret = GST_CLOCK_TIME_IS_VALID (index->last_time);
+  if (first_time)
+    *first_time = index->first_time;
+  if (last_time)
+    *last_time = index->last_time;
+  if (last_offset)
+    *last_offset = index->last_offset;
+  GST_OBJECT_UNLOCK (index);
+
+  return ret;
+}
+
+/**
+ * gst_flutsindex_set_first_offset:
+ * @index: the index
+ * @offset: byte offset of the earliest data still available
+ *
+ * Tells the index the data before @offset is gone, the first time of the
+ * bounds becomes the one of the first entry from @offset. The entries are
+ * kept.
+ */
+void
+gst_flutsindex_set_first_offset (GstFluTSIndex * index, guint64 offset)
+{
+  GstFluTSIndexEntry *entry;
+  gint64 time;
+
+  g_return_if_fail (GST_IS_FLUTSINDEX (index));
+
+  entry = gst_flutsindex_get_assoc_entry (index, GST_FLUTSINDEX_LOOKUP_AFTER,
+      GST_FLUTSINDEX_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, offset);
+
+  GST_OBJECT_LOCK (index);
+  index->first_offset = offset;
+  if (entry && gst_flutsindex_entry_assoc_map (entry, GST_FORMAT_TIME, &time))
+    index->first_time = time;
+  else
+    index->first_time = index->last_time;
+  GST_OBJECT_UNLOCK (index);
 }
 
 /**
@@ -218,6 +218,12 @@ struct _GstFluTSIndex
   GHashTable *writers;
   gint last_id;
   gint id;
+
+  /* bounds of the entries, protected by the object lock */
+  GstClockTime first_time;      /* earliest entry still available */
+  GstClockTime last_time;
+  guint64 last_offset;
+  guint64 first_offset;         /* the data before is gone */
 };
 
 struct _GstFluTSIndexClass
@@ -257,6 +263,12 @@ GstFluTSIndexEntry *gst_flutsindex_get_assoc_entry_full (GstFluTSIndex * index,
     GstFluTSIndexAssociationFlags flags, GstFormat format, gint64 value,
     GCompareDataFunc func, gpointer user_data);
 
+gboolean gst_flutsindex_get_bounds (GstFluTSIndex * index,
+    GstClockTime * first_time, GstClockTime * last_time,
+    guint64 * last_offset);
+void gst_flutsindex_set_first_offset (GstFluTSIndex * index,
+    guint64 offset);
+
 /* working with index entries */
 GType gst_flutsindex_entry_get_type (void);
 
@@ -271,6 +283,7 @@ gboolean gst_flutsindex_entry_assoc_map (GstFluTSIndexEntry * entry,
 #define GST_TYPE_INDEX GST_TYPE_FLUTSINDEX
 #define GstIndexEntry GstFluTSIndexEntry
 #define GstIndexAssociation GstFluTSIndexAssociation
+#define GstIndexLookupMethod GstFluTSIndexLookupMethod
 
 #define gst_index_factory_make(name) gst_flutsmemindex_new()
 #define gst_index_get_writer_id gst_flutsindex_get_writer_id
@@ -279,7 +292,9 @@ gboolean gst_flutsindex_entry_assoc_map (GstFluTSIndexEntry * entry,
 #define gst_index_entry_assoc_map gst_flutsindex_entry_assoc_map
 
 #define GST_ASSOCIATION_FLAG_NONE GST_FLUTSINDEX_ASSOCIATION_FLAG_NONE
+#define GST_ASSOCIATION_FLAG_KEY_UNIT GST_FLUTSINDEX_ASSOCIATION_FLAG_KEY_UNIT
 #define GST_INDEX_LOOKUP_BEFORE GST_FLUTSINDEX_LOOKUP_BEFORE
+#define GST_INDEX_LOOKUP_AFTER GST_FLUTSINDEX_LOOKUP_AFTER
 
 G_END_DECLS
 #endif /* _FLUTSINDEX_H__ */
@@ -389,6 +389,9 @@ gst_flutsmemindex_get_assoc_entry (GstFluTSIndex * index, gint id,
           l_entry = g_list_previous (l_entry);
         }
       }
+      /* no entry with the flags in that direction */
+      if (!l_entry)
+        entry = NULL;
     } else {
       entry = NULL;
     }
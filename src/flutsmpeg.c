@@ -22,6 +22,19 @@
 GST_DEBUG_CATEGORY_EXTERN (ts_mpeg);
 #define GST_CAT_DEFAULT ts_mpeg
 
+/* upper bound of the data pushed for a key unit in trick play, for streams
+ * indexed sparsely where the next entry is far away */
+#define KEY_UNIT_MAX_SIZE (1024 * 1024)
+
+/* stream time the bitrate is measured over */
+#define BITRATE_SPAN (10 * GST_SECOND)
+
+enum
+{
+  PROP_0,
+  PROP_INDEX
+};
+
 #define gst_flumpegshifter_parent_class parent_class
 G_DEFINE_TYPE (GstFluMPEGShifter, gst_flumpegshifter, GST_FLUTSBASE_TYPE);
 
@@ -29,18 +42,256 @@ static GstStaticPadTemplate src_factory =
 GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/mpegts"));
 
+static GstStaticPadTemplate output_factory =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC, GST_PAD_REQUEST, GST_STATIC_CAPS ("video/mpegts"));
+
 static GstStaticPadTemplate sink_factory =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/mpegts"));
 
+static void
+gst_flumpegshifter_replace_index (GstFluMPEGShifter * ts, GstIndex * index)
+{
+  GST_OBJECT_LOCK (ts);
+  if (ts->index)
+    gst_object_unref (ts->index);
+  ts->index = index;
+  ts->span_l_offset = ts->span_h_offset = 0;
+  GST_OBJECT_UNLOCK (ts);
+}
+
+static void
+gst_flumpegshifter_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (object);
+
+  switch (prop_id) {
+    case PROP_INDEX:
+      gst_flumpegshifter_replace_index (ts, g_value_dup_object (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_flumpegshifter_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (object);
+
+  switch (prop_id) {
+    case PROP_INDEX:
+      GST_OBJECT_LOCK (ts);
+      g_value_set_object (value, ts->index);
+      GST_OBJECT_UNLOCK (ts);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_flumpegshifter_dispose (GObject * object)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (object);
+
+  gst_flumpegshifter_replace_index (ts, NULL);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+/* Finds the first key unit from @position in the index, its data goes
+ * until the next index entry. */
+static gboolean
+gst_flumpegshifter_find_key_unit (GstFluTSBase * base, GstFormat format,
+    gint64 position, gboolean forward, guint64 * start, guint64 * stop,
+    GstClockTime * time)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (base);
+  GstIndexEntry *entry;
+  gint64 value, offset;
+  gboolean ret = FALSE;
+
+  GST_OBJECT_LOCK (ts);
+  if (!ts->index)
+    goto beach;
+
+  entry = gst_index_get_assoc_entry (ts->index,
+      forward ? GST_INDEX_LOOKUP_AFTER : GST_INDEX_LOOKUP_BEFORE,
+      GST_ASSOCIATION_FLAG_KEY_UNIT, format, position);
+  if (!entry && !gst_index_get_assoc_entry (ts->index,
+          forward ? GST_INDEX_LOOKUP_BEFORE : GST_INDEX_LOOKUP_AFTER,
+          GST_ASSOCIATION_FLAG_KEY_UNIT, format, position)) {
+    /* streams without the random access indicator on the PCR packets have
+     * no key unit entries at all, take the regular index entries instead
+     * and let the decoders resync on the DISCONT */
+    entry = gst_index_get_assoc_entry (ts->index,
+        forward ? GST_INDEX_LOOKUP_AFTER : GST_INDEX_LOOKUP_BEFORE,
+        GST_ASSOCIATION_FLAG_NONE, format, position);
+  }
+  if (!entry)
+    goto beach;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &offset);
+  gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &value);
+
+  /* the key unit is complete once the next entry is there */
+  entry = gst_index_get_assoc_entry (ts->index, GST_INDEX_LOOKUP_AFTER,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, offset + 1);
+  if (!entry)
+    goto beach;
+
+  *start = offset;
+  *time = value;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &offset);
+  *stop = MIN (offset, *start + KEY_UNIT_MAX_SIZE);
+  ret = TRUE;
+
+beach:
+  GST_OBJECT_UNLOCK (ts);
+  return ret;
+}
+
+/* Interpolates the PCR time of @offset between the index entries around it,
+ * unknown past the last entry. */
+static GstClockTime
+gst_flumpegshifter_get_stream_time (GstFluTSBase * base, guint64 offset)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (base);
+  GstIndexEntry *entry;
+  gint64 l_offset, l_time, h_offset, h_time;
+  GstClockTime ret = GST_CLOCK_TIME_NONE;
+
+  GST_OBJECT_LOCK (ts);
+  if (!ts->index)
+    goto beach;
+
+  /* consecutive buffers fall between the same entries most of the time */
+  if (offset >= ts->span_l_offset && offset < ts->span_h_offset)
+    goto interpolate;
+
+  entry = gst_index_get_assoc_entry (ts->index, GST_INDEX_LOOKUP_BEFORE,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, offset);
+  if (!entry)
+    goto beach;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &l_offset);
+  gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &l_time);
+
+  entry = gst_index_get_assoc_entry (ts->index, GST_INDEX_LOOKUP_AFTER,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, l_offset + 1);
+  if (!entry)
+    goto beach;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &h_offset);
+  gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &h_time);
+
+  if (h_time < l_time)
+    goto beach;
+
+  ts->span_l_offset = l_offset;
+  ts->span_l_time = l_time;
+  ts->span_h_offset = h_offset;
+  ts->span_h_time = h_time;
+
+interpolate:
+  ret = ts->span_l_time + gst_util_uint64_scale (ts->span_h_time -
+      ts->span_l_time, offset - ts->span_l_offset,
+      ts->span_h_offset - ts->span_l_offset);
+
+beach:
+  GST_OBJECT_UNLOCK (ts);
+  return ret;
+}
+
+/* The data before @offset left the cache, the index bounds follow */
+static void
+gst_flumpegshifter_trim (GstFluTSBase * base, guint64 offset)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (base);
+  GstIndex *index = NULL;
+
+  GST_OBJECT_LOCK (ts);
+  if (ts->index)
+    index = gst_object_ref (ts->index);
+  GST_OBJECT_UNLOCK (ts);
+
+  if (index) {
+    gst_flutsindex_set_first_offset (index, offset);
+    gst_object_unref (index);
+  }
+}
+
+/* Measures the bitrate between the last index entry and the one
+ * BITRATE_SPAN before it. */
+static guint64
+gst_flumpegshifter_get_bitrate (GstFluTSBase * base)
+{
+  GstFluMPEGShifter *ts = GST_FLUMPEGSHIFTER (base);
+  GstIndexEntry *entry;
+  gint64 l_offset, l_time, h_offset, h_time;
+  guint64 ret = 0;
+
+  GST_OBJECT_LOCK (ts);
+  if (!ts->index)
+    goto beach;
+
+  entry = gst_index_get_assoc_entry (ts->index, GST_INDEX_LOOKUP_BEFORE,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, G_MAXINT64);
+  if (!entry)
+    goto beach;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &h_offset);
+  gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &h_time);
+
+  entry = gst_index_get_assoc_entry (ts->index, GST_INDEX_LOOKUP_AFTER,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_TIME,
+      MAX (h_time - (gint64) BITRATE_SPAN, 0));
+  if (!entry)
+    goto beach;
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &l_offset);
+  gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &l_time);
+
+  if (h_time <= l_time || h_offset <= l_offset)
+    goto beach;
+
+  ret = gst_util_uint64_scale (h_offset - l_offset, GST_SECOND,
+      h_time - l_time);
+
+beach:
+  GST_OBJECT_UNLOCK (ts);
+  return ret;
+}
+
 static void
 gst_flumpegshifter_class_init (GstFluMPEGShifterClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstFluTSBaseClass *base_class = GST_FLUTSBASE_CLASS (klass);
+
+  gobject_class->set_property = gst_flumpegshifter_set_property;
+  gobject_class->get_property = gst_flumpegshifter_get_property;
+  gobject_class->dispose = gst_flumpegshifter_dispose;
+
+  g_object_class_install_property (gobject_class, PROP_INDEX,
+      g_param_spec_object ("index", "Index",
+          "The index from which to read the key units for trick play",
+          GST_TYPE_INDEX, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  base_class->find_key_unit =
+      GST_DEBUG_FUNCPTR (gst_flumpegshifter_find_key_unit);
+  base_class->get_stream_time =
+      GST_DEBUG_FUNCPTR (gst_flumpegshifter_get_stream_time);
+  base_class->get_bitrate = GST_DEBUG_FUNCPTR (gst_flumpegshifter_get_bitrate);
+  base_class->trim = GST_DEBUG_FUNCPTR (gst_flumpegshifter_trim);
 
   /* GstElement related stuff */
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&output_factory));
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&sink_factory));
 
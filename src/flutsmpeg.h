@@ -21,6 +21,7 @@
 #define __FLUTSMPEG_H__
 
 #include "flutsbase.h"
+#include "flutsindex.h"
 
 G_BEGIN_DECLS
 #define GST_FLUMPEGSHIFTER_TYPE \
@@ -41,6 +42,16 @@ typedef struct _GstFluMPEGShifterClass GstFluMPEGShifterClass;
 struct _GstFluMPEGShifter
 {
   GstFluTSBase parent;
+
+  /* index shared with the indexer, used to find key units */
+  GstIndex *index;
+
+  /* index entries around the last offset converted to stream time,
+   * protected by the object lock */
+  guint64 span_l_offset;
+  guint64 span_h_offset;
+  GstClockTime span_l_time;
+  GstClockTime span_h_time;
 };
 
 struct _GstFluMPEGShifterClass
@@ -36,17 +36,29 @@ enum
   PROP_0,
   PROP_CACHE_SIZE,
   PROP_RECORDING_TEMPLATE,
+  PROP_WINDOW_DURATION,
+  PROP_STATS_INTERVAL,
   PROP_LAST
 };
 
 static void
 gst_flumpegshifter_bin_handle_message (GstBin * bin, GstMessage * msg);
+static GstPad *gst_flumpegshifter_bin_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_flumpegshifter_bin_release_pad (GstElement * element,
+    GstPad * pad);
 
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("video/mpegts"));
 
+static GstStaticPadTemplate requesttemplate =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("video/mpegts"));
+
 static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -69,6 +81,16 @@ gst_flumpegshifter_bin_set_property (GObject * object,
           "recording-template", value);
       break;
 
+    case PROP_WINDOW_DURATION:
+      g_object_set_property (G_OBJECT (ts_bin->timeshifter),
+          "window-duration", value);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      g_object_set_property (G_OBJECT (ts_bin->timeshifter),
+          "stats-interval", value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -92,6 +114,16 @@ gst_flumpegshifter_bin_get_property (GObject * object,
           "recording-template", value);
       break;
 
+    case PROP_WINDOW_DURATION:
+      g_object_get_property (G_OBJECT (ts_bin->timeshifter),
+          "window-duration", value);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      g_object_get_property (G_OBJECT (ts_bin->timeshifter),
+          "stats-interval", value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -125,12 +157,32 @@ gst_flumpegshifter_bin_class_init (GstFluMPEGShifterBinClass * klass)
           "and a prefix filename. (NULL == disabled)",
           NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_WINDOW_DURATION,
+      g_param_spec_uint64 ("window-duration", "Window duration",
+          "Keep this much of the stream at the bitrate measured by the "
+          "indexer, instead of cache-size (0 = disabled, in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Post the stats of the time shifter in a shifter-stats element "
+          "message at this interval (0 = disabled, in ns)",
+          0, G_MAXUINT64, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&srctemplate));
 
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&requesttemplate));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&sinktemplate));
 
+  gstelement_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_flumpegshifter_bin_request_new_pad);
+  gstelement_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_flumpegshifter_bin_release_pad);
+
   gstbin_class->handle_message =
       GST_DEBUG_FUNCPTR (gst_flumpegshifter_bin_handle_message);
 
@@ -188,6 +240,7 @@ gst_flumpegshifter_bin_init (GstFluMPEGShifterBin * ts_bin)
   GstIndex * index = gst_index_factory_make ("memindex");
   g_object_set (G_OBJECT (ts_bin->indexer), "index", index, NULL);
   g_object_set (G_OBJECT (ts_bin->seeker), "index", index, NULL);
+  g_object_set (G_OBJECT (ts_bin->timeshifter), "index", index, NULL);
   g_object_unref (index);
 
   mirror_pad (ts_bin->parser, "sink", bin);
@@ -200,6 +253,87 @@ error:
   gst_element_clear (&ts_bin->seeker);
 }
 
+/* Requests a src pad from the time shifter and ghosts it behind a seeker of
+ * its own, so each output is timestamped and seekable in time */
+static GstPad *
+gst_flumpegshifter_bin_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstFluMPEGShifterBin *ts_bin = GST_FLUMPEGSHIFTER_BIN (element);
+  GstElement *seeker;
+  GstPad *shifter_pad, *pad, *ghost_pad;
+  GstIndex *index = NULL;
+
+  shifter_pad = gst_element_get_request_pad (ts_bin->timeshifter,
+      name ? name : "src_%u");
+  if (!shifter_pad)
+    goto no_pad;
+
+  seeker = gst_element_factory_make ("timeshiftseeker", NULL);
+  if (!seeker)
+    goto no_seeker;
+
+  g_object_get (ts_bin->timeshifter, "index", &index, NULL);
+  g_object_set (seeker, "index", index, NULL);
+  if (index)
+    gst_object_unref (index);
+
+  gst_bin_add (GST_BIN (ts_bin), seeker);
+  pad = gst_element_get_static_pad (seeker, "sink");
+  gst_pad_link (shifter_pad, pad);
+  gst_object_unref (pad);
+
+  pad = gst_element_get_static_pad (seeker, "src");
+  ghost_pad = gst_ghost_pad_new_from_template (GST_PAD_NAME (shifter_pad),
+      pad, templ);
+  gst_object_unref (pad);
+
+  /* the ghost pad owns the requested pad until released */
+  g_object_set_data (G_OBJECT (ghost_pad), "flumpegshifter-seeker", seeker);
+  g_object_set_data_full (G_OBJECT (ghost_pad), "flumpegshifter-pad",
+      shifter_pad, gst_object_unref);
+
+  gst_element_sync_state_with_parent (seeker);
+  gst_element_add_pad (element, ghost_pad);
+
+  return ghost_pad;
+
+  /* ERRORS */
+no_pad:
+  {
+    GST_WARNING_OBJECT (ts_bin, "could not request a pad from the shifter");
+    return NULL;
+  }
+no_seeker:
+  {
+    GST_WARNING_OBJECT (ts_bin, "could not create a seeker");
+    gst_element_release_request_pad (ts_bin->timeshifter, shifter_pad);
+    gst_object_unref (shifter_pad);
+    return NULL;
+  }
+}
+
+static void
+gst_flumpegshifter_bin_release_pad (GstElement * element, GstPad * pad)
+{
+  GstFluMPEGShifterBin *ts_bin = GST_FLUMPEGSHIFTER_BIN (element);
+  GstElement *seeker;
+  GstPad *shifter_pad;
+
+  seeker = g_object_get_data (G_OBJECT (pad), "flumpegshifter-seeker");
+  shifter_pad = g_object_get_data (G_OBJECT (pad), "flumpegshifter-pad");
+  g_return_if_fail (seeker != NULL && shifter_pad != NULL);
+
+  /* stops the pushing of the output first */
+  gst_element_release_request_pad (ts_bin->timeshifter, shifter_pad);
+
+  gst_element_set_state (seeker, GST_STATE_NULL);
+  gst_bin_remove (GST_BIN (ts_bin), seeker);
+
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
 static void
 gst_flumpegshifter_bin_handle_message (GstBin * bin, GstMessage * msg)
 {
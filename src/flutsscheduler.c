@@ -0,0 +1,266 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-compat.h"
+#include "flutsscheduler.h"
+
+#include <stdlib.h>
+
+GST_DEBUG_CATEGORY_EXTERN (ts_flow);
+#define GST_CAT_DEFAULT (ts_flow)
+
+#define DEFAULT_THREADS 4
+
+typedef enum
+{
+  JOB_IDLE,
+  JOB_QUEUED,
+  JOB_RUNNING,
+  JOB_PENDING,                  /* queued again while running */
+  JOB_DELAYED                   /* waiting for its deadline */
+} JobState;
+
+static GThreadPool *pool = NULL;
+static GMutex *lock = NULL;     /* protects the state of the jobs */
+static GCond *cond = NULL;      /* signals a job became idle */
+static GList *timers = NULL;    /* delayed jobs by deadline */
+static GCond *timer_cond = NULL;        /* signals a new first deadline */
+
+static gint
+gst_flutsscheduler_compare_deadline (GstFluTSSchedulerJob * a,
+    GstFluTSSchedulerJob * b)
+{
+  if (a->deadline.tv_sec != b->deadline.tv_sec)
+    return a->deadline.tv_sec < b->deadline.tv_sec ? -1 : 1;
+  if (a->deadline.tv_usec != b->deadline.tv_usec)
+    return a->deadline.tv_usec < b->deadline.tv_usec ? -1 : 1;
+  return 0;
+}
+
+/* Queues the delayed jobs when they are due, so the workers never sleep */
+static gpointer
+gst_flutsscheduler_timer (gpointer data)
+{
+  g_mutex_lock (lock);
+  for (;;) {
+    GstFluTSSchedulerJob *job;
+    GTimeVal now;
+
+    if (timers == NULL) {
+      g_cond_wait (timer_cond, lock);
+      continue;
+    }
+    job = timers->data;
+    g_get_current_time (&now);
+    if (job->deadline.tv_sec > now.tv_sec ||
+        (job->deadline.tv_sec == now.tv_sec &&
+            job->deadline.tv_usec > now.tv_usec)) {
+      g_cond_timed_wait (timer_cond, lock, &job->deadline);
+      continue;
+    }
+    timers = g_list_delete_link (timers, timers);
+    job->state = JOB_QUEUED;
+    g_thread_pool_push (pool, job, NULL);
+  }
+  g_mutex_unlock (lock);
+
+  return NULL;
+}
+
+static void
+gst_flutsscheduler_run (GstFluTSSchedulerJob * job, gpointer user_data)
+{
+  g_mutex_lock (lock);
+  if (job->stopped) {
+    job->state = JOB_IDLE;
+    g_cond_broadcast (cond);
+    g_mutex_unlock (lock);
+    return;
+  }
+  job->state = JOB_RUNNING;
+  g_mutex_unlock (lock);
+
+  job->func (job->data);
+
+  g_mutex_lock (lock);
+  if (job->state == JOB_PENDING && !job->stopped) {
+    job->state = JOB_QUEUED;
+    g_thread_pool_push (pool, job, NULL);
+  } else if (job->delay && !job->stopped) {
+    job->state = JOB_DELAYED;
+    g_get_current_time (&job->deadline);
+    g_time_val_add (&job->deadline, job->delay);
+    timers = g_list_insert_sorted (timers, job,
+        (GCompareFunc) gst_flutsscheduler_compare_deadline);
+    if (timers->data == job)
+      g_cond_signal (timer_cond);
+  } else {
+    job->state = JOB_IDLE;
+  }
+  job->delay = 0;
+  g_cond_broadcast (cond);
+  g_mutex_unlock (lock);
+}
+
+static void
+gst_flutsscheduler_init (void)
+{
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized)) {
+    const gchar *env = g_getenv ("GST_FLUTS_SCHEDULER_THREADS");
+    gint threads = DEFAULT_THREADS;
+
+    if (env && atoi (env) > 0)
+      threads = atoi (env);
+
+    GST_INFO ("starting the shared scheduler with %d threads", threads);
+    lock = g_mutex_new ();
+    cond = g_cond_new ();
+    timer_cond = g_cond_new ();
+    g_thread_create (gst_flutsscheduler_timer, NULL, FALSE, NULL);
+    /* not exclusive, the workers are created on demand */
+    pool = g_thread_pool_new ((GFunc) gst_flutsscheduler_run, NULL, threads,
+        FALSE, NULL);
+    g_once_init_leave (&initialized, 1);
+  }
+}
+
+/**
+ * gst_flutsscheduler_job_init:
+ * @job: a #GstFluTSSchedulerJob
+ * @func: the work to do on every run
+ * @data: the argument of @func
+ *
+ * Initializes a stopped @job.
+ */
+void
+gst_flutsscheduler_job_init (GstFluTSSchedulerJob * job,
+    GstFluTSSchedulerFunc func, gpointer data)
+{
+  gst_flutsscheduler_init ();
+
+  job->func = func;
+  job->data = data;
+  job->state = JOB_IDLE;
+  job->stopped = TRUE;
+  job->delay = 0;
+}
+
+/**
+ * gst_flutsscheduler_job_start:
+ * @job: a #GstFluTSSchedulerJob
+ *
+ * Lets @job be queued again after gst_flutsscheduler_job_stop() and queues
+ * it.
+ */
+void
+gst_flutsscheduler_job_start (GstFluTSSchedulerJob * job)
+{
+  g_mutex_lock (lock);
+  job->stopped = FALSE;
+  g_mutex_unlock (lock);
+
+  gst_flutsscheduler_job_queue (job);
+}
+
+/**
+ * gst_flutsscheduler_job_queue:
+ * @job: a #GstFluTSSchedulerJob
+ *
+ * Makes @job run on a worker, once, unless it's stopped. Can be called from
+ * the job itself.
+ */
+void
+gst_flutsscheduler_job_queue (GstFluTSSchedulerJob * job)
+{
+  g_mutex_lock (lock);
+  if (!job->stopped) {
+    switch (job->state) {
+      case JOB_IDLE:
+        job->state = JOB_QUEUED;
+        g_thread_pool_push (pool, job, NULL);
+        break;
+      case JOB_RUNNING:
+        job->state = JOB_PENDING;
+        break;
+      default:
+        break;
+    }
+  }
+  g_mutex_unlock (lock);
+}
+
+/**
+ * gst_flutsscheduler_job_queue_delayed:
+ * @job: a #GstFluTSSchedulerJob
+ * @delay: microseconds to wait
+ *
+ * Makes @job run again @delay after the current run, unless it's stopped or
+ * queued meanwhile. Must be called from the job itself, which returns
+ * instead of waiting on the worker.
+ */
+void
+gst_flutsscheduler_job_queue_delayed (GstFluTSSchedulerJob * job, glong delay)
+{
+  g_mutex_lock (lock);
+  job->delay = MAX (delay, 1);
+  g_mutex_unlock (lock);
+}
+
+/**
+ * gst_flutsscheduler_job_join:
+ * @job: a #GstFluTSSchedulerJob
+ *
+ * Waits until @job is neither queued, delayed nor running. Must not be called
+ * from the job itself.
+ */
+void
+gst_flutsscheduler_job_join (GstFluTSSchedulerJob * job)
+{
+  g_mutex_lock (lock);
+  while (job->state != JOB_IDLE)
+    g_cond_wait (cond, lock);
+  g_mutex_unlock (lock);
+}
+
+/**
+ * gst_flutsscheduler_job_stop:
+ * @job: a #GstFluTSSchedulerJob
+ *
+ * Prevents @job from running again and waits for the current run to finish,
+ * a queued or delayed run is dropped. Must not be called from the job itself.
+ */
+void
+gst_flutsscheduler_job_stop (GstFluTSSchedulerJob * job)
+{
+  g_mutex_lock (lock);
+  job->stopped = TRUE;
+  if (job->state == JOB_DELAYED) {
+    timers = g_list_remove (timers, job);
+    job->state = JOB_IDLE;
+  }
+  while (job->state != JOB_IDLE)
+    g_cond_wait (cond, lock);
+  g_mutex_unlock (lock);
+}
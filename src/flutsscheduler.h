@@ -0,0 +1,69 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __FLUTSSCHEDULER_H__
+#define __FLUTSSCHEDULER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A pool of worker threads shared by all the instances of the process. Work
+ * is submitted as jobs: a job is queued at most once and never runs on two
+ * workers at the same time. A job queued while running runs again right
+ * after, at the end of the queue, so a job that does a bounded amount of
+ * work per run gets the workers in turn with the others. Jobs can do disk
+ * I/O but must not otherwise block the worker: one that has to wait asks to
+ * run again later instead.
+ *
+ * Only the disk work of the caches is run here. The output of every instance
+ * keeps a streaming thread of its own since gst_pad_push() blocks for as long
+ * as downstream wants, which would starve the other instances of the pool.
+ *
+ * The number of workers is read from the GST_FLUTS_SCHEDULER_THREADS
+ * environment variable when the pool is first used.
+ */
+
+typedef struct _GstFluTSSchedulerJob GstFluTSSchedulerJob;
+typedef void (*GstFluTSSchedulerFunc) (gpointer data);
+
+struct _GstFluTSSchedulerJob
+{
+  /*< private > */
+  GstFluTSSchedulerFunc func;
+  gpointer data;
+  gint state;
+  gboolean stopped;
+  GTimeVal deadline;            /* when a delayed run is due */
+  glong delay;                  /* requested by the running job, in us */
+};
+
+void gst_flutsscheduler_job_init (GstFluTSSchedulerJob * job,
+    GstFluTSSchedulerFunc func, gpointer data);
+void gst_flutsscheduler_job_start (GstFluTSSchedulerJob * job);
+void gst_flutsscheduler_job_queue (GstFluTSSchedulerJob * job);
+void gst_flutsscheduler_job_queue_delayed (GstFluTSSchedulerJob * job,
+    glong delay);
+void gst_flutsscheduler_job_join (GstFluTSSchedulerJob * job);
+void gst_flutsscheduler_job_stop (GstFluTSSchedulerJob * job);
+
+G_END_DECLS
+
+#endif /* __FLUTSSCHEDULER_H__ */
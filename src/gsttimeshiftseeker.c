@@ -60,6 +60,8 @@ gst_time_shift_seeker_query (GstBaseTransform *trans, GstPadDirection direction,
                              GstQuery *query);
 static GstFlowReturn
 gst_time_shift_seeker_transform_ip (GstBaseTransform * trans, GstBuffer * buf);
+static GstClockTime
+gst_time_shift_seeker_get_position (GstTimeShiftSeeker * seeker);
 
 enum
 {
@@ -128,6 +130,11 @@ gst_time_shift_seeker_class_init (GstTimeShiftSeekerClass * klass)
 static void
 gst_time_shift_seeker_init (GstTimeShiftSeeker * seeker)
 {
+  seeker->position = 0;
+  seeker->entry_offset = 0;
+  seeker->entry_time = GST_CLOCK_TIME_NONE;
+  seeker->next_offset = G_MAXUINT64;
+  seeker->next_time = GST_CLOCK_TIME_NONE;
 }
 
 static void
@@ -201,6 +208,13 @@ gst_time_shift_seeker_finalize (GObject * object)
 static gboolean
 gst_time_shift_seeker_start (GstBaseTransform * trans)
 {
+  GstTimeShiftSeeker *seeker = GST_TIME_SHIFT_SEEKER (trans);
+
+  gst_segment_init (&seeker->segment, GST_FORMAT_UNDEFINED);
+
+  GST_OBJECT_LOCK (seeker);
+  seeker->entry_time = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (seeker);
 
   return TRUE;
 }
@@ -260,31 +274,51 @@ gst_time_shift_seeker_transform_segment_event (GstTimeShiftSeeker *seeker,
     GST_DEBUG_OBJECT (seeker, "time shift seeker received non-bytes segment");
     goto beach;
   }
-  if (!(segment.flags & GST_SEGMENT_FLAG_RESET)) {
-    /* We can only handle flushing segments ATM as otherwise running time is >0
-       so filling in segment.base becomes trickier TODO: Fix this. */
-    GST_DEBUG_OBJECT (seeker, "time shift seeker can only deal with flushing "
-                              "seeks");
-    goto beach;
-  }
   if (!seeker->index) {
     GST_DEBUG_OBJECT (seeker, "no index");
     goto beach;
   }
 
-  segment.format = GST_FORMAT_TIME;
-  segment.base = 0;
-  segment.start = gst_time_shift_seeker_bytes_to_stream_time (seeker, segment.start);
-  if (segment.stop != -1) {
-    segment.stop = gst_time_shift_seeker_bytes_to_stream_time (seeker, segment.stop);
+  if (!(segment.flags & GST_SEGMENT_FLAG_RESET)) {
+    GstClockTime start;
+    gdouble rate = segment.rate;
+
+    /* A rate change in the middle of the playback, the new segment starts
+     * at the running time reached in the previous one */
+    if (seeker->segment.format != GST_FORMAT_TIME) {
+      GST_DEBUG_OBJECT (seeker, "no previous segment to update");
+      goto beach;
+    }
+    start = gst_time_shift_seeker_bytes_to_stream_time (seeker, segment.start);
+    if (!GST_CLOCK_TIME_IS_VALID (start))
+      goto beach;
+    start = MAX (start, seeker->segment.start);
+
+    segment = seeker->segment;
+    segment.base = gst_segment_to_running_time (&seeker->segment,
+        GST_FORMAT_TIME, start);
+    segment.start = start;
+    segment.time = start;
+    segment.position = start;
+    segment.rate = rate;
+    segment.flags &= ~GST_SEGMENT_FLAG_RESET;
+  } else {
+    segment.format = GST_FORMAT_TIME;
+    segment.base = 0;
+    segment.start = gst_time_shift_seeker_bytes_to_stream_time (seeker, segment.start);
+    if (segment.stop != -1) {
+      segment.stop = gst_time_shift_seeker_bytes_to_stream_time (seeker, segment.stop);
+    }
+    segment.time = segment.start;
   }
-  segment.time = segment.start;
+  seeker->segment = segment;
 
   newevent = gst_event_new_segment(&segment);
   gst_event_set_seqnum (newevent, gst_event_get_seqnum (*event));
   gst_event_replace (event, newevent);
 
   seeker->timestamp_next_buffer = TRUE;
+  seeker->trick_play = segment.rate > 1.0 || segment.rate < 0.0;
 
   GST_DEBUG_OBJECT (seeker, "forwarding segment %" GST_SEGMENT_FORMAT, &segment);
 beach:
@@ -432,11 +466,6 @@ gst_time_shift_seeker_transform_seek_event (GstTimeShiftSeeker * seeker, GstEven
     goto beach;
   }
 
-  if (rate < 0.0) {
-    GST_WARNING_OBJECT (seeker, "we only support forward playback");
-    goto beach;
-  }
-
   gst_time_shift_seeker_transform_offset(seeker, &start_type, &start);
   gst_time_shift_seeker_transform_offset(seeker, &stop_type, &stop);
   new_event = gst_event_new_seek(rate, GST_FORMAT_BYTES, flags, start_type,
@@ -448,6 +477,63 @@ beach:
   return;
 }
 
+static gboolean
+gst_time_shift_seeker_time_to_bytes (GstTimeShiftSeeker * seeker,
+    GstIndexLookupMethod method, guint64 time, guint64 * bytes)
+{
+  GstIndexEntry *entry;
+  gint64 offset;
+
+  entry = gst_index_get_assoc_entry (seeker->index, method,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_TIME, time);
+  if (!entry)
+    return FALSE;
+
+  gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &offset);
+  *bytes = offset;
+  return TRUE;
+}
+
+/* Fills in the byte range of a shifter-export event given in stream time so
+ * the exported file starts before and ends after the requested times */
+static void
+gst_time_shift_seeker_transform_export_event (GstTimeShiftSeeker * seeker,
+    GstEvent ** event)
+{
+  GstStructure *stru;
+  guint64 time, bytes;
+
+  if (!gst_event_has_name (*event, "shifter-export"))
+    goto beach;
+
+  if (!seeker->index) {
+    GST_DEBUG_OBJECT (seeker, "no index");
+    goto beach;
+  }
+
+  *event = gst_event_make_writable (*event);
+  stru = gst_event_writable_structure (*event);
+
+  if (gst_structure_get_uint64 (stru, "start-time", &time)) {
+    if (!gst_time_shift_seeker_time_to_bytes (seeker, GST_INDEX_LOOKUP_BEFORE,
+            time, &bytes))
+      bytes = 0;
+    gst_structure_set (stru, "start", G_TYPE_UINT64, bytes, NULL);
+    gst_structure_remove_field (stru, "start-time");
+  }
+  if (gst_structure_get_uint64 (stru, "stop-time", &time)) {
+    if (!gst_time_shift_seeker_time_to_bytes (seeker, GST_INDEX_LOOKUP_AFTER,
+            time, &bytes))
+      bytes = G_MAXUINT64;
+    gst_structure_set (stru, "stop", G_TYPE_UINT64, bytes, NULL);
+    gst_structure_remove_field (stru, "stop-time");
+  }
+
+  GST_DEBUG_OBJECT (seeker, "forwarding export %" GST_PTR_FORMAT, stru);
+beach:
+  return;
+}
+
 static gboolean
 gst_time_shift_seeker_src_event (GstBaseTransform * trans, GstEvent * event)
 {
@@ -455,10 +541,88 @@ gst_time_shift_seeker_src_event (GstBaseTransform * trans, GstEvent * event)
 
   if (GST_EVENT_TYPE(event) == GST_EVENT_SEEK) {
     gst_time_shift_seeker_transform_seek_event (seeker, &event);
+  } else if (GST_EVENT_TYPE(event) == GST_EVENT_CUSTOM_UPSTREAM) {
+    gst_time_shift_seeker_transform_export_event (seeker, &event);
   }
   return GST_BASE_TRANSFORM_CLASS (parent_class)->src_event (trans, event);
 }
 
+/* Time of the index entry at or before @offset, 0 before the first one */
+static gint64
+gst_time_shift_seeker_offset_to_time (GstTimeShiftSeeker * seeker,
+    guint64 offset)
+{
+  GstIndexEntry *entry;
+  gint64 time = 0;
+
+  entry = gst_index_get_assoc_entry (seeker->index, GST_INDEX_LOOKUP_BEFORE,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, offset);
+  if (entry)
+    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &time);
+
+  return time;
+}
+
+/* Answers a buffering query in time with the byte ranges of the
+ * timeshifter converted through the index */
+static gboolean
+gst_time_shift_seeker_query_buffering (GstTimeShiftSeeker * seeker,
+    GstQuery * query)
+{
+  GstBaseTransform *base = GST_BASE_TRANSFORM (seeker);
+  GstQuery *bquery;
+  const GstStructure *bs;
+  GstStructure *s;
+  GstBufferingMode mode;
+  gboolean busy;
+  gint percent, avg_in, avg_out;
+  gint64 left, start, stop;
+  guint64 value;
+  guint i, n;
+
+  bquery = gst_query_new_buffering (GST_FORMAT_BYTES);
+  if (!gst_pad_peer_query (base->sinkpad, bquery)) {
+    gst_query_unref (bquery);
+    return FALSE;
+  }
+
+  gst_query_parse_buffering_percent (bquery, &busy, &percent);
+  gst_query_set_buffering_percent (query, busy, percent);
+  gst_query_parse_buffering_stats (bquery, &mode, &avg_in, &avg_out, &left);
+  gst_query_set_buffering_stats (query, mode, avg_in, avg_out, left);
+  gst_query_parse_buffering_range (bquery, NULL, &start, &stop, NULL);
+  gst_query_set_buffering_range (query, GST_FORMAT_TIME,
+      gst_time_shift_seeker_offset_to_time (seeker, start),
+      gst_time_shift_seeker_offset_to_time (seeker, stop), -1);
+
+  n = gst_query_get_n_buffering_ranges (bquery);
+  for (i = 0; i < n; i++) {
+    gst_query_parse_nth_buffering_range (bquery, i, &start, &stop);
+    gst_query_add_buffering_range (query,
+        gst_time_shift_seeker_offset_to_time (seeker, start),
+        gst_time_shift_seeker_offset_to_time (seeker, stop));
+  }
+
+  /* the ranges of each tier of the cache */
+  bs = gst_query_get_structure (bquery);
+  s = gst_query_writable_structure (query);
+  if (gst_structure_get_uint64 (bs, "ring-start", &value))
+    gst_structure_set (s, "ring-start", G_TYPE_UINT64,
+        gst_time_shift_seeker_offset_to_time (seeker, value), NULL);
+  if (gst_structure_get_uint64 (bs, "ring-stop", &value))
+    gst_structure_set (s, "ring-stop", G_TYPE_UINT64,
+        gst_time_shift_seeker_offset_to_time (seeker, value), NULL);
+  if (gst_structure_get_uint64 (bs, "disk-start", &value))
+    gst_structure_set (s, "disk-start", G_TYPE_UINT64,
+        gst_time_shift_seeker_offset_to_time (seeker, value), NULL);
+  if (gst_structure_get_uint64 (bs, "disk-stop", &value))
+    gst_structure_set (s, "disk-stop", G_TYPE_UINT64,
+        gst_time_shift_seeker_offset_to_time (seeker, value), NULL);
+
+  gst_query_unref (bquery);
+  return TRUE;
+}
+
 static gboolean
 gst_time_shift_seeker_query (GstBaseTransform *base, GstPadDirection direction,
                              GstQuery *query)
@@ -466,17 +630,36 @@ gst_time_shift_seeker_query (GstBaseTransform *base, GstPadDirection direction,
   GstTimeShiftSeeker * ts = GST_TIME_SHIFT_SEEKER (base);
 
   switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_POSITION:
+    {
+      GstFormat format;
+      GstClockTime position;
+
+      gst_query_parse_position (query, &format, NULL);
+      if (format == GST_FORMAT_TIME && direction == GST_PAD_SRC) {
+        position = gst_time_shift_seeker_get_position (ts);
+        if (!GST_CLOCK_TIME_IS_VALID (position))
+          break;
+        gst_query_set_position (query, format, position);
+        return TRUE;
+      }
+      break;
+    }
     case GST_QUERY_DURATION:
     {
       GstFormat format;
+      GstClockTime last = GST_CLOCK_TIME_NONE;
 
       gst_query_parse_duration(query, &format, NULL);
       if (format == GST_FORMAT_TIME && direction == GST_PAD_SRC) {
-        GST_DEBUG_OBJECT (base, "Responding to duration query with time  %" GST_TIME_FORMAT,
-          GST_TIME_ARGS (gst_time_shift_seeker_get_last_time(ts)));
-
-        gst_query_set_duration(query, format,
-              gst_time_shift_seeker_get_last_time(ts));
+        /* the live edge, kept by the index as entries are added */
+        if (!ts->index ||
+            !gst_flutsindex_get_bounds (ts->index, NULL, &last, NULL))
+          return FALSE;
+        GST_LOG_OBJECT (base, "Responding to duration query with time  %"
+            GST_TIME_FORMAT, GST_TIME_ARGS (last));
+
+        gst_query_set_duration(query, format, last);
         return TRUE;
       }
       break;
@@ -484,14 +667,29 @@ gst_time_shift_seeker_query (GstBaseTransform *base, GstPadDirection direction,
     case GST_QUERY_SEEKING:
     {
       GstFormat fmt;
+      GstClockTime first = GST_CLOCK_TIME_NONE, last = GST_CLOCK_TIME_NONE;
 
       gst_query_parse_seeking (query, &fmt, NULL, NULL, NULL);
       if (fmt == GST_FORMAT_TIME) {
-        gst_query_set_seeking (query, fmt, TRUE, 0, -1);
+        if (!ts->index ||
+            !gst_flutsindex_get_bounds (ts->index, &first, &last, NULL)) {
+          first = 0;
+          last = GST_CLOCK_TIME_NONE;
+        }
+        gst_query_set_seeking (query, fmt, TRUE, first, last);
         return TRUE;
       }
       break;
     }
+    case GST_QUERY_BUFFERING:
+    {
+      GstFormat format;
+
+      gst_query_parse_buffering_range (query, &format, NULL, NULL, NULL);
+      if (format == GST_FORMAT_TIME && direction == GST_PAD_SRC && ts->index)
+        return gst_time_shift_seeker_query_buffering (ts, query);
+      break;
+    }
     default:
       break;
   }
@@ -499,15 +697,101 @@ gst_time_shift_seeker_query (GstBaseTransform *base, GstPadDirection direction,
                                                          query);
 }
 
+/* Tracks the output position, the index is only looked up when the buffer
+ * is out of the entries we know of or a new entry was added after the last
+ * one we know of. Past the last entry the bounds of the index are enough. */
+static void
+gst_time_shift_seeker_update_position (GstTimeShiftSeeker * seeker,
+    guint64 offset)
+{
+  GstIndexEntry *entry;
+  gint64 e_offset = 0, e_time = 0, n_offset = -1, n_time = -1;
+  GstClockTime last_time = GST_CLOCK_TIME_NONE;
+  guint64 last_offset = 0;
+  gboolean lookup;
+
+  if (!seeker->index || offset == GST_BUFFER_OFFSET_NONE)
+    return;
+
+  gst_flutsindex_get_bounds (seeker->index, NULL, &last_time, &last_offset);
+
+  GST_OBJECT_LOCK (seeker);
+  seeker->position = offset;
+  lookup = !GST_CLOCK_TIME_IS_VALID (seeker->entry_time) ||
+      offset < seeker->entry_offset || offset >= seeker->next_offset ||
+      (seeker->next_offset == G_MAXUINT64 &&
+      last_offset > seeker->entry_offset);
+  GST_OBJECT_UNLOCK (seeker);
+
+  if (G_LIKELY (!lookup))
+    return;
+
+  if (GST_CLOCK_TIME_IS_VALID (last_time) && offset >= last_offset) {
+    /* at the live edge */
+    GST_OBJECT_LOCK (seeker);
+    seeker->entry_offset = last_offset;
+    seeker->entry_time = last_time;
+    seeker->next_offset = G_MAXUINT64;
+    seeker->next_time = GST_CLOCK_TIME_NONE;
+    GST_OBJECT_UNLOCK (seeker);
+    return;
+  }
+
+  entry = gst_index_get_assoc_entry (seeker->index, GST_INDEX_LOOKUP_BEFORE,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, offset);
+  if (entry) {
+    gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &e_offset);
+    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &e_time);
+  }
+  entry = gst_index_get_assoc_entry (seeker->index, GST_INDEX_LOOKUP_AFTER,
+      GST_ASSOCIATION_FLAG_NONE, GST_FORMAT_BYTES, e_offset + 1);
+  if (entry) {
+    gst_index_entry_assoc_map (entry, GST_FORMAT_BYTES, &n_offset);
+    gst_index_entry_assoc_map (entry, GST_FORMAT_TIME, &n_time);
+  }
+
+  GST_OBJECT_LOCK (seeker);
+  seeker->entry_offset = e_offset;
+  seeker->entry_time = e_time;
+  seeker->next_offset = entry ? n_offset : G_MAXUINT64;
+  seeker->next_time = entry ? n_time : GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (seeker);
+}
+
+/* Stream time of the last buffer pushed, interpolated between the index
+ * entries around it */
+static GstClockTime
+gst_time_shift_seeker_get_position (GstTimeShiftSeeker * seeker)
+{
+  GstClockTime time;
+
+  GST_OBJECT_LOCK (seeker);
+  time = seeker->entry_time;
+  if (GST_CLOCK_TIME_IS_VALID (time) &&
+      GST_CLOCK_TIME_IS_VALID (seeker->next_time) &&
+      seeker->next_time > time && seeker->next_offset > seeker->entry_offset &&
+      seeker->position > seeker->entry_offset) {
+    time += gst_util_uint64_scale (seeker->next_time - time,
+        seeker->position - seeker->entry_offset,
+        seeker->next_offset - seeker->entry_offset);
+  }
+  GST_OBJECT_UNLOCK (seeker);
+
+  return time;
+}
+
 static GstFlowReturn
 gst_time_shift_seeker_transform_ip (GstBaseTransform * base, GstBuffer * buf)
 {
   GstTimeShiftSeeker * seeker = GST_TIME_SHIFT_SEEKER (base);
   g_assert (gst_buffer_is_writable (buf));
-  if (seeker->timestamp_next_buffer) {
+  /* in trick play every key unit comes after a discontinuity */
+  if (seeker->timestamp_next_buffer || (seeker->trick_play &&
+          GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT))) {
     GST_BUFFER_TIMESTAMP (buf) = gst_time_shift_seeker_bytes_to_stream_time(
         seeker, GST_BUFFER_OFFSET (buf));
     seeker->timestamp_next_buffer = FALSE;
   }
+  gst_time_shift_seeker_update_position (seeker, GST_BUFFER_OFFSET (buf));
   return GST_FLOW_OK;
 }
@@ -41,7 +41,19 @@ struct _GstTimeShiftSeeker
   /* Generated Index */
   GstIndex *index;
 
+  /* last segment pushed downstream */
+  GstSegment segment;
+
   gboolean timestamp_next_buffer;
+  gboolean trick_play;
+
+  /* output position, between the index entries around the last buffer
+   * pushed. Protected by the object lock */
+  guint64 position;
+  guint64 entry_offset;
+  GstClockTime entry_time;
+  guint64 next_offset;          /* G_MAXUINT64 if not indexed yet */
+  GstClockTime next_time;
 };
 
 struct _GstTimeShiftSeekerClass
@@ -0,0 +1,478 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:gsttimeshifttracer
+ *
+ * Logs for every buffer pushed by a time shifter how long ago its data came
+ * in (delay), how long the output waited for it in the shifter since the
+ * previous push (wait, the ring buffer and disk round trip) and how long
+ * downstream took with it (downstream). The time spent in the chain function
+ * is logged for the incoming buffers (ingest), the output waiting more than
+ * STALL_THRESHOLD is logged as a stall with the reloads and underruns that
+ * happened meanwhile, and the fill of the ring buffer and disk is sampled
+ * every FILL_INTERVAL.
+ *
+ * Enable with GST_TRACERS=timeshift GST_DEBUG=GST_TRACER:7. Only the
+ * pushing mode is traced.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gsttimeshifttracer.h"
+
+#ifdef HAVE_TIME_SHIFT_TRACER
+
+#include "flutsbase.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_time_shift_tracer_debug);
+#define GST_CAT_DEFAULT gst_time_shift_tracer_debug
+
+/* the ingest time is kept for the data coming in this far apart */
+#define MARK_INTERVAL              (10 * GST_MSECOND)
+
+/* ingest times kept per time shifter, about 1h30 */
+#define MARK_MAX                   (1 << 19)
+
+/* waits of the output logged as stalls */
+#define STALL_THRESHOLD            (20 * GST_MSECOND)
+
+/* period of the fill samples */
+#define FILL_INTERVAL              (100 * GST_MSECOND)
+
+#define gst_time_shift_tracer_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstTimeShiftTracer, gst_time_shift_tracer,
+    GST_TYPE_TRACER, GST_DEBUG_CATEGORY_INIT (gst_time_shift_tracer_debug,
+        "timeshifttracer", 0, "Time shift tracer"));
+
+typedef struct
+{
+  guint64 offset;               /* first byte received at @time */
+  GstClockTime time;
+} IngestMark;
+
+/* state of a time shifter, shared by the streaming threads of its pads */
+typedef struct
+{
+  GMutex *lock;
+  GArray *marks;                /* by cache offset */
+  GstClockTime fill_time;       /* last fill sample */
+  guint64 reloads;              /* counters at the last stall */
+  guint64 underruns;
+} ShifterTrace;
+
+/* state of a pad pushing to or from a time shifter, only used by its
+ * streaming thread */
+typedef struct
+{
+  GstClockTime push_start;
+  GstClockTime push_end;
+  GstClockTime delay;           /* of the buffer being pushed */
+  GstClockTime wait;
+} PadTrace;
+
+static GQuark shifter_quark;
+static GQuark pad_quark;
+
+static GstTracerRecord *tr_delay;
+static GstTracerRecord *tr_ingest;
+static GstTracerRecord *tr_stall;
+static GstTracerRecord *tr_fill;
+
+static void
+shifter_trace_free (ShifterTrace * trace)
+{
+  g_mutex_free (trace->lock);
+  g_array_free (trace->marks, TRUE);
+  g_free (trace);
+}
+
+static void
+shifter_trace_reset (ShifterTrace * trace)
+{
+  g_mutex_lock (trace->lock);
+  g_array_set_size (trace->marks, 0);
+  trace->fill_time = GST_CLOCK_TIME_NONE;
+  trace->reloads = 0;
+  trace->underruns = 0;
+  g_mutex_unlock (trace->lock);
+}
+
+static PadTrace *
+pad_trace_get (GstPad * pad)
+{
+  PadTrace *pt = g_object_get_qdata (G_OBJECT (pad), pad_quark);
+
+  if (G_UNLIKELY (!pt)) {
+    pt = g_new0 (PadTrace, 1);
+    pt->push_end = GST_CLOCK_TIME_NONE;
+    pt->delay = GST_CLOCK_TIME_NONE;
+    g_object_set_qdata_full (G_OBJECT (pad), pad_quark, pt, g_free);
+  }
+  return pt;
+}
+
+/* the time shifter whose src pad is @pad */
+static GstElement *
+get_output_shifter (GstPad * pad)
+{
+  GstObject *parent = GST_OBJECT_PARENT (pad);
+
+  if (parent && GST_IS_FLUTSBASE (parent) && GST_PAD_IS_SRC (pad))
+    return GST_ELEMENT_CAST (parent);
+  return NULL;
+}
+
+/* the time shifter @pad pushes to */
+static GstElement *
+get_input_shifter (GstPad * pad)
+{
+  GstPad *peer = GST_PAD_PEER (pad);
+  GstObject *parent;
+
+  if (!peer)
+    return NULL;
+  parent = GST_OBJECT_PARENT (peer);
+  if (parent && GST_IS_FLUTSBASE (parent))
+    return GST_ELEMENT_CAST (parent);
+  return NULL;
+}
+
+/* Time when the data at @offset came in, the last mark at or before it */
+static GstClockTime
+shifter_trace_lookup (ShifterTrace * trace, guint64 offset)
+{
+  guint low = 0, high = trace->marks->len, mid;
+
+  while (low < high) {
+    mid = (low + high) / 2;
+    if (g_array_index (trace->marks, IngestMark, mid).offset <= offset)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  if (low == 0)
+    return GST_CLOCK_TIME_NONE;
+  return g_array_index (trace->marks, IngestMark, low - 1).time;
+}
+
+/* Marks the data the cache took at @offset as come in at @ts */
+static void
+shifter_trace_ingest (ShifterTrace * trace, GstClockTime ts, guint64 offset)
+{
+  IngestMark *last = NULL;
+
+  g_mutex_lock (trace->lock);
+  if (trace->marks->len)
+    last = &g_array_index (trace->marks, IngestMark, trace->marks->len - 1);
+  if (!last || (ts >= last->time + MARK_INTERVAL && offset > last->offset)) {
+    IngestMark mark = { offset, ts };
+
+    /* drop the oldest half at once to keep the appends cheap */
+    if (trace->marks->len == MARK_MAX)
+      g_array_remove_range (trace->marks, 0, MARK_MAX / 2);
+    g_array_append_val (trace->marks, mark);
+  }
+  g_mutex_unlock (trace->lock);
+}
+
+/* Logs the stall and the fill of the cache of @shifter, from the thread
+ * pushing its output. The samples are read without taking the locks of the
+ * time shifter, the cache is only replaced while this thread is stopped */
+static void
+shifter_trace_sample (GstElement * shifter, ShifterTrace * trace,
+    GstClockTime stall, gboolean fill)
+{
+  GstFluTSBase *ts = GST_FLUTSBASE (shifter);
+  GstFluTSBaseCounters counters;
+  guint64 reloads, underruns, ring_fill, ring_size, disk_fill;
+
+  if (!ts->cache)
+    return;
+  gst_shifter_cache_get_levels (ts->cache, &ring_fill, &ring_size,
+      &disk_fill, &reloads);
+  gst_flutsbase_get_counters (ts, &counters);
+  underruns = counters.underruns;
+
+  if (GST_CLOCK_TIME_IS_VALID (stall)) {
+    guint64 new_reloads, new_underruns;
+
+    g_mutex_lock (trace->lock);
+    new_reloads = reloads - MIN (trace->reloads, reloads);
+    new_underruns = underruns - MIN (trace->underruns, underruns);
+    trace->reloads = reloads;
+    trace->underruns = underruns;
+    g_mutex_unlock (trace->lock);
+
+    gst_tracer_record_log (tr_stall, GST_OBJECT_NAME (shifter), stall,
+        new_reloads, new_underruns);
+  }
+  if (fill) {
+    gst_tracer_record_log (tr_fill, GST_OBJECT_NAME (shifter), ring_fill,
+        ring_size, disk_fill);
+  }
+}
+
+static void
+do_output_pre (GstElement * shifter, GstPad * pad, GstClockTime ts,
+    GstBuffer * buffer)
+{
+  ShifterTrace *trace = g_object_get_qdata (G_OBJECT (shifter), shifter_quark);
+  PadTrace *pt = pad_trace_get (pad);
+  GstClockTime stall = GST_CLOCK_TIME_NONE;
+  GstClockTime time = GST_CLOCK_TIME_NONE;
+  gboolean fill = FALSE;
+
+  if (!trace)
+    return;
+
+  g_mutex_lock (trace->lock);
+  if (GST_BUFFER_OFFSET_IS_VALID (buffer))
+    time = shifter_trace_lookup (trace, GST_BUFFER_OFFSET (buffer));
+  if (!GST_CLOCK_TIME_IS_VALID (trace->fill_time) ||
+      ts >= trace->fill_time + FILL_INTERVAL) {
+    trace->fill_time = ts;
+    fill = TRUE;
+  }
+  g_mutex_unlock (trace->lock);
+
+  pt->delay = GST_CLOCK_TIME_IS_VALID (time) ? ts - time : GST_CLOCK_TIME_NONE;
+  pt->wait = GST_CLOCK_TIME_IS_VALID (pt->push_end) ? ts - pt->push_end : 0;
+  if (pt->wait >= STALL_THRESHOLD)
+    stall = pt->wait;
+
+  pt->push_start = ts;
+
+  if (GST_CLOCK_TIME_IS_VALID (stall) || fill) {
+    GstClockTime start = gst_util_get_timestamp ();
+
+    shifter_trace_sample (shifter, trace, stall, fill);
+    /* the sampling isn't accounted to downstream */
+    pt->push_start += gst_util_get_timestamp () - start;
+  }
+}
+
+static void
+do_output_post (GstElement * shifter, GstPad * pad, GstClockTime ts)
+{
+  PadTrace *pt = pad_trace_get (pad);
+
+  if (GST_CLOCK_TIME_IS_VALID (pt->delay)) {
+    gst_tracer_record_log (tr_delay, GST_OBJECT_NAME (shifter),
+        GST_OBJECT_NAME (pad), pt->delay, pt->wait, ts - pt->push_start);
+  }
+  pt->push_end = ts;
+}
+
+static void
+do_push_buffer_pre (GstTracer * self, GstClockTime ts, GstPad * pad,
+    GstBuffer * buffer)
+{
+  GstElement *shifter;
+
+  if ((shifter = get_output_shifter (pad))) {
+    do_output_pre (shifter, pad, ts, buffer);
+  } else if ((shifter = get_input_shifter (pad))) {
+    if (g_object_get_qdata (G_OBJECT (shifter), shifter_quark))
+      pad_trace_get (pad)->push_start = ts;
+  }
+}
+
+static void
+do_push_buffer_list_pre (GstTracer * self, GstClockTime ts, GstPad * pad,
+    GstBufferList * list)
+{
+  GstElement *shifter;
+
+  /* the time shifters push single buffers */
+  if (!(shifter = get_input_shifter (pad)))
+    return;
+  if (g_object_get_qdata (G_OBJECT (shifter), shifter_quark))
+    pad_trace_get (pad)->push_start = ts;
+}
+
+static void
+do_push_buffer_post (GstTracer * self, GstClockTime ts, GstPad * pad,
+    GstFlowReturn res)
+{
+  GstElement *shifter;
+  ShifterTrace *trace;
+  guint64 offset;
+
+  if ((shifter = get_output_shifter (pad))) {
+    do_output_post (shifter, pad, ts);
+  } else if ((shifter = get_input_shifter (pad))) {
+    trace = g_object_get_qdata (G_OBJECT (shifter), shifter_quark);
+    if (trace) {
+      PadTrace *pt = pad_trace_get (pad);
+
+      /* set by the chain function we come back from, on this thread */
+      offset = gst_flutsbase_get_ingest_offset (GST_FLUTSBASE (shifter));
+      if (offset != GST_BUFFER_OFFSET_NONE)
+        shifter_trace_ingest (trace, pt->push_start, offset);
+      gst_tracer_record_log (tr_ingest, GST_OBJECT_NAME (shifter),
+          ts - pt->push_start);
+    }
+  }
+}
+
+static void
+do_push_event_pre (GstTracer * self, GstClockTime ts, GstPad * pad,
+    GstEvent * event)
+{
+  GstElement *shifter;
+  ShifterTrace *trace;
+
+  /* the offsets start over with the cache created on flush-stop */
+  if (GST_EVENT_TYPE (event) != GST_EVENT_FLUSH_STOP ||
+      !(shifter = get_input_shifter (pad)))
+    return;
+
+  trace = g_object_get_qdata (G_OBJECT (shifter), shifter_quark);
+  if (trace)
+    shifter_trace_reset (trace);
+}
+
+static void
+do_element_new (GstTracer * self, GstClockTime ts, GstElement * element)
+{
+  ShifterTrace *trace;
+
+  if (!GST_IS_FLUTSBASE (element))
+    return;
+
+  trace = g_new0 (ShifterTrace, 1);
+  trace->lock = g_mutex_new ();
+  trace->marks = g_array_new (FALSE, FALSE, sizeof (IngestMark));
+  trace->fill_time = GST_CLOCK_TIME_NONE;
+  g_object_set_qdata_full (G_OBJECT (element), shifter_quark, trace,
+      (GDestroyNotify) shifter_trace_free);
+  GST_DEBUG_OBJECT (element, "tracing time shifter");
+}
+
+static void
+do_element_change_state_pre (GstTracer * self, GstClockTime ts,
+    GstElement * element, GstStateChange transition)
+{
+  ShifterTrace *trace;
+
+  /* the offsets start over with the new cache */
+  if (transition != GST_STATE_CHANGE_READY_TO_PAUSED ||
+      !GST_IS_FLUTSBASE (element))
+    return;
+
+  trace = g_object_get_qdata (G_OBJECT (element), shifter_quark);
+  if (trace)
+    shifter_trace_reset (trace);
+}
+
+static GstStructure *
+gst_time_shift_tracer_scope (GstTracerValueScope scope)
+{
+  return gst_structure_new ("scope",
+      "type", G_TYPE_GTYPE, G_TYPE_STRING,
+      "related-to", GST_TYPE_TRACER_VALUE_SCOPE, scope, NULL);
+}
+
+static GstStructure *
+gst_time_shift_tracer_value (const gchar * description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, G_TYPE_UINT64,
+      "description", G_TYPE_STRING, description,
+      "flags", GST_TYPE_TRACER_VALUE_FLAGS, GST_TRACER_VALUE_FLAGS_NONE,
+      "min", G_TYPE_UINT64, G_GUINT64_CONSTANT (0),
+      "max", G_TYPE_UINT64, G_MAXUINT64, NULL);
+}
+
+static void
+gst_time_shift_tracer_class_init (GstTimeShiftTracerClass * klass)
+{
+  shifter_quark = g_quark_from_static_string ("timeshift-tracer-shifter");
+  pad_quark = g_quark_from_static_string ("timeshift-tracer-pad");
+
+  tr_delay = gst_tracer_record_new ("timeshift-delay.class",
+      "element", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_scope (GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "pad", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_scope (GST_TRACER_VALUE_SCOPE_PAD),
+      "delay", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("time since the data came in (ns)"),
+      "wait", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("time waited for the data in the time "
+          "shifter since the previous push (ns)"),
+      "downstream", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("time taken by downstream (ns)"), NULL);
+
+  tr_ingest = gst_tracer_record_new ("timeshift-ingest.class",
+      "element", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_scope (GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "ingest", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("time taken to add the data to the "
+          "cache (ns)"), NULL);
+
+  tr_stall = gst_tracer_record_new ("timeshift-stall.class",
+      "element", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_scope (GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "duration", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("time the output waited (ns)"),
+      "reloads", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("reloads from the disk since the "
+          "previous stall"),
+      "underruns", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("underruns since the previous stall"),
+      NULL);
+
+  tr_fill = gst_tracer_record_new ("timeshift-fill.class",
+      "element", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_scope (GST_TRACER_VALUE_SCOPE_ELEMENT),
+      "ring-fill", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("data in the full slots of the ring "
+          "buffer (bytes)"),
+      "ring-size", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("size of the ring buffer (bytes)"),
+      "disk-fill", GST_TYPE_STRUCTURE,
+      gst_time_shift_tracer_value ("data recorded on the disk (bytes)"),
+      NULL);
+}
+
+static void
+gst_time_shift_tracer_init (GstTimeShiftTracer * self)
+{
+  GstTracer *tracer = GST_TRACER (self);
+
+  gst_tracing_register_hook (tracer, "element-new",
+      G_CALLBACK (do_element_new));
+  gst_tracing_register_hook (tracer, "element-change-state-pre",
+      G_CALLBACK (do_element_change_state_pre));
+  gst_tracing_register_hook (tracer, "pad-push-pre",
+      G_CALLBACK (do_push_buffer_pre));
+  gst_tracing_register_hook (tracer, "pad-push-list-pre",
+      G_CALLBACK (do_push_buffer_list_pre));
+  gst_tracing_register_hook (tracer, "pad-push-post",
+      G_CALLBACK (do_push_buffer_post));
+  gst_tracing_register_hook (tracer, "pad-push-list-post",
+      G_CALLBACK (do_push_buffer_post));
+  gst_tracing_register_hook (tracer, "pad-push-event-pre",
+      G_CALLBACK (do_push_event_pre));
+}
+
+#endif /* HAVE_TIME_SHIFT_TRACER */
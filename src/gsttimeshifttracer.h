@@ -0,0 +1,61 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_TIME_SHIFT_TRACER_H__
+#define __GST_TIME_SHIFT_TRACER_H__
+
+#include <gst/gst.h>
+
+/* the tracing hooks are public since 1.8 */
+#if GST_CHECK_VERSION (1, 8, 0) && !defined (GST_DISABLE_GST_TRACER_HOOKS)
+#define HAVE_TIME_SHIFT_TRACER 1
+#endif
+
+#ifdef HAVE_TIME_SHIFT_TRACER
+
+G_BEGIN_DECLS
+#define GST_TYPE_TIME_SHIFT_TRACER \
+  (gst_time_shift_tracer_get_type())
+#define GST_TIME_SHIFT_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_TIME_SHIFT_TRACER,GstTimeShiftTracer))
+#define GST_TIME_SHIFT_TRACER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_TIME_SHIFT_TRACER,GstTimeShiftTracerClass))
+#define GST_IS_TIME_SHIFT_TRACER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_TIME_SHIFT_TRACER))
+typedef struct _GstTimeShiftTracer GstTimeShiftTracer;
+typedef struct _GstTimeShiftTracerClass GstTimeShiftTracerClass;
+
+/* Follows the data of the time shifters from their sink pad to their src
+ * pads and logs how long it stayed, how long each part of the trip took and
+ * how full the cache was. */
+struct _GstTimeShiftTracer
+{
+  GstTracer parent;
+};
+
+struct _GstTimeShiftTracerClass
+{
+  GstTracerClass parent_class;
+};
+
+GType gst_time_shift_tracer_get_type (void);
+
+G_END_DECLS
+#endif /* HAVE_TIME_SHIFT_TRACER */
+#endif /* __GST_TIME_SHIFT_TRACER_H__ */
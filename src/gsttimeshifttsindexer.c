@@ -320,29 +320,35 @@ is_next_sync_valid (const guint8 * in_data, guint size, guint offset)
 }
 
 static inline void
-add_index_entry (GstTimeShiftTsIndexer * base, GstClockTime time, guint64 offset)
+add_index_entry (GstTimeShiftTsIndexer * base, GstClockTime time,
+    guint64 offset, gboolean key_unit)
 {
   GstIndexAssociation associations[2];
 
   GST_LOG_OBJECT (base, "adding association %" GST_TIME_FORMAT "-> %"
-      G_GUINT64_FORMAT, GST_TIME_ARGS (time), offset);
+      G_GUINT64_FORMAT "%s", GST_TIME_ARGS (time), offset,
+      key_unit ? " (key unit)" : "");
   associations[0].format = GST_FORMAT_TIME;
   associations[0].value = time;
   associations[1].format = GST_FORMAT_BYTES;
   associations[1].value = offset;
 
-  gst_index_add_associationv (base->index, GST_ASSOCIATION_FLAG_NONE, 2,
+  gst_index_add_associationv (base->index,
+      key_unit ? GST_ASSOCIATION_FLAG_KEY_UNIT : GST_ASSOCIATION_FLAG_NONE, 2,
       (const GstIndexAssociation *) &associations);
 }
 
 static inline guint64
-gst_time_shift_ts_indexer_parse_pcr (GstTimeShiftTsIndexer * ts, guint8 * data)
+gst_time_shift_ts_indexer_parse_pcr (GstTimeShiftTsIndexer * ts, guint8 * data,
+    gboolean * key_unit)
 {
   guint16 pid;
   guint32 pcr1;
   guint16 pcr2;
   guint64 pcr = (guint64) -1, pcr_ext;
 
+  *key_unit = FALSE;
+
   if (TS_PACKET_SYNC_CODE == data[0]) {
     /* Check Adaptation field, if it == b10 or b11 */
     if (data[3] & 0x20) {
@@ -354,8 +360,9 @@ gst_time_shift_ts_indexer_parse_pcr (GstTimeShiftTsIndexer * ts, guint8 * data)
         /* Check Adaptation field size */
         if (data[4]) {
           /* Check if random access flag is present */
+          *key_unit = (data[5] & 0x40) != 0;
           if (ts->delta == -1 && GST_CLOCK_TIME_IS_VALID (ts->base_time) &&
-              !(data[5] & 0x40)) {
+              !*key_unit) {
             /* random access flag not set just skip after first PCR */
             goto beach;
           }
@@ -380,7 +387,7 @@ beach:
 
 static inline guint64
 gst_time_shift_ts_indexer_get_pcr (GstTimeShiftTsIndexer * ts, guint8 ** in_data,
-    gsize * in_size, guint64 * offset)
+    gsize * in_size, guint64 * offset, gboolean * key_unit)
 {
   guint64 pcr = (guint64) -1;
   gint i = 0;
@@ -390,14 +397,14 @@ gst_time_shift_ts_indexer_get_pcr (GstTimeShiftTsIndexer * ts, guint8 ** in_data
   /* mpegtsparse pushes PES packet buffers so this case must be handled
    * without checking for next SYNC code */
   if (size >= TS_MIN_PACKET_SIZE && size <= TS_MAX_PACKET_SIZE) {
-    pcr = gst_time_shift_ts_indexer_parse_pcr (ts, data);
+    pcr = gst_time_shift_ts_indexer_parse_pcr (ts, data, key_unit);
   } else {
     while ((i + TS_MAX_PACKET_SIZE) < size) {
       if (TS_PACKET_SYNC_CODE == data[i]) {
         /* Check the next SYNC byte for all packets except the last packet
          * in a buffer... */
         if (G_LIKELY (is_next_sync_valid (data, size, i))) {
-          pcr = gst_time_shift_ts_indexer_parse_pcr (ts, data + i);
+          pcr = gst_time_shift_ts_indexer_parse_pcr (ts, data + i, key_unit);
           if (pcr == -1) {
             /* Skip to start of next TSPacket (pre-subract for the i++ later) */
             i += (TS_MIN_PACKET_SIZE - 1);
@@ -423,6 +430,7 @@ gst_time_shift_ts_indexer_collect_time (GstTimeShiftTsIndexer * base, guint8 * d
   GstClockTime time;
   gsize remaining = size;
   guint64 pcr, offset;
+  gboolean key_unit;
 
   /* We can read PCR data only if we know which PCR pid to track */
   if (G_UNLIKELY (ts->pcr_pid == INVALID_PID)) {
@@ -431,7 +439,8 @@ gst_time_shift_ts_indexer_collect_time (GstTimeShiftTsIndexer * base, guint8 * d
 
   offset = ts->current_offset;
   while (remaining >= TS_MIN_PACKET_SIZE) {
-    pcr = gst_time_shift_ts_indexer_get_pcr (ts, &data, &remaining, &offset);
+    pcr = gst_time_shift_ts_indexer_get_pcr (ts, &data, &remaining, &offset,
+        &key_unit);
     if (pcr != (guint64) -1) {
       /* FIXME: handle wraparounds */
       if (!GST_CLOCK_TIME_IS_VALID (ts->base_time)) {
@@ -448,16 +457,21 @@ gst_time_shift_ts_indexer_collect_time (GstTimeShiftTsIndexer * base, guint8 * d
       ts->last_pcr = pcr;
 
       if (!GST_CLOCK_TIME_IS_VALID (ts->last_time)) {
-        add_index_entry (base, time, offset);
+        add_index_entry (base, time, offset, key_unit);
         ts->last_time = time;
         goto beach;
       } else if (ts->delta == -1) {
-        add_index_entry (base, time, offset);
+        add_index_entry (base, time, offset, key_unit);
+        ts->last_time = time;
+        goto beach;
+      } else if (key_unit) {
+        /* random access points are always indexed for trick play */
+        add_index_entry (base, time, offset, key_unit);
         ts->last_time = time;
         goto beach;
       } else if (ts->delta != -1 &&
           GST_CLOCK_DIFF (ts->last_time, time) >= ts->delta) {
-        add_index_entry (base, time, offset);
+        add_index_entry (base, time, offset, key_unit);
         ts->last_time = time;
         goto beach;
       }
@@ -0,0 +1,970 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <time.h>
+
+/* the size of a slot of the cache */
+#define SLOT_SIZE (32 * 1024)
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+static GstElement *
+setup_shifter (void)
+{
+  GstElement *shifter;
+
+  shifter = gst_check_setup_element ("flufakeshifter");
+  mysrcpad = gst_check_setup_src_pad (shifter, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (shifter, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  return shifter;
+}
+
+static void
+cleanup_shifter (GstElement * shifter)
+{
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (shifter);
+  gst_check_teardown_sink_pad (shifter);
+  gst_check_teardown_element (shifter);
+}
+
+static void
+start_shifter (GstElement * shifter)
+{
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_setup_events (mysrcpad, shifter, NULL, GST_FORMAT_BYTES);
+}
+
+/* the byte at every offset is known so the output can be checked */
+static GstBuffer *
+make_buffer (guint64 offset, gsize size)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (size);
+  GstMapInfo map;
+  gsize i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (i = 0; i < size; i++)
+    map.data[i] = (offset + i) % 251;
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static void
+check_buffer (GstBuffer * buffer, guint64 offset)
+{
+  GstMapInfo map;
+  gsize i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  for (i = 0; i < map.size; i++) {
+    if (map.data[i] != (offset + i) % 251)
+      fail ("wrong byte at offset %" G_GUINT64_FORMAT, offset + i);
+  }
+  gst_buffer_unmap (buffer, &map);
+}
+
+/* bytes received downstream, called with the check mutex */
+static guint64
+count_bytes (void)
+{
+  guint64 size = 0;
+  GList *l;
+
+  for (l = buffers; l; l = l->next)
+    size += gst_buffer_get_size (GST_BUFFER (l->data));
+  return size;
+}
+
+static void
+wait_for_bytes (guint64 size)
+{
+  g_mutex_lock (&check_mutex);
+  while (count_bytes () < size)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+/* checks that the output is the input from @offset on */
+static void
+check_output (guint64 offset)
+{
+  GList *l;
+
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buffer = GST_BUFFER (l->data);
+
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer), offset);
+    check_buffer (buffer, offset);
+    offset += gst_buffer_get_size (buffer);
+  }
+}
+
+static void
+push_bytes (guint64 offset, gsize size)
+{
+  fail_unless_equals_int (gst_pad_push (mysrcpad, make_buffer (offset,
+              size)), GST_FLOW_OK);
+}
+
+static gboolean
+seek_bytes (guint64 offset)
+{
+  return gst_pad_push_event (mysinkpad, gst_event_new_seek (1.0,
+          GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, offset,
+          GST_SEEK_TYPE_NONE, -1));
+}
+
+static void
+drop_output (void)
+{
+  g_mutex_lock (&check_mutex);
+  gst_check_drop_buffers ();
+  g_mutex_unlock (&check_mutex);
+}
+
+GST_START_TEST (test_chain_list)
+{
+  GstElement *shifter;
+  GstBufferList *list;
+  guint i;
+
+  shifter = setup_shifter ();
+  start_shifter (shifter);
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 4; i++)
+    gst_buffer_list_add (list, make_buffer (i * SLOT_SIZE / 2,
+            SLOT_SIZE / 2));
+  fail_unless_equals_int (gst_pad_push_list (mysrcpad, list), GST_FLOW_OK);
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (2 * SLOT_SIZE,
+              100)) == GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  wait_for_bytes (2 * SLOT_SIZE + 100);
+  check_output (0);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+/* MPEG-TS packets, grouped like the UDP sources do */
+#define BENCH_PACKETS 7
+#define BENCH_PACKET_SIZE 188
+/* a whole number of slots, the last one is pushed without an EOS */
+#define BENCH_ROUNDS 8192
+
+static guint64 bench_bytes;
+
+static GstFlowReturn
+count_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  g_mutex_lock (&check_mutex);
+  bench_bytes += gst_buffer_get_size (buffer);
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+  gst_buffer_unref (buffer);
+
+  return GST_FLOW_OK;
+}
+
+/* returns the time to get the packets through the shifter */
+static GstClockTime
+push_packets (gboolean use_lists)
+{
+  GstElement *shifter;
+  GstBuffer *packet;
+  GstClockTime start, elapsed;
+  guint i, j;
+
+  shifter = setup_shifter ();
+  gst_pad_set_chain_function (mysinkpad, count_chain);
+  bench_bytes = 0;
+  start_shifter (shifter);
+  packet = gst_buffer_new_and_alloc (BENCH_PACKET_SIZE);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < BENCH_ROUNDS; i++) {
+    if (use_lists) {
+      GstBufferList *list = gst_buffer_list_new_sized (BENCH_PACKETS);
+
+      for (j = 0; j < BENCH_PACKETS; j++)
+        gst_buffer_list_add (list, gst_buffer_ref (packet));
+      fail_unless_equals_int (gst_pad_push_list (mysrcpad, list),
+          GST_FLOW_OK);
+    } else {
+      for (j = 0; j < BENCH_PACKETS; j++)
+        fail_unless_equals_int (gst_pad_push (mysrcpad,
+                gst_buffer_ref (packet)), GST_FLOW_OK);
+    }
+  }
+  g_mutex_lock (&check_mutex);
+  while (bench_bytes < BENCH_ROUNDS * BENCH_PACKETS * BENCH_PACKET_SIZE)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+  elapsed = gst_util_get_timestamp () - start;
+
+  gst_buffer_unref (packet);
+  cleanup_shifter (shifter);
+
+  return elapsed;
+}
+
+GST_START_TEST (test_chain_list_benchmark)
+{
+  GstClockTime buffers, lists;
+
+  buffers = push_packets (FALSE);
+  lists = push_packets (TRUE);
+  g_print ("%d packets of %d bytes: %" GST_TIME_FORMAT " one by one, %"
+      GST_TIME_FORMAT " in lists of %d\n", BENCH_ROUNDS * BENCH_PACKETS,
+      BENCH_PACKET_SIZE, GST_TIME_ARGS (buffers), GST_TIME_ARGS (lists),
+      BENCH_PACKETS);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_live_passthrough)
+{
+  GstElement *shifter;
+
+  shifter = setup_shifter ();
+  g_object_set (shifter, "live-passthrough", TRUE, NULL);
+  start_shifter (shifter);
+
+  /* forwarded right away, without waiting for a full slot */
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (0, 100)) == GST_FLOW_OK);
+  wait_for_bytes (100);
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (100, 200)) == GST_FLOW_OK);
+  wait_for_bytes (300);
+
+  /* paused it continues from the cache at the next byte */
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_pad_push (mysrcpad, make_buffer (300,
+              SLOT_SIZE)) == GST_FLOW_OK);
+  wait_for_bytes (SLOT_SIZE);
+  check_output (0);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_seek)
+{
+  GstElement *shifter;
+  GstPad *srcpad;
+
+  shifter = setup_shifter ();
+  start_shifter (shifter);
+  srcpad = gst_element_get_static_pad (shifter, "src");
+
+  push_bytes (0, 4 * SLOT_SIZE);
+  wait_for_bytes (4 * SLOT_SIZE);
+  drop_output ();
+
+  /* back to the data already pushed, the task is not restarted */
+  fail_unless (seek_bytes (SLOT_SIZE));
+  wait_for_bytes (3 * SLOT_SIZE);
+  check_output (SLOT_SIZE);
+  fail_unless_equals_int (gst_pad_get_task_state (srcpad), GST_TASK_STARTED);
+  drop_output ();
+
+  /* not cached */
+  fail_if (seek_bytes (8 * SLOT_SIZE));
+
+  gst_object_unref (srcpad);
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+static GMutex probe_lock;
+static GCond probe_cond;
+static gboolean probe_blocked, probe_released;
+
+/* holds the streaming thread in the flush stop of a seek */
+static GstPadProbeReturn
+block_flush_stop (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_FLUSH_STOP)
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&probe_lock);
+  probe_blocked = TRUE;
+  g_cond_broadcast (&probe_cond);
+  while (!probe_released)
+    g_cond_wait (&probe_cond, &probe_lock);
+  g_mutex_unlock (&probe_lock);
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+static guint64
+get_stat (GstElement * shifter, const gchar * name)
+{
+  GstStructure *stats;
+  guint64 value;
+
+  g_object_get (shifter, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, name, &value));
+  gst_structure_free (stats);
+  return value;
+}
+
+GST_START_TEST (test_seek_coalescing)
+{
+  GstElement *shifter;
+
+  shifter = setup_shifter ();
+  start_shifter (shifter);
+
+  push_bytes (0, 4 * SLOT_SIZE);
+  wait_for_bytes (4 * SLOT_SIZE);
+  drop_output ();
+
+  probe_blocked = probe_released = FALSE;
+  gst_pad_add_probe (mysinkpad, GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      block_flush_stop, NULL, NULL);
+  fail_unless (seek_bytes (0));
+
+  /* the first seek is being performed, the next ones replace each other */
+  g_mutex_lock (&probe_lock);
+  while (!probe_blocked)
+    g_cond_wait (&probe_cond, &probe_lock);
+  g_mutex_unlock (&probe_lock);
+  fail_unless (seek_bytes (SLOT_SIZE));
+  fail_unless (seek_bytes (2 * SLOT_SIZE));
+
+  g_mutex_lock (&probe_lock);
+  probe_released = TRUE;
+  g_cond_broadcast (&probe_cond);
+  g_mutex_unlock (&probe_lock);
+
+  wait_for_bytes (2 * SLOT_SIZE);
+  check_output (2 * SLOT_SIZE);
+  fail_unless_equals_uint64 (get_stat (shifter, "seeks"), 1);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats)
+{
+  GstElement *shifter;
+  GstStructure *stats;
+  const GValue *histogram;
+  guint64 seeks = 0, value;
+  guint lent, i;
+
+  shifter = setup_shifter ();
+  g_object_set (shifter, "cache-size", (guint64) 16 * SLOT_SIZE, NULL);
+  start_shifter (shifter);
+
+  push_bytes (0, 3 * SLOT_SIZE + 100);
+  wait_for_bytes (3 * SLOT_SIZE);
+
+  /* the slots pushed are lent until downstream drops them */
+  g_object_get (shifter, "stats", &stats, NULL);
+  fail_unless (gst_structure_has_name (stats, "shifter-stats"));
+  fail_unless (gst_structure_get_uint64 (stats, "bytes-in", &value));
+  fail_unless_equals_uint64 (value, 3 * SLOT_SIZE + 100);
+  fail_unless (gst_structure_get_uint64 (stats, "bytes-out", &value));
+  fail_unless_equals_uint64 (value, 3 * SLOT_SIZE);
+  fail_unless (gst_structure_get_uint64 (stats, "ring-size", &value));
+  fail_unless_equals_uint64 (value, 16 * SLOT_SIZE);
+  fail_unless (gst_structure_get_uint (stats, "slots-lent", &lent));
+  fail_unless_equals_int (lent, 3);
+  gst_structure_free (stats);
+
+  drop_output ();
+  g_object_get (shifter, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint (stats, "slots-lent", &lent));
+  fail_unless_equals_int (lent, 0);
+  gst_structure_free (stats);
+
+  /* the latency of the seek is in one of the buckets */
+  fail_unless (seek_bytes (0));
+  wait_for_bytes (3 * SLOT_SIZE);
+  g_object_get (shifter, "stats", &stats, NULL);
+  fail_unless (gst_structure_get_uint64 (stats, "seeks", &value));
+  fail_unless_equals_uint64 (value, 1);
+  histogram = gst_structure_get_value (stats, "seek-latency-histogram");
+  fail_unless (histogram != NULL);
+  for (i = 0; i < gst_value_array_get_size (histogram); i++)
+    seeks += g_value_get_uint64 (gst_value_array_get_value (histogram, i));
+  fail_unless_equals_uint64 (seeks, 1);
+  gst_structure_free (stats);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+/* returns how long it took to get the first buffer after seeking */
+static GstClockTime
+time_seek (guint64 offset)
+{
+  GstClockTime start, elapsed;
+
+  drop_output ();
+  start = gst_util_get_timestamp ();
+  fail_unless (seek_bytes (offset));
+  wait_for_bytes (1);
+  elapsed = gst_util_get_timestamp () - start;
+  wait_for_bytes (SLOT_SIZE);
+  check_output (offset);
+
+  return elapsed;
+}
+
+static void
+wait_migration (GstElement * shifter)
+{
+  guint i;
+
+  for (i = 0; i < 1000; i++) {
+    if (GST_CLOCK_TIME_IS_VALID (get_stat (shifter, "migration-time")))
+      return;
+    g_usleep (G_USEC_PER_SEC / 100);
+  }
+  fail ("the ring buffer migration did not finish");
+}
+
+GST_START_TEST (test_seek_latency)
+{
+  GstElement *shifter;
+  GstStructure *stats;
+  const GValue *histogram;
+  GstClockTime ring, disk;
+  gchar *template;
+  guint64 seeks = 0;
+  guint i;
+
+  shifter = setup_shifter ();
+  template = g_build_filename (g_get_tmp_dir (), "flufakeshifter-XXXXXX",
+      NULL);
+  g_object_set (shifter, "cache-size", (guint64) 16 * SLOT_SIZE,
+      "recording-template", template, NULL);
+  g_free (template);
+  start_shifter (shifter);
+
+  for (i = 0; i < 8; i++)
+    push_bytes (i * SLOT_SIZE, SLOT_SIZE);
+  wait_for_bytes (8 * SLOT_SIZE);
+  ring = time_seek (0);
+
+  /* the output holds on to the ring, the rest is recorded on the disk */
+  wait_for_bytes (8 * SLOT_SIZE);
+  for (i = 8; i < 24; i++)
+    push_bytes (i * SLOT_SIZE, SLOT_SIZE);
+  wait_for_bytes (16 * SLOT_SIZE);
+  wait_migration (shifter);
+
+  /* the ring is reloaded from the disk past the start of the stream */
+  drop_output ();
+  for (i = 24; i < 32; i++)
+    push_bytes (i * SLOT_SIZE, SLOT_SIZE);
+  disk = time_seek (0);
+
+  g_print ("seek to the first buffer: %" GST_TIME_FORMAT " from the ring, %"
+      GST_TIME_FORMAT " from the disk\n", GST_TIME_ARGS (ring),
+      GST_TIME_ARGS (disk));
+
+  /* both seeks are in the histogram */
+  g_object_get (shifter, "stats", &stats, NULL);
+  histogram = gst_structure_get_value (stats, "seek-latency-histogram");
+  for (i = 0; i < gst_value_array_get_size (histogram); i++)
+    seeks += g_value_get_uint64 (gst_value_array_get_value (histogram, i));
+  fail_unless_equals_uint64 (seeks, 2);
+  gst_structure_free (stats);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stats_messages)
+{
+  GstElement *shifter;
+  GstMessage *msg;
+  const GstStructure *stats;
+  GstBus *bus;
+  guint64 value;
+  guint i;
+
+  shifter = setup_shifter ();
+  bus = gst_bus_new ();
+  gst_element_set_bus (shifter, bus);
+  g_object_set (shifter, "stats-interval", GST_SECOND / 20, NULL);
+  start_shifter (shifter);
+
+  push_bytes (0, 2 * SLOT_SIZE);
+  wait_for_bytes (2 * SLOT_SIZE);
+
+  /* posted periodically, the counters go up to the data pushed */
+  for (i = 0; i < 3; i++) {
+    msg = gst_bus_timed_pop_filtered (bus, GST_SECOND, GST_MESSAGE_ELEMENT);
+    fail_unless (msg != NULL);
+    fail_unless (GST_MESSAGE_SRC (msg) == GST_OBJECT (shifter));
+    stats = gst_message_get_structure (msg);
+    fail_unless (gst_structure_has_name (stats, "shifter-stats"));
+    fail_unless (gst_structure_get_uint64 (stats, "bytes-in", &value));
+    fail_unless (value <= 2 * SLOT_SIZE);
+    /* only the counters, the levels of the cache would need its lock */
+    fail_if (gst_structure_has_field (stats, "ring-fill"));
+    gst_message_unref (msg);
+  }
+
+  /* a message already being posted can still come after it's disabled */
+  g_object_set (shifter, "stats-interval", (guint64) 0, NULL);
+  g_usleep (G_USEC_PER_SEC / 10);
+  gst_bus_set_flushing (bus, TRUE);
+  gst_bus_set_flushing (bus, FALSE);
+  fail_unless (gst_bus_timed_pop_filtered (bus, GST_SECOND / 5,
+          GST_MESSAGE_ELEMENT) == NULL);
+
+  gst_element_set_bus (shifter, NULL);
+  gst_object_unref (bus);
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+static GArray *segment_rates;
+
+static GstPadProbeReturn
+record_segment_rate (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+  const GstSegment *segment;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT) {
+    gst_event_parse_segment (event, &segment);
+    g_mutex_lock (&check_mutex);
+    g_array_append_val (segment_rates, segment->rate);
+    g_mutex_unlock (&check_mutex);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_catch_up)
+{
+  GstElement *shifter;
+
+  shifter = setup_shifter ();
+  g_object_set (shifter, "catch-up", TRUE, "catch-up-rate", 1.5,
+      "catch-up-threshold", (guint64) 2 * SLOT_SIZE, NULL);
+  start_shifter (shifter);
+  segment_rates = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  gst_pad_add_probe (mysinkpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      record_segment_rate, NULL, NULL);
+
+  push_bytes (0, 8 * SLOT_SIZE);
+  wait_for_bytes (8 * SLOT_SIZE);
+  drop_output ();
+  g_array_set_size (segment_rates, 0);
+
+  /* faster while more than the threshold behind, until a slot from live */
+  fail_unless (seek_bytes (0));
+  wait_for_bytes (8 * SLOT_SIZE);
+  check_output (0);
+
+  fail_unless_equals_int (segment_rates->len, 3);
+  fail_unless_equals_float (g_array_index (segment_rates, gdouble, 0), 1.0);
+  fail_unless_equals_float (g_array_index (segment_rates, gdouble, 1), 1.5);
+  fail_unless_equals_float (g_array_index (segment_rates, gdouble, 2), 1.0);
+
+  cleanup_shifter (shifter);
+  g_array_free (segment_rates, TRUE);
+}
+
+GST_END_TEST;
+
+static gboolean
+peer_has_pull_mode (void)
+{
+  GstQuery *query = gst_query_new_scheduling ();
+  gboolean ret;
+
+  fail_unless (gst_pad_peer_query (mysinkpad, query));
+  ret = gst_query_has_scheduling_mode (query, GST_PAD_MODE_PULL);
+  gst_query_unref (query);
+  return ret;
+}
+
+GST_START_TEST (test_pull_mode)
+{
+  GstElement *shifter;
+  GstBuffer *buffer = NULL;
+
+  shifter = gst_check_setup_element ("flufakeshifter");
+  mysrcpad = gst_check_setup_src_pad (shifter, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (shifter, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+
+  /* only when allowed */
+  fail_if (peer_has_pull_mode ());
+  fail_if (gst_pad_activate_mode (mysinkpad, GST_PAD_MODE_PULL, TRUE));
+  g_object_set (shifter, "allow-pull", TRUE, NULL);
+  fail_unless (peer_has_pull_mode ());
+  fail_unless (gst_pad_activate_mode (mysinkpad, GST_PAD_MODE_PULL, TRUE));
+
+  gst_check_setup_events (mysrcpad, shifter, NULL, GST_FORMAT_BYTES);
+  push_bytes (0, 3 * SLOT_SIZE + 100);
+
+  /* any range, across slots and in the partial one */
+  fail_unless_equals_int (gst_pad_pull_range (mysinkpad, 1000, SLOT_SIZE,
+          &buffer), GST_FLOW_OK);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), SLOT_SIZE);
+  check_buffer (buffer, 1000);
+  gst_buffer_replace (&buffer, NULL);
+  fail_unless_equals_int (gst_pad_pull_range (mysinkpad, 3 * SLOT_SIZE, 100,
+          &buffer), GST_FLOW_OK);
+  check_buffer (buffer, 3 * SLOT_SIZE);
+  gst_buffer_replace (&buffer, NULL);
+
+  /* the end of the stream */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_pad_pull_range (mysinkpad, 3 * SLOT_SIZE + 100,
+          100, &buffer), GST_FLOW_EOS);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+typedef struct
+{
+  guint64 offset;
+  GstBuffer *buffer;
+  GstFlowReturn ret;
+  gboolean done;
+} PullData;
+
+static gpointer
+pull_thread (PullData * data)
+{
+  GstFlowReturn ret;
+
+  ret = gst_pad_pull_range (mysinkpad, data->offset, 100, &data->buffer);
+  g_mutex_lock (&check_mutex);
+  data->ret = ret;
+  data->done = TRUE;
+  g_mutex_unlock (&check_mutex);
+
+  return NULL;
+}
+
+static gboolean
+pull_done (PullData * data)
+{
+  gboolean done;
+
+  g_mutex_lock (&check_mutex);
+  done = data->done;
+  g_mutex_unlock (&check_mutex);
+  return done;
+}
+
+GST_START_TEST (test_pull_live_edge)
+{
+  GstElement *shifter;
+  PullData data = { 0, };
+  GThread *thread;
+
+  shifter = gst_check_setup_element ("flufakeshifter");
+  mysrcpad = gst_check_setup_src_pad (shifter, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (shifter, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  g_object_set (shifter, "allow-pull", TRUE, NULL);
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_pad_activate_mode (mysinkpad, GST_PAD_MODE_PULL, TRUE));
+  gst_check_setup_events (mysrcpad, shifter, NULL, GST_FORMAT_BYTES);
+  push_bytes (0, SLOT_SIZE);
+
+  /* past the live edge it waits for the data to be received */
+  data.offset = SLOT_SIZE;
+  thread = g_thread_new ("pull", (GThreadFunc) pull_thread, &data);
+  g_usleep (G_USEC_PER_SEC / 10);
+  fail_if (pull_done (&data));
+  push_bytes (SLOT_SIZE, SLOT_SIZE);
+  g_thread_join (thread);
+  fail_unless_equals_int (data.ret, GST_FLOW_OK);
+  check_buffer (data.buffer, SLOT_SIZE);
+  gst_buffer_replace (&data.buffer, NULL);
+
+  /* and stops waiting when deactivated */
+  data.offset = 4 * SLOT_SIZE;
+  data.done = FALSE;
+  thread = g_thread_new ("pull", (GThreadFunc) pull_thread, &data);
+  g_usleep (G_USEC_PER_SEC / 10);
+  fail_if (pull_done (&data));
+  fail_unless (gst_pad_activate_mode (mysinkpad, GST_PAD_MODE_PULL, FALSE));
+  g_thread_join (thread);
+  fail_unless_equals_int (data.ret, GST_FLOW_FLUSHING);
+  fail_unless (data.buffer == NULL);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffering_query)
+{
+  GstElement *shifter;
+  GstQuery *query;
+  const GstStructure *st;
+  gint64 start, stop;
+  guint64 ring_start, ring_stop;
+  gboolean busy;
+  gint percent;
+
+  shifter = setup_shifter ();
+  start_shifter (shifter);
+
+  push_bytes (0, 3 * SLOT_SIZE);
+  wait_for_bytes (3 * SLOT_SIZE);
+
+  /* only bytes are known, the times are in the index of the bin */
+  query = gst_query_new_buffering (GST_FORMAT_TIME);
+  fail_if (gst_pad_peer_query (mysinkpad, query));
+  gst_query_unref (query);
+
+  /* all the data is in memory, also once read */
+  query = gst_query_new_buffering (GST_FORMAT_BYTES);
+  fail_unless (gst_pad_peer_query (mysinkpad, query));
+  gst_query_parse_buffering_percent (query, &busy, &percent);
+  fail_if (busy);
+  fail_unless_equals_int (percent, 100);
+  fail_unless_equals_int (gst_query_get_n_buffering_ranges (query), 1);
+  fail_unless (gst_query_parse_nth_buffering_range (query, 0, &start,
+          &stop));
+  fail_unless_equals_uint64 (start, 0);
+  fail_unless_equals_uint64 (stop, 3 * SLOT_SIZE);
+
+  st = gst_query_get_structure (query);
+  fail_unless (gst_structure_get_uint64 (st, "ring-start", &ring_start));
+  fail_unless (gst_structure_get_uint64 (st, "ring-stop", &ring_stop));
+  fail_unless_equals_uint64 (ring_start, 0);
+  fail_unless_equals_uint64 (ring_stop, 3 * SLOT_SIZE);
+  fail_if (gst_structure_has_field (st, "disk-start"));
+  gst_query_unref (query);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_buffering_percents)
+{
+  GstElement *shifter;
+  gint low, high;
+
+  shifter = setup_shifter ();
+
+  /* the watermarks never cross, the one being set is clamped */
+  g_object_set (shifter, "low-percent", 20, "high-percent", 60, NULL);
+  g_object_set (shifter, "low-percent", 80, NULL);
+  g_object_get (shifter, "low-percent", &low, "high-percent", &high, NULL);
+  fail_unless_equals_int (low, 60);
+  fail_unless_equals_int (high, 60);
+
+  g_object_set (shifter, "low-percent", 20, NULL);
+  g_object_set (shifter, "high-percent", 10, NULL);
+  g_object_get (shifter, "low-percent", &low, "high-percent", &high, NULL);
+  fail_unless_equals_int (low, 20);
+  fail_unless_equals_int (high, 20);
+
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+static gint
+pop_buffering (GstBus * bus)
+{
+  GstBufferingMode mode;
+  GstMessage *msg;
+  gint percent;
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_SECOND, GST_MESSAGE_BUFFERING);
+  fail_unless (msg != NULL);
+  gst_message_parse_buffering (msg, &percent);
+  gst_message_parse_buffering_stats (msg, &mode, NULL, NULL, NULL);
+  fail_unless_equals_int (mode, GST_BUFFERING_TIMESHIFT);
+  gst_message_unref (msg);
+
+  return percent;
+}
+
+GST_START_TEST (test_buffering_messages)
+{
+  GstElement *shifter;
+  GstBus *bus;
+  guint i;
+
+  shifter = setup_shifter ();
+  bus = gst_bus_new ();
+  gst_element_set_bus (shifter, bus);
+  g_object_set (shifter, "use-buffering", TRUE, "low-percent", 20,
+      "high-percent", 80, NULL);
+  start_shifter (shifter);
+
+  for (i = 0; i < 2; i++) {
+    /* the data of a partial slot can't be read yet, the ring is below the
+     * low watermark until the slot is complete */
+    push_bytes (i * SLOT_SIZE, 100);
+    fail_unless_equals_int (pop_buffering (bus), 0);
+    push_bytes (i * SLOT_SIZE + 100, SLOT_SIZE - 100);
+    fail_unless_equals_int (pop_buffering (bus), 100);
+    wait_for_bytes ((i + 1) * SLOT_SIZE);
+  }
+  check_output (0);
+
+  /* above the low watermark nothing is posted */
+  fail_unless (gst_bus_timed_pop_filtered (bus, GST_SECOND / 10,
+          GST_MESSAGE_BUFFERING) == NULL);
+
+  gst_element_set_bus (shifter, NULL);
+  gst_object_unref (bus);
+  cleanup_shifter (shifter);
+}
+
+GST_END_TEST;
+
+/* slots pushed through every instance of the scaling benchmark */
+#define SCALING_SLOTS 128
+
+/* returns the CPU time used to get a stream through each of @n shifters */
+static gdouble
+run_instances (guint n, gboolean shared)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBus *bus;
+  GString *desc;
+  gchar *template;
+  clock_t start;
+  gdouble cpu;
+  guint i;
+
+  template = g_build_filename (g_get_tmp_dir (), "flufakeshifter-XXXXXX",
+      NULL);
+  desc = g_string_new (NULL);
+  for (i = 0; i < n; i++) {
+    g_string_append_printf (desc, "fakesrc num-buffers=%d sizetype=fixed "
+        "sizemax=%d ! flufakeshifter cache-size=%d recording-template=%s "
+        "shared-scheduler=%s ! fakesink sync=false ", SCALING_SLOTS,
+        SLOT_SIZE, 4 * SLOT_SIZE, template, shared ? "true" : "false");
+  }
+  pipeline = gst_parse_launch (desc->str, NULL);
+  fail_unless (pipeline != NULL);
+  g_string_free (desc, TRUE);
+  g_free (template);
+
+  bus = gst_element_get_bus (pipeline);
+  start = clock ();
+  fail_if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless (msg != NULL);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  cpu = (gdouble) (clock () - start) / CLOCKS_PER_SEC;
+  gst_message_unref (msg);
+
+  fail_unless (gst_element_set_state (pipeline,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  return cpu;
+}
+
+/* the output of every instance has its own thread, only the disk work
+ * goes to the shared workers */
+GST_START_TEST (test_scaling_benchmark)
+{
+  guint n;
+
+  for (n = 1; n <= 32; n *= 2) {
+    gdouble own = run_instances (n, FALSE);
+    gdouble shared = run_instances (n, TRUE);
+
+    g_print ("%2u instances: %.3f s of CPU with their own threads, %.3f s "
+        "with the shared scheduler\n", n, own, shared);
+  }
+}
+
+GST_END_TEST;
+
+static Suite *
+flufakeshifter_suite (void)
+{
+  Suite *s = suite_create ("flufakeshifter");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_chain_list);
+  tcase_add_test (tc_chain, test_chain_list_benchmark);
+  tcase_add_test (tc_chain, test_live_passthrough);
+  tcase_add_test (tc_chain, test_seek);
+  tcase_add_test (tc_chain, test_seek_coalescing);
+  tcase_add_test (tc_chain, test_stats);
+  tcase_add_test (tc_chain, test_seek_latency);
+  tcase_add_test (tc_chain, test_stats_messages);
+  tcase_add_test (tc_chain, test_catch_up);
+  tcase_add_test (tc_chain, test_pull_mode);
+  tcase_add_test (tc_chain, test_pull_live_edge);
+  tcase_add_test (tc_chain, test_buffering_query);
+  tcase_add_test (tc_chain, test_buffering_percents);
+  tcase_add_test (tc_chain, test_buffering_messages);
+  tcase_add_test (tc_chain, test_scaling_benchmark);
+
+  return s;
+}
+
+GST_CHECK_MAIN (flufakeshifter);
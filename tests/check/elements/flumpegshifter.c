@@ -0,0 +1,440 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <string.h>
+
+/* the size of a slot of the cache */
+#define SLOT_SIZE (32 * 1024)
+
+#define PACKET_SIZE 188
+#define PCR_PID 0x100
+
+/* every key unit starts with a PCR packet and lasts KEY_UNIT_DURATION */
+#define KEY_UNIT_PACKETS 100
+#define KEY_UNIT_SIZE (KEY_UNIT_PACKETS * PACKET_SIZE)
+#define KEY_UNIT_DURATION (GST_SECOND / 10)
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/mpegts"));
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/mpegts"));
+
+/* the shifter reads the index written by the indexer in front of it */
+static GstElement *
+setup_shifter (GstElement ** indexer)
+{
+  GstElement *shifter;
+  GObject *index;
+
+  *indexer = gst_check_setup_element ("timeshifttsindexer");
+  g_object_set (*indexer, "pcr-pid", PCR_PID, NULL);
+  shifter = gst_check_setup_element ("flumpegshifter");
+  fail_unless (gst_element_link (*indexer, shifter));
+  mysrcpad = gst_check_setup_src_pad (*indexer, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (shifter, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  /* the indexer creates the index when started */
+  fail_unless (gst_element_set_state (*indexer,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+  g_object_get (*indexer, "index", &index, NULL);
+  fail_unless (index != NULL);
+  g_object_set (shifter, "index", index, NULL);
+  g_object_unref (index);
+
+  return shifter;
+}
+
+static void
+cleanup_shifter (GstElement * indexer, GstElement * shifter)
+{
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_set_state (indexer,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (indexer);
+  gst_check_teardown_sink_pad (shifter);
+  gst_element_unlink (indexer, shifter);
+  gst_check_teardown_element (shifter);
+  gst_check_teardown_element (indexer);
+}
+
+static void
+start_shifter (GstElement * indexer, GstElement * shifter)
+{
+  GstCaps *caps = gst_caps_new_empty_simple ("video/mpegts");
+
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_set_state (indexer,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_setup_events (mysrcpad, indexer, caps, GST_FORMAT_BYTES);
+  gst_caps_unref (caps);
+}
+
+/* a key unit: a PCR packet with the random access indicator followed by
+ * packets without adaptation field */
+static GstBuffer *
+make_key_unit (guint n)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (KEY_UNIT_SIZE);
+  /* in 90 kHz units */
+  guint64 pcr = gst_util_uint64_scale (n * KEY_UNIT_DURATION, 90000,
+      GST_SECOND);
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0xff, map.size);
+  for (i = 0; i < KEY_UNIT_PACKETS; i++) {
+    guint8 *data = map.data + i * PACKET_SIZE;
+
+    data[0] = 0x47;
+    data[1] = PCR_PID >> 8;
+    data[2] = PCR_PID & 0xff;
+    data[3] = 0x10;
+  }
+  /* adaptation field with the random access indicator and the PCR */
+  map.data[3] = 0x30;
+  map.data[4] = 7;
+  map.data[5] = 0x50;
+  GST_WRITE_UINT32_BE (map.data + 6, pcr >> 1);
+  map.data[10] = ((pcr & 1) << 7) | 0x7e;
+  map.data[11] = 0;
+  /* the number of the key unit, to check the output */
+  GST_WRITE_UINT32_BE (map.data + 12, n);
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static void
+push_key_units (guint first, guint n)
+{
+  guint i;
+
+  for (i = first; i < first + n; i++) {
+    fail_unless_equals_int (gst_pad_push (mysrcpad, make_key_unit (i)),
+        GST_FLOW_OK);
+  }
+}
+
+/* the number of the key unit starting at the buffer */
+static guint
+get_key_unit (GstBuffer * buffer)
+{
+  GstMapInfo map;
+  guint n;
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  fail_unless (map.size >= PACKET_SIZE);
+  fail_unless_equals_int (map.data[0], 0x47);
+  fail_unless (map.data[5] & 0x40);
+  n = GST_READ_UINT32_BE (map.data + 12);
+  gst_buffer_unmap (buffer, &map);
+
+  return n;
+}
+
+/* bytes received in @list, called with the check mutex */
+static guint64
+count_bytes (GList * list)
+{
+  guint64 size = 0;
+
+  for (; list; list = list->next)
+    size += gst_buffer_get_size (GST_BUFFER (list->data));
+  return size;
+}
+
+static void
+wait_for_bytes (guint64 size)
+{
+  g_mutex_lock (&check_mutex);
+  while (count_bytes (buffers) < size)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+wait_for_buffers (guint n)
+{
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < n)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+drop_output (void)
+{
+  g_mutex_lock (&check_mutex);
+  gst_check_drop_buffers ();
+  g_mutex_unlock (&check_mutex);
+}
+
+static gboolean
+seek_rate (gdouble rate, guint64 start, guint64 stop)
+{
+  return gst_pad_push_event (mysinkpad, gst_event_new_seek (rate,
+          GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, start,
+          stop == -1 ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET, stop));
+}
+
+GST_START_TEST (test_fast_forward)
+{
+  GstElement *indexer, *shifter;
+  GList *l;
+  guint n;
+
+  shifter = setup_shifter (&indexer);
+  start_shifter (indexer, shifter);
+
+  /* played normally up to the last full slot */
+  push_key_units (0, 50);
+  wait_for_bytes (50 * KEY_UNIT_SIZE / SLOT_SIZE * SLOT_SIZE);
+  drop_output ();
+
+  /* at 4x only the key units a second apart are pushed, whole */
+  fail_unless (seek_rate (4.0, 0, -1));
+  wait_for_buffers (5);
+
+  for (l = buffers, n = 0; n < 5; l = l->next, n++) {
+    GstBuffer *buffer = GST_BUFFER (l->data);
+
+    fail_unless_equals_int (get_key_unit (buffer), n * 10);
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer),
+        n * 10 * KEY_UNIT_SIZE);
+    fail_unless_equals_int (gst_buffer_get_size (buffer), KEY_UNIT_SIZE);
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT));
+  }
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_reverse)
+{
+  GstElement *indexer, *shifter;
+  GList *l;
+  guint n;
+
+  shifter = setup_shifter (&indexer);
+  start_shifter (indexer, shifter);
+
+  push_key_units (0, 50);
+  wait_for_bytes (50 * KEY_UNIT_SIZE / SLOT_SIZE * SLOT_SIZE);
+  drop_output ();
+
+  /* backwards from the stop, a key unit every quarter of a second down to
+   * the start of the cache */
+  fail_unless (seek_rate (-1.0, 0, 40 * KEY_UNIT_SIZE));
+  wait_for_buffers (14);
+
+  for (l = buffers, n = 0; n < 14; l = l->next, n++) {
+    GstBuffer *buffer = GST_BUFFER (l->data);
+
+    fail_unless_equals_int (get_key_unit (buffer), 40 - n * 3);
+    fail_unless_equals_int (gst_buffer_get_size (buffer), KEY_UNIT_SIZE);
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT));
+  }
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pcr_pacing)
+{
+  GstElement *indexer, *shifter;
+  GstClockTime start;
+
+  shifter = setup_shifter (&indexer);
+  start_shifter (indexer, shifter);
+
+  push_key_units (0, 20);
+  wait_for_bytes (20 * KEY_UNIT_SIZE / SLOT_SIZE * SLOT_SIZE);
+  drop_output ();
+
+  /* the slot with the end of the 12th key unit starts after a second of
+   * stream time, so it can't be pushed before */
+  g_object_set (shifter, "pcr-pacing", TRUE, NULL);
+  start = gst_util_get_timestamp ();
+  fail_unless (seek_rate (1.0, 0, -1));
+  wait_for_bytes (12 * KEY_UNIT_SIZE);
+  fail_unless (gst_util_get_timestamp () - start >= 9 * GST_SECOND / 10);
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_trick_pacing)
+{
+  GstElement *indexer, *shifter;
+  GstClockTime start;
+
+  shifter = setup_shifter (&indexer);
+  start_shifter (indexer, shifter);
+
+  push_key_units (0, 50);
+  wait_for_bytes (50 * KEY_UNIT_SIZE / SLOT_SIZE * SLOT_SIZE);
+  drop_output ();
+
+  /* at 4x the key units a second of stream time apart are pushed a quarter
+   * of a second apart instead of all at once */
+  g_object_set (shifter, "pcr-pacing", TRUE, NULL);
+  start = gst_util_get_timestamp ();
+  fail_unless (seek_rate (4.0, 0, -1));
+  wait_for_buffers (5);
+  fail_unless (gst_util_get_timestamp () - start >= 9 * GST_SECOND / 10);
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_window_duration)
+{
+  GstElement *indexer, *shifter;
+  guint64 usage;
+
+  shifter = setup_shifter (&indexer);
+  g_object_set (shifter, "window-duration", GST_SECOND, NULL);
+  start_shifter (indexer, shifter);
+
+  /* the bitrate is measured once the index has a second of entries */
+  push_key_units (0, 10);
+  wait_for_bytes (10 * KEY_UNIT_SIZE / SLOT_SIZE * SLOT_SIZE);
+  drop_output ();
+
+  /* the window is checked once a second, the next key unit sizes the ring
+   * buffer to a second at the bitrate, rounded up to the slots */
+  g_usleep (G_USEC_PER_SEC + G_USEC_PER_SEC / 10);
+  push_key_units (10, 1);
+  g_object_get (shifter, "memory-usage", &usage, NULL);
+  fail_unless_equals_uint64 (usage,
+      GST_ROUND_UP_N (KEY_UNIT_SIZE * GST_SECOND / KEY_UNIT_DURATION,
+          SLOT_SIZE));
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+/* the buffers pushed on a request pad */
+static GList *outputs;
+
+static GstFlowReturn
+output_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  g_mutex_lock (&check_mutex);
+  outputs = g_list_append (outputs, buffer);
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  return GST_FLOW_OK;
+}
+
+GST_START_TEST (test_request_pads)
+{
+  GstElement *indexer, *shifter;
+  GstPad *srcpad, *outsink;
+  guint64 offset;
+  GList *l;
+
+  shifter = setup_shifter (&indexer);
+  start_shifter (indexer, shifter);
+  push_key_units (0, 10);
+
+  srcpad = gst_element_get_request_pad (shifter, "src_%u");
+  fail_unless (srcpad != NULL);
+  outsink = gst_pad_new_from_static_template (&sinktemplate, "outsink");
+  gst_pad_set_chain_function (outsink, output_chain);
+  fail_unless_equals_int (gst_pad_link (srcpad, outsink), GST_PAD_LINK_OK);
+  gst_pad_set_active (outsink, TRUE);
+
+  /* a new output starts at the live edge, this one goes back */
+  fail_unless (gst_pad_push_event (outsink, gst_event_new_seek (1.0,
+              GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, 0,
+              GST_SEEK_TYPE_NONE, -1)));
+  push_key_units (10, 10);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* both get everything, each at its own pace */
+  wait_for_bytes (20 * KEY_UNIT_SIZE);
+  g_mutex_lock (&check_mutex);
+  while (count_bytes (outputs) < 20 * KEY_UNIT_SIZE)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  for (l = outputs, offset = 0; l; l = l->next) {
+    GstBuffer *buffer = GST_BUFFER (l->data);
+
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer), offset);
+    if (offset % KEY_UNIT_SIZE == 0)
+      fail_unless_equals_int (get_key_unit (buffer), offset / KEY_UNIT_SIZE);
+    offset += gst_buffer_get_size (buffer);
+  }
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET (GST_BUFFER (buffers->data)),
+      0);
+
+  gst_pad_set_active (outsink, FALSE);
+  gst_pad_unlink (srcpad, outsink);
+  gst_element_release_request_pad (shifter, srcpad);
+  gst_object_unref (srcpad);
+  gst_object_unref (outsink);
+  g_list_free_full (outputs, (GDestroyNotify) gst_buffer_unref);
+  outputs = NULL;
+
+  cleanup_shifter (indexer, shifter);
+}
+
+GST_END_TEST;
+
+static Suite *
+flumpegshifter_suite (void)
+{
+  Suite *s = suite_create ("flumpegshifter");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_fast_forward);
+  tcase_add_test (tc_chain, test_reverse);
+  tcase_add_test (tc_chain, test_pcr_pacing);
+  tcase_add_test (tc_chain, test_trick_pacing);
+  tcase_add_test (tc_chain, test_window_duration);
+  tcase_add_test (tc_chain, test_request_pads);
+
+  return s;
+}
+
+GST_CHECK_MAIN (flumpegshifter);
@@ -0,0 +1,257 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <string.h>
+
+#define PACKET_SIZE 188
+#define PCR_PID 0x100
+
+/* every key unit starts with a PCR packet and lasts KEY_UNIT_DURATION */
+#define KEY_UNIT_PACKETS 100
+#define KEY_UNIT_SIZE (KEY_UNIT_PACKETS * PACKET_SIZE)
+#define KEY_UNIT_DURATION (GST_SECOND / 10)
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS ("video/mpegts"));
+
+/* the seeker reads the index written by the indexer in front of it */
+static GstElement *
+setup_seeker (GstElement ** indexer)
+{
+  GstElement *seeker;
+  GObject *index;
+
+  *indexer = gst_check_setup_element ("timeshifttsindexer");
+  g_object_set (*indexer, "pcr-pid", PCR_PID, NULL);
+  seeker = gst_check_setup_element ("timeshiftseeker");
+  fail_unless (gst_element_link (*indexer, seeker));
+  mysrcpad = gst_check_setup_src_pad (*indexer, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (seeker, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  /* the indexer creates the index when started */
+  fail_unless (gst_element_set_state (*indexer,
+          GST_STATE_PAUSED) == GST_STATE_CHANGE_SUCCESS);
+  g_object_get (*indexer, "index", &index, NULL);
+  fail_unless (index != NULL);
+  g_object_set (seeker, "index", index, NULL);
+  g_object_unref (index);
+
+  return seeker;
+}
+
+static void
+cleanup_seeker (GstElement * indexer, GstElement * seeker)
+{
+  fail_unless (gst_element_set_state (seeker,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_set_state (indexer,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (indexer);
+  gst_check_teardown_sink_pad (seeker);
+  gst_element_unlink (indexer, seeker);
+  gst_check_teardown_element (seeker);
+  gst_check_teardown_element (indexer);
+}
+
+static void
+start_seeker (GstElement * indexer, GstElement * seeker)
+{
+  GstCaps *caps = gst_caps_new_empty_simple ("video/mpegts");
+
+  fail_unless (gst_element_set_state (seeker,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless (gst_element_set_state (indexer,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_setup_events (mysrcpad, indexer, caps, GST_FORMAT_BYTES);
+  gst_caps_unref (caps);
+}
+
+/* packets without adaptation field, the offset is set as the shifter
+ * does */
+static GstBuffer *
+make_packets (guint64 offset, guint n)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (n * PACKET_SIZE);
+  GstMapInfo map;
+  guint i;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0xff, map.size);
+  for (i = 0; i < n; i++) {
+    guint8 *data = map.data + i * PACKET_SIZE;
+
+    data[0] = 0x47;
+    data[1] = PCR_PID >> 8;
+    data[2] = PCR_PID & 0xff;
+    data[3] = 0x10;
+  }
+  gst_buffer_unmap (buffer, &map);
+  GST_BUFFER_OFFSET (buffer) = offset;
+
+  return buffer;
+}
+
+/* a key unit: a PCR packet with the random access indicator followed by
+ * packets without adaptation field */
+static GstBuffer *
+make_key_unit (guint n)
+{
+  GstBuffer *buffer = make_packets (n * KEY_UNIT_SIZE, KEY_UNIT_PACKETS);
+  /* in 90 kHz units */
+  guint64 pcr = gst_util_uint64_scale (n * KEY_UNIT_DURATION, 90000,
+      GST_SECOND);
+  GstMapInfo map;
+
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  map.data[3] = 0x30;
+  map.data[4] = 7;
+  map.data[5] = 0x50;
+  GST_WRITE_UINT32_BE (map.data + 6, pcr >> 1);
+  map.data[10] = ((pcr & 1) << 7) | 0x7e;
+  map.data[11] = 0;
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static void
+push_key_units (guint first, guint n)
+{
+  guint i;
+
+  for (i = first; i < first + n; i++) {
+    fail_unless_equals_int (gst_pad_push (mysrcpad, make_key_unit (i)),
+        GST_FLOW_OK);
+  }
+}
+
+static gboolean
+query_duration (GstClockTime * duration)
+{
+  GstQuery *query = gst_query_new_duration (GST_FORMAT_TIME);
+  gint64 value = -1;
+  gboolean ret;
+
+  ret = gst_pad_peer_query (mysinkpad, query);
+  if (ret)
+    gst_query_parse_duration (query, NULL, &value);
+  gst_query_unref (query);
+  *duration = value;
+
+  return ret;
+}
+
+static gboolean
+query_position (GstClockTime * position)
+{
+  GstQuery *query = gst_query_new_position (GST_FORMAT_TIME);
+  gint64 value = -1;
+  gboolean ret;
+
+  ret = gst_pad_peer_query (mysinkpad, query);
+  if (ret)
+    gst_query_parse_position (query, NULL, &value);
+  gst_query_unref (query);
+  *position = value;
+
+  return ret;
+}
+
+static void
+query_seeking (GstClockTime * start, GstClockTime * stop)
+{
+  GstQuery *query = gst_query_new_seeking (GST_FORMAT_TIME);
+  gint64 s = -1, e = -1;
+  gboolean seekable;
+
+  fail_unless (gst_pad_peer_query (mysinkpad, query));
+  gst_query_parse_seeking (query, NULL, &seekable, &s, &e);
+  fail_unless (seekable);
+  gst_query_unref (query);
+  *start = s;
+  *stop = e;
+}
+
+GST_START_TEST (test_queries)
+{
+  GstElement *indexer, *seeker;
+  GstClockTime time, start, stop;
+
+  seeker = setup_seeker (&indexer);
+  start_seeker (indexer, seeker);
+
+  /* nothing is known before the first entry */
+  fail_if (query_duration (&time));
+  fail_if (query_position (&time));
+  query_seeking (&start, &stop);
+  fail_unless_equals_uint64 (start, 0);
+  fail_unless_equals_uint64 (stop, GST_CLOCK_TIME_NONE);
+
+  /* the duration and the seeking range follow the entries added */
+  push_key_units (0, 10);
+  fail_unless (query_duration (&time));
+  fail_unless_equals_uint64 (time, 9 * KEY_UNIT_DURATION);
+  query_seeking (&start, &stop);
+  fail_unless_equals_uint64 (start, 0);
+  fail_unless_equals_uint64 (stop, 9 * KEY_UNIT_DURATION);
+
+  /* the position is the one of the last buffer pushed */
+  fail_unless (query_position (&time));
+  fail_unless_equals_uint64 (time, 9 * KEY_UNIT_DURATION);
+
+  /* and interpolated between the entries around it */
+  fail_unless_equals_int (gst_pad_push (mysrcpad, make_packets (4 *
+              KEY_UNIT_SIZE + KEY_UNIT_SIZE / 2, KEY_UNIT_PACKETS / 2)),
+      GST_FLOW_OK);
+  fail_unless (query_position (&time));
+  fail_unless_equals_uint64 (time, 4 * KEY_UNIT_DURATION +
+      KEY_UNIT_DURATION / 2);
+
+  cleanup_seeker (indexer, seeker);
+}
+
+GST_END_TEST;
+
+static Suite *
+timeshiftseeker_suite (void)
+{
+  Suite *s = suite_create ("timeshiftseeker");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_queries);
+
+  return s;
+}
+
+GST_CHECK_MAIN (timeshiftseeker);
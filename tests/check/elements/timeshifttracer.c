@@ -0,0 +1,172 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <string.h>
+
+/* tells whether the plugin has the tracer */
+#include "gsttimeshifttracer.h"
+
+/* the size of a slot of the cache */
+#define SLOT_SIZE (32 * 1024)
+
+#if defined (HAVE_TIME_SHIFT_TRACER) && !defined (GST_DISABLE_GST_DEBUG)
+
+static GstPad *mysrcpad, *mysinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+/* the records logged by the tracer, from the streaming threads too */
+static GMutex records_lock;
+static GPtrArray *records;
+
+static void
+record_log (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message, gpointer user_data)
+{
+  const gchar *text;
+
+  if (strcmp (gst_debug_category_get_name (category), "GST_TRACER"))
+    return;
+  text = gst_debug_message_get (message);
+  if (!g_str_has_prefix (text, "timeshift-"))
+    return;
+
+  g_mutex_lock (&records_lock);
+  g_ptr_array_add (records, g_strdup (text));
+  g_mutex_unlock (&records_lock);
+}
+
+static guint
+count_records (const gchar * name)
+{
+  guint i, n = 0;
+
+  g_mutex_lock (&records_lock);
+  for (i = 0; i < records->len; i++) {
+    const gchar *text = g_ptr_array_index (records, i);
+
+    if (g_str_has_prefix (text, name) && text[strlen (name)] == ',')
+      n++;
+  }
+  g_mutex_unlock (&records_lock);
+
+  return n;
+}
+
+static GstBuffer *
+make_buffer (gsize size)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (size);
+
+  gst_buffer_memset (buffer, 0, 0, size);
+  return buffer;
+}
+
+static void
+wait_for_buffers (guint n)
+{
+  g_mutex_lock (&check_mutex);
+  while (g_list_length (buffers) < n)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+GST_START_TEST (test_records)
+{
+  GstElement *shifter;
+  guint i;
+
+  records = g_ptr_array_new_with_free_func (g_free);
+  gst_debug_set_threshold_for_name ("GST_TRACER", GST_LEVEL_TRACE);
+  gst_debug_remove_log_function (gst_debug_log_default);
+  gst_debug_add_log_function (record_log, NULL, NULL);
+
+  shifter = gst_check_setup_element ("flufakeshifter");
+  mysrcpad = gst_check_setup_src_pad (shifter, &srctemplate);
+  mysinkpad = gst_check_setup_sink_pad (shifter, &sinktemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+  gst_pad_set_active (mysinkpad, TRUE);
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_setup_events (mysrcpad, shifter, NULL, GST_FORMAT_BYTES);
+
+  /* the time in the chain function of every buffer coming in */
+  for (i = 0; i < 3; i++) {
+    fail_unless_equals_int (gst_pad_push (mysrcpad, make_buffer (SLOT_SIZE)),
+        GST_FLOW_OK);
+  }
+  fail_unless_equals_int (count_records ("timeshift-ingest"), 3);
+
+  /* the delay is logged once the push of a slot returns, so the ones
+   * before the last are there, and the fill when the output starts */
+  wait_for_buffers (3);
+  fail_unless (count_records ("timeshift-delay") >= 2);
+  fail_unless (count_records ("timeshift-fill") >= 1);
+
+  fail_unless (gst_element_set_state (shifter,
+          GST_STATE_NULL) == GST_STATE_CHANGE_SUCCESS);
+  gst_check_drop_buffers ();
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_check_teardown_src_pad (shifter);
+  gst_check_teardown_sink_pad (shifter);
+  gst_check_teardown_element (shifter);
+
+  gst_debug_remove_log_function (record_log);
+  gst_debug_add_log_function (gst_debug_log_default, NULL, NULL);
+  g_ptr_array_free (records, TRUE);
+}
+
+GST_END_TEST;
+
+#endif
+
+static Suite *
+timeshifttracer_suite (void)
+{
+  Suite *s = suite_create ("timeshifttracer");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+#if defined (HAVE_TIME_SHIFT_TRACER) && !defined (GST_DISABLE_GST_DEBUG)
+  tcase_add_test (tc_chain, test_records);
+#endif
+
+  return s;
+}
+
+int
+main (int argc, char **argv)
+{
+  /* the tracers are created by gst_init() */
+  g_setenv ("GST_TRACERS", "timeshift", TRUE);
+  gst_check_init (&argc, &argv);
+
+  return gst_check_run_suite (timeshifttracer_suite (), "timeshifttracer",
+      __FILE__);
+}
@@ -0,0 +1,598 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+#ifdef HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "flucache.h"
+#include "flucacheshm.h"
+
+/* normally defined by the plugin */
+GST_DEBUG_CATEGORY (ts_flow);
+
+#define RING_SIZE (16 * CACHE_SLOT_SIZE)
+
+/* the byte at every offset is known so ranges can be checked anywhere */
+static guint8 *
+make_data (guint64 offset, gsize size)
+{
+  guint8 *data = g_malloc (size);
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    data[i] = (offset + i) % 251;
+  return data;
+}
+
+static void
+push_data (GstShifterCache * cache, gsize size)
+{
+  guint64 offset = gst_shifter_cache_get_total_bytes_received (cache);
+  guint8 *data = make_data (offset, size);
+
+  fail_unless_equals_uint64 (gst_shifter_cache_push (cache, data, size),
+      offset);
+  g_free (data);
+}
+
+static void
+check_data (const guint8 * data, guint64 offset, gsize size)
+{
+  gsize i;
+
+  for (i = 0; i < size; i++) {
+    if (data[i] != (offset + i) % 251)
+      fail ("wrong byte at offset %" G_GUINT64_FORMAT, offset + i);
+  }
+}
+
+/* pops the next slot, checking it holds the data pushed at @offset */
+static GstBuffer *
+pop_data (GstShifterCache * cache, guint64 offset)
+{
+  GstBuffer *buffer;
+  GstMapInfo info;
+
+  buffer = gst_shifter_cache_pop (cache, FALSE);
+  fail_unless (buffer != NULL);
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer), offset);
+  fail_unless (gst_buffer_map (buffer, &info, GST_MAP_READ));
+  check_data (info.data, offset, info.size);
+  gst_buffer_unmap (buffer, &info);
+  return buffer;
+}
+
+static void
+check_file (gint fd, guint64 offset, gsize size)
+{
+  guint8 *data = g_malloc (size + 1);
+
+  fail_unless (lseek (fd, 0, SEEK_SET) == 0);
+  fail_unless_equals_int (read (fd, data, size + 1), size);
+  check_data (data, offset, size);
+  g_free (data);
+}
+
+static gint
+open_tmp (gchar ** name)
+{
+  gint fd = g_file_open_tmp ("flucache-XXXXXX", name, NULL);
+
+  fail_unless (fd != -1);
+  return fd;
+}
+
+static void
+close_tmp (gint fd, gchar * name)
+{
+  close (fd);
+  g_unlink (name);
+  g_free (name);
+}
+
+static GstShifterCache *
+new_recording_cache (gsize size)
+{
+  gchar *template;
+  GstShifterCache *cache;
+
+  template = g_build_filename (g_get_tmp_dir (), "flucache-XXXXXX", NULL);
+  cache = gst_shifter_cache_new (size, template);
+  g_free (template);
+  return cache;
+}
+
+static guint64
+get_stat (GstShifterCache * cache, const gchar * name)
+{
+  GstStructure *stats = gst_shifter_cache_get_stats (cache);
+  guint64 value;
+
+  fail_unless (gst_structure_get_uint64 (stats, name, &value));
+  gst_structure_free (stats);
+  return value;
+}
+
+/* waits for the ring buffer to be copied to the disk */
+static GstClockTime
+wait_migration (GstShifterCache * cache)
+{
+  GstClockTime migration_time;
+  guint i;
+
+  for (i = 0; i < 1000; i++) {
+    migration_time = get_stat (cache, "migration-time");
+    if (GST_CLOCK_TIME_IS_VALID (migration_time))
+      return migration_time;
+    g_usleep (G_USEC_PER_SEC / 100);
+  }
+  fail ("the ring buffer migration did not finish");
+  return GST_CLOCK_TIME_NONE;
+}
+
+GST_START_TEST (test_export)
+{
+  GstShifterCache *cache;
+  gchar *name;
+  gint fd;
+
+  cache = gst_shifter_cache_new (RING_SIZE, NULL);
+  push_data (cache, 3 * CACHE_SLOT_SIZE + 100);
+
+  /* a range across slots */
+  fd = open_tmp (&name);
+  fail_unless (gst_shifter_cache_export (cache, 1000,
+          2 * CACHE_SLOT_SIZE + 10, fd));
+  check_file (fd, 1000, 2 * CACHE_SLOT_SIZE + 10 - 1000);
+  close_tmp (fd, name);
+
+  /* the stop is clipped to the data received */
+  fd = open_tmp (&name);
+  fail_unless (gst_shifter_cache_export (cache, 3 * CACHE_SLOT_SIZE,
+          G_MAXUINT64, fd));
+  check_file (fd, 3 * CACHE_SLOT_SIZE, 100);
+  close_tmp (fd, name);
+
+  /* the reading position is not modified */
+  fail_unless_equals_uint64 (gst_shifter_cache_get_read_offset (cache), 0);
+
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_write_rate)
+{
+  GstShifterCache *cache;
+
+  /* a slot per second, the first one fits in the bucket */
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_write_rate (cache, CACHE_SLOT_SIZE);
+  gst_shifter_cache_set_io_priority (cache, GST_SHIFTER_CACHE_IO_CLASS_IDLE,
+      7);
+  push_data (cache, 4 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+
+  fail_unless (wait_migration (cache) >= 2 * GST_SECOND);
+  fail_unless_equals_uint64 (get_stat (cache, "disk-write-bytes"),
+      4 * CACHE_SLOT_SIZE);
+
+  /* the live data goes over the bucket, the writer has to hold back */
+  push_data (cache, 2 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_take_write_delay (cache) > 0);
+  fail_unless_equals_uint64 (gst_shifter_cache_take_write_delay (cache), 0);
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+
+  /* without a limit it is not delayed */
+  cache = new_recording_cache (RING_SIZE);
+  push_data (cache, 4 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+
+  fail_unless (wait_migration (cache) < GST_SECOND);
+  push_data (cache, 2 * CACHE_SLOT_SIZE);
+  fail_unless_equals_uint64 (gst_shifter_cache_take_write_delay (cache), 0);
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_disk_window)
+{
+  GstShifterCache *cache;
+  guint64 rb_start, rb_stop, dk_start, dk_stop;
+  GstBuffer *buffer;
+  guint i;
+
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_disk_window (cache, 4 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  /* the data being read is never discarded, so keep reading */
+  for (i = 0; i < 16; i++) {
+    push_data (cache, CACHE_SLOT_SIZE);
+    buffer = gst_shifter_cache_pop (cache, FALSE);
+    fail_unless (buffer != NULL);
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buffer),
+        i * CACHE_SLOT_SIZE);
+    gst_buffer_unref (buffer);
+  }
+
+  fail_unless (gst_shifter_cache_get_ranges (cache, &rb_start, &rb_stop,
+          &dk_start, &dk_stop));
+  fail_unless_equals_uint64 (dk_stop, 16 * CACHE_SLOT_SIZE);
+  fail_unless (dk_stop - dk_start <= 5 * CACHE_SLOT_SIZE);
+  fail_unless (dk_stop - dk_start >= 4 * CACHE_SLOT_SIZE);
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+
+/* the recording must hold the same data whatever the durability policy */
+static void
+check_sync_policy (GstShifterCacheSyncPolicy policy)
+{
+  GstShifterCache *cache;
+  gchar *filename, *contents;
+  gsize length;
+
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_autoremove (cache, FALSE);
+  gst_shifter_cache_set_sync_policy (cache, policy, CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  push_data (cache, 8 * CACHE_SLOT_SIZE + 100);
+  gst_shifter_cache_stop_recording (cache);
+  filename = g_strdup (gst_shifter_cache_get_filename (cache));
+  gst_shifter_cache_unref (cache);
+
+  fail_unless (g_file_get_contents (filename, &contents, &length, NULL));
+  fail_unless_equals_int (length, 8 * CACHE_SLOT_SIZE + 100);
+  check_data ((guint8 *) contents, 0, length);
+  g_free (contents);
+
+  g_unlink (filename);
+  g_free (filename);
+}
+
+GST_START_TEST (test_sync_policy)
+{
+  check_sync_policy (GST_SHIFTER_CACHE_SYNC_NONE);
+  check_sync_policy (GST_SHIFTER_CACHE_SYNC_RANGE);
+  check_sync_policy (GST_SHIFTER_CACHE_SYNC_DATA);
+}
+
+GST_END_TEST;
+
+#define SYNC_BENCHMARK_SIZE (32 * 1024 * 1024)
+
+/* returns the rate the live data is recorded at under @policy in MB/s */
+static gdouble
+sync_throughput (GstShifterCacheSyncPolicy policy)
+{
+  GstShifterCache *cache;
+  GstClockTime start, elapsed;
+  guint8 *data;
+  gsize pushed;
+
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_sync_policy (cache, policy, 1024 * 1024);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  data = make_data (0, CACHE_SLOT_SIZE);
+  start = gst_util_get_timestamp ();
+  for (pushed = 0; pushed < SYNC_BENCHMARK_SIZE; pushed += CACHE_SLOT_SIZE)
+    gst_shifter_cache_push (cache, data, CACHE_SLOT_SIZE);
+  gst_shifter_cache_stop_recording (cache);
+  elapsed = gst_util_get_timestamp () - start;
+  g_free (data);
+
+  fail_unless_equals_uint64 (get_stat (cache, "disk-write-bytes"),
+      SYNC_BENCHMARK_SIZE);
+  gst_shifter_cache_unref (cache);
+
+  return (gdouble) SYNC_BENCHMARK_SIZE / (1024 * 1024) /
+      MAX (elapsed, 1) * GST_SECOND;
+}
+
+/* the syncs are done on the workers, the writer is not held back by them */
+GST_START_TEST (test_sync_throughput)
+{
+  gdouble none, range, data;
+
+  none = sync_throughput (GST_SHIFTER_CACHE_SYNC_NONE);
+  range = sync_throughput (GST_SHIFTER_CACHE_SYNC_RANGE);
+  data = sync_throughput (GST_SHIFTER_CACHE_SYNC_DATA);
+  g_print ("recording throughput: none %.1f MB/s, range %.1f MB/s, "
+      "data %.1f MB/s\n", none, range, data);
+}
+
+GST_END_TEST;
+
+#if defined (HAVE_SYS_STATVFS_H) && defined (HAVE_FSTATVFS)
+/* the free space is checked every 4MB written */
+#define SPACE_CHECK_SLOTS (4 * 1024 * 1024 / CACHE_SLOT_SIZE)
+
+GST_START_TEST (test_disk_thresholds)
+{
+  GstShifterCache *cache;
+  guint64 free_space;
+  guint i;
+
+  /* no filesystem has this much space left */
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_disk_thresholds (cache, G_MAXINT64, 0);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  fail_unless_equals_int (gst_shifter_cache_get_disk_state (cache, NULL),
+      GST_SHIFTER_CACHE_DISK_OK);
+  for (i = 0; i < SPACE_CHECK_SLOTS; i++)
+    push_data (cache, CACHE_SLOT_SIZE);
+  fail_unless_equals_int (gst_shifter_cache_get_disk_state (cache,
+          &free_space), GST_SHIFTER_CACHE_DISK_LOW);
+  fail_unless (free_space < G_MAXINT64);
+  fail_unless (gst_shifter_cache_is_recording (cache));
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+
+  /* below the critical threshold the cache continues in memory */
+  cache = new_recording_cache (RING_SIZE);
+  gst_shifter_cache_set_disk_thresholds (cache, G_MAXINT64, G_MAXINT64);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  for (i = 0; i <= SPACE_CHECK_SLOTS; i++)
+    push_data (cache, CACHE_SLOT_SIZE);
+  fail_unless_equals_int (gst_shifter_cache_get_disk_state (cache, NULL),
+      GST_SHIFTER_CACHE_DISK_FULL);
+  fail_if (gst_shifter_cache_is_recording (cache));
+  fail_unless (gst_shifter_cache_has_offset (cache,
+          SPACE_CHECK_SLOTS * CACHE_SLOT_SIZE));
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+#endif
+
+#define SHARED_CACHES 8
+
+GST_START_TEST (test_shared_scheduler)
+{
+  GstShifterCache *caches[SHARED_CACHES];
+  guint i;
+
+  /* the migrations take turns on the shared workers */
+  for (i = 0; i < SHARED_CACHES; i++) {
+    caches[i] = new_recording_cache (RING_SIZE);
+    gst_shifter_cache_set_shared_scheduler (caches[i], TRUE);
+    push_data (caches[i], 4 * CACHE_SLOT_SIZE);
+  }
+  /* a throttled one is queued again later */
+  gst_shifter_cache_set_write_rate (caches[0], CACHE_SLOT_SIZE);
+
+  for (i = 0; i < SHARED_CACHES; i++)
+    fail_unless (gst_shifter_cache_start_recording (caches[i]));
+
+  for (i = 0; i < SHARED_CACHES; i++) {
+    GstClockTime migration_time = wait_migration (caches[i]);
+
+    if (i == 0)
+      fail_unless (migration_time >= 2 * GST_SECOND);
+    fail_unless_equals_uint64 (get_stat (caches[i], "disk-write-bytes"),
+        4 * CACHE_SLOT_SIZE);
+  }
+
+  for (i = 0; i < SHARED_CACHES; i++) {
+    gst_shifter_cache_stop_recording (caches[i]);
+    gst_shifter_cache_unref (caches[i]);
+  }
+}
+
+GST_END_TEST;
+
+/* the reader falls behind the ring buffer and the data comes back from the
+ * disk, as read in order and after a seek */
+GST_START_TEST (test_reload)
+{
+  GstShifterCache *cache;
+  guint i;
+
+  cache = new_recording_cache (RING_SIZE);
+  fail_unless (gst_shifter_cache_start_recording (cache));
+  wait_migration (cache);
+
+  push_data (cache, 32 * CACHE_SLOT_SIZE);
+  for (i = 0; i < 32; i++)
+    gst_buffer_unref (pop_data (cache, i * CACHE_SLOT_SIZE));
+  fail_unless (gst_shifter_cache_pop (cache, FALSE) == NULL);
+
+  /* the start is not in the ring buffer anymore */
+  fail_unless (gst_shifter_cache_seek (cache, 0));
+  for (i = 0; i < 4; i++)
+    gst_buffer_unref (pop_data (cache, i * CACHE_SLOT_SIZE));
+
+  fail_unless (get_stat (cache, "reloads") > 0);
+  fail_unless (get_stat (cache, "disk-write-bytes") >= 32 * CACHE_SLOT_SIZE);
+  fail_unless (get_stat (cache, "disk-read-bytes") >= 36 * CACHE_SLOT_SIZE);
+
+  gst_shifter_cache_stop_recording (cache);
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_resize)
+{
+  GstShifterCache *cache;
+  GstBuffer *buffer;
+  guint64 offset;
+  guint i;
+
+  cache = gst_shifter_cache_new (RING_SIZE, NULL);
+
+  /* growing keeps what was not read yet, more fits behind it */
+  push_data (cache, 12 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_resize (cache, 2 * RING_SIZE));
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (cache),
+      2 * RING_SIZE);
+  push_data (cache, 16 * CACHE_SLOT_SIZE);
+  for (i = 0; i < 28; i++)
+    gst_buffer_unref (pop_data (cache, i * CACHE_SLOT_SIZE));
+
+  /* shrinking removes the free slots first */
+  offset = gst_shifter_cache_get_total_bytes_received (cache);
+  push_data (cache, 6 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_resize (cache, 8 * CACHE_SLOT_SIZE));
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (cache),
+      8 * CACHE_SLOT_SIZE);
+  for (i = 0; i < 6; i++)
+    gst_buffer_unref (pop_data (cache, offset + i * CACHE_SLOT_SIZE));
+
+  /* without a disk the oldest data not read yet is dropped */
+  offset = gst_shifter_cache_get_total_bytes_received (cache);
+  push_data (cache, 6 * CACHE_SLOT_SIZE);
+  fail_unless (gst_shifter_cache_resize (cache, 4 * CACHE_SLOT_SIZE));
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (cache),
+      4 * CACHE_SLOT_SIZE);
+  buffer = gst_shifter_cache_pop (cache, FALSE);
+  fail_unless (buffer != NULL);
+  fail_unless (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT));
+  fail_unless (GST_BUFFER_OFFSET (buffer) > offset);
+  offset = GST_BUFFER_OFFSET (buffer);
+  gst_buffer_unref (buffer);
+
+  /* and the rest is still in order up to the last byte pushed */
+  offset += CACHE_SLOT_SIZE;
+  while (offset < gst_shifter_cache_get_total_bytes_received (cache)) {
+    gst_buffer_unref (pop_data (cache, offset));
+    offset += CACHE_SLOT_SIZE;
+  }
+  fail_unless (gst_shifter_cache_pop (cache, FALSE) == NULL);
+
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+
+#ifdef HAVE_MEMFD_CREATE
+GST_START_TEST (test_shared_memory)
+{
+  GstShifterCache *cache;
+  FluCacheShmHeader *hdr;
+  const guint8 *data;
+  guint64 l_offset, h_offset;
+  struct stat st;
+  gsize avail;
+  guint index;
+  gint fd, seq;
+
+  cache = gst_shifter_cache_new_shared (RING_SIZE, NULL);
+  fd = gst_shifter_cache_get_shared_fd (cache);
+  fail_unless (fd >= 0);
+  /* the other processes map a fixed size */
+  fail_if (gst_shifter_cache_resize (cache, 2 * RING_SIZE));
+
+  /* map it like another process would */
+  fail_unless (fstat (fd, &st) == 0);
+  hdr = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  fail_unless (hdr != MAP_FAILED);
+  fail_unless (flucache_shm_is_valid (hdr));
+  fail_unless_equals_int (hdr->slot_size, CACHE_SLOT_SIZE);
+  fail_unless_equals_int (hdr->nslots, RING_SIZE / CACHE_SLOT_SIZE);
+  fail_unless (hdr->data_offset + RING_SIZE <= st.st_size);
+
+  push_data (cache, 2 * CACHE_SLOT_SIZE + 100);
+  flucache_shm_get_range (hdr, &l_offset, &h_offset);
+  fail_unless_equals_uint64 (l_offset, 0);
+  fail_unless_equals_uint64 (h_offset, 2 * CACHE_SLOT_SIZE + 100);
+
+  /* the partial slot is visible too */
+  data = flucache_shm_slot_find (hdr, 2 * CACHE_SLOT_SIZE, &avail, &index,
+      &seq);
+  fail_unless (data != NULL);
+  fail_unless_equals_int (avail, 100);
+  check_data (data, 2 * CACHE_SLOT_SIZE, avail);
+  fail_unless (flucache_shm_slot_check (hdr, index, seq));
+
+  data = flucache_shm_slot_find (hdr, 1000, &avail, &index, &seq);
+  fail_unless (data != NULL);
+  fail_unless_equals_int (avail, CACHE_SLOT_SIZE - 1000);
+  check_data (data, 1000, avail);
+  fail_unless (flucache_shm_slot_check (hdr, index, seq));
+
+  fail_unless (flucache_shm_slot_find (hdr, h_offset, &avail, &index,
+          &seq) == NULL);
+
+  munmap (hdr, st.st_size);
+  gst_shifter_cache_unref (cache);
+}
+
+GST_END_TEST;
+#endif
+
+static Suite *
+flucache_suite (void)
+{
+  Suite *s = suite_create ("flucache");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (ts_flow, "flushifter_flow", 0,
+      "dataflow in the Time Shift element");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_export);
+  tcase_add_test (tc_chain, test_write_rate);
+  tcase_add_test (tc_chain, test_disk_window);
+  tcase_add_test (tc_chain, test_sync_policy);
+  tcase_add_test (tc_chain, test_sync_throughput);
+  tcase_add_test (tc_chain, test_shared_scheduler);
+  tcase_add_test (tc_chain, test_resize);
+  tcase_add_test (tc_chain, test_reload);
+#ifdef HAVE_MEMFD_CREATE
+  tcase_add_test (tc_chain, test_shared_memory);
+#endif
+#if defined (HAVE_SYS_STATVFS_H) && defined (HAVE_FSTATVFS)
+  tcase_add_test (tc_chain, test_disk_thresholds);
+#endif
+
+  return s;
+}
+
+GST_CHECK_MAIN (flucache);
@@ -0,0 +1,111 @@
+/* GStreamer Time Shifting
+ * Copyright (C) 2011 Fluendo S.A. <support@fluendo.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+
+#include "flucache.h"
+#include "flucachemanager.h"
+
+/* normally defined by the plugin */
+GST_DEBUG_CATEGORY (ts_flow);
+
+/* the manager reads the budget once, every test in this binary shares it */
+#define BUDGET (40 * CACHE_SLOT_SIZE)
+#define MIN_SIZE (16 * CACHE_SLOT_SIZE)
+
+GST_START_TEST (test_budget)
+{
+  GstShifterCache *first, *second, *small;
+
+  fail_unless_equals_uint64 (gst_flucachemanager_get_budget (), BUDGET);
+
+  /* the first cache takes the whole budget, at most what it asked for */
+  first = gst_shifter_cache_new (4 * BUDGET, NULL);
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (first),
+      BUDGET);
+
+  /* with the budget used up the next ones still get the minimum, unless
+   * they asked for less */
+  second = gst_shifter_cache_new (4 * BUDGET, NULL);
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (second),
+      MIN_SIZE);
+  small = gst_shifter_cache_new (8 * CACHE_SLOT_SIZE, NULL);
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (small),
+      8 * CACHE_SLOT_SIZE);
+
+  /* the memory of a cache goes back to the budget when it's freed */
+  gst_shifter_cache_unref (small);
+  gst_shifter_cache_unref (first);
+  first = gst_shifter_cache_new (4 * BUDGET, NULL);
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (first),
+      BUDGET - MIN_SIZE);
+
+  gst_shifter_cache_unref (first);
+  gst_shifter_cache_unref (second);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_budget_resize)
+{
+  GstShifterCache *cache, *other;
+
+  other = gst_shifter_cache_new (BUDGET - MIN_SIZE, NULL);
+  cache = gst_shifter_cache_new (MIN_SIZE, NULL);
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (cache),
+      MIN_SIZE);
+
+  /* growing is only a cap, the budget is all in use */
+  fail_unless (gst_shifter_cache_resize (cache, BUDGET));
+  fail_unless_equals_uint64 (gst_shifter_cache_get_memory_usage (cache),
+      MIN_SIZE);
+
+  gst_shifter_cache_unref (cache);
+  gst_shifter_cache_unref (other);
+}
+
+GST_END_TEST;
+
+static Suite *
+flucachemanager_suite (void)
+{
+  Suite *s = suite_create ("flucachemanager");
+  TCase *tc_chain = tcase_create ("general");
+  gchar *budget;
+
+  GST_DEBUG_CATEGORY_INIT (ts_flow, "flushifter_flow", 0,
+      "dataflow in the Time Shift element");
+
+  /* set before the first cache is created so the manager picks it up */
+  budget = g_strdup_printf ("%u", BUDGET);
+  g_setenv ("GST_FLUTS_MEMORY_BUDGET", budget, TRUE);
+  g_free (budget);
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_budget);
+  tcase_add_test (tc_chain, test_budget_resize);
+
+  return s;
+}
+
+GST_CHECK_MAIN (flucachemanager);